@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Small self-contained benchmark harness for ncli_bench. Every benchmark
+// reports time and heap allocations per iteration; results are written as
+// JSON in the layout of Google Benchmark, so its compare tools can read them.
+namespace Bench
+{
+    // Counted by the global operator new in the benchmark binary
+    inline std::atomic<std::uint64_t> Allocations{0};
+    inline std::atomic<std::uint64_t> AllocatedBytes{0};
+
+    // Keep the compiler from dropping a computation whose result is unused
+    template<typename T>
+    inline void keep(T&& value){
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+    struct Result {
+        std::string Name;
+        std::uint64_t Iterations = 0;
+        double Nanos = 0;       // Per iteration
+        double Allocs = 0;      // Per iteration
+        double Bytes = 0;       // Per iteration
+        double Items = 0;       // Items per second, if the benchmark counts items
+    };
+
+    // Handed to a benchmark after its setup: measure() times the body
+    class Run {
+        public:
+            explicit Run(double min_time) : m_MinTime(min_time) {}
+
+            // Items processed per iteration, reported as items_per_second
+            void items(double count){ m_Items = count; }
+
+            template<typename Body>
+            void measure(Body&& body){
+                // Grow the iteration count until a run lasts long enough
+                std::uint64_t iterations = 1;
+                while(true){
+                    double seconds = time(body, iterations);
+                    if(seconds >= m_MinTime || iterations >= (std::uint64_t(1) << 40)){
+                        break;
+                    }
+                    double scale = seconds > 0 ? m_MinTime * 1.4 / seconds : 100.0;
+                    iterations = std::max(iterations + 1, static_cast<std::uint64_t>(static_cast<double>(iterations) * std::min(scale, 100.0)));
+                }
+                m_Result.Iterations = iterations;
+            }
+
+            const Result& result() const { return m_Result; }
+
+        private:
+            double m_MinTime;
+            double m_Items = 0;
+            Result m_Result;
+
+            template<typename Body>
+            double time(Body& body, std::uint64_t iterations){
+                std::uint64_t allocs = Allocations.load();
+                std::uint64_t bytes = AllocatedBytes.load();
+                auto start = std::chrono::steady_clock::now();
+                for(std::uint64_t i = 0; i < iterations; ++i){
+                    body();
+                }
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                double n = static_cast<double>(iterations);
+                m_Result.Nanos = seconds * 1e9 / n;
+                m_Result.Allocs = static_cast<double>(Allocations.load() - allocs) / n;
+                m_Result.Bytes = static_cast<double>(AllocatedBytes.load() - bytes) / n;
+                m_Result.Items = m_Items > 0 && seconds > 0 ? m_Items * n / seconds : 0;
+                return seconds;
+            }
+    };
+
+    class Suite {
+        public:
+            void add(std::string name, std::function<void(Run&)> bench){
+                m_Benchmarks.emplace_back(std::move(name), std::move(bench));
+            }
+
+            // Options: --filter=TEXT --min-time=SECONDS --json=FILE
+            // --baseline=FILE --threshold=FRACTION. Returns the exit status:
+            // 1 if a benchmark is slower than the baseline by more than the
+            // threshold.
+            int main(int argc, char* argv[]){
+                std::string filter;
+                std::string json;
+                std::string baseline;
+                double min_time = 0.2;
+                double threshold = 0.10;
+                for(int i = 1; i < argc; ++i){
+                    std::string arg = argv[i];
+                    if(value(arg, "--filter=", filter) || value(arg, "--json=", json) || value(arg, "--baseline=", baseline)){
+                        continue;
+                    }
+                    std::string number;
+                    if(value(arg, "--min-time=", number)){
+                        min_time = std::stod(number);
+                    } else if(value(arg, "--threshold=", number)){
+                        threshold = std::stod(number);
+                    } else {
+                        std::cerr << "usage: " << argv[0] << " [--filter=TEXT] [--min-time=SECONDS] [--json=FILE]"
+                                  << " [--baseline=FILE] [--threshold=FRACTION]\n";
+                        return 2;
+                    }
+                }
+
+                std::vector<Result> results;
+                std::fprintf(stderr, "%-52s %14s %12s %12s\n", "Benchmark", "Time (ns)", "Allocs", "Bytes");
+                for(auto& bench : m_Benchmarks){
+                    if(!filter.empty() && bench.first.find(filter) == std::string::npos){
+                        continue;
+                    }
+                    Run run(min_time);
+                    bench.second(run);
+                    Result result = run.result();
+                    result.Name = bench.first;
+                    std::fprintf(stderr, "%-52s %14.1f %12.2f %12.1f", result.Name.c_str(), result.Nanos, result.Allocs, result.Bytes);
+                    if(result.Items > 0){
+                        std::fprintf(stderr, "  %.3g items/s", result.Items);
+                    }
+                    std::fprintf(stderr, "\n");
+                    results.push_back(result);
+                }
+
+                if(json.empty()){
+                    write_json(std::cout, results);
+                } else {
+                    std::ofstream out(json);
+                    write_json(out, results);
+                }
+                return baseline.empty() ? 0 : compare(baseline, results, threshold);
+            }
+
+        private:
+            std::vector<std::pair<std::string, std::function<void(Run&)>>> m_Benchmarks;
+
+            static bool value(const std::string& arg, const std::string& prefix, std::string& out){
+                if(arg.compare(0, prefix.size(), prefix) != 0){
+                    return false;
+                }
+                out = arg.substr(prefix.size());
+                return true;
+            }
+
+            // One benchmark per line, so compare() can read it back
+            static void write_json(std::ostream& out, const std::vector<Result>& results){
+                out << "{\n  \"context\": {\"library\": \"NCLI\", \"num_cpus\": " << std::thread::hardware_concurrency()
+#if defined(NDEBUG) || defined(__OPTIMIZE__)
+                    << ", \"library_build_type\": \"release\""
+#else
+                    << ", \"library_build_type\": \"debug\""
+#endif
+                    << "},\n  \"benchmarks\": [\n";
+                for(std::size_t i = 0; i < results.size(); ++i){
+                    const Result& r = results[i];
+                    out << "    {\"name\": \"" << r.Name << "\", \"run_type\": \"iteration\", \"iterations\": " << r.Iterations
+                        << ", \"real_time\": " << r.Nanos << ", \"cpu_time\": " << r.Nanos << ", \"time_unit\": \"ns\""
+                        << ", \"allocs_per_iter\": " << r.Allocs << ", \"bytes_per_iter\": " << r.Bytes;
+                    if(r.Items > 0){
+                        out << ", \"items_per_second\": " << r.Items;
+                    }
+                    out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+                }
+                out << "  ]\n}\n";
+            }
+
+            static bool field(const std::string& line, const std::string& key, std::string& out){
+                std::string marker = "\"" + key + "\": ";
+                std::size_t at = line.find(marker);
+                if(at == std::string::npos){
+                    return false;
+                }
+                at += marker.size();
+                if(line[at] == '"'){
+                    std::size_t end = line.find('"', at + 1);
+                    out = line.substr(at + 1, end - at - 1);
+                } else {
+                    std::size_t end = line.find_first_of(",}", at);
+                    out = line.substr(at, end - at);
+                }
+                return true;
+            }
+
+            static int compare(const std::string& path, const std::vector<Result>& results, double threshold){
+                std::ifstream in(path);
+                if(!in){
+                    std::cerr << "Cannot read baseline " << path << "\n";
+                    return 2;
+                }
+                std::map<std::string, std::pair<double, double>> before; // Time and allocations
+                std::string line;
+                while(std::getline(in, line)){
+                    std::string name, time, allocs;
+                    if(field(line, "name", name) && field(line, "real_time", time)){
+                        before[name] = {std::stod(time), field(line, "allocs_per_iter", allocs) ? std::stod(allocs) : 0.0};
+                    }
+                }
+                int status = 0;
+                for(const Result& r : results){
+                    auto it = before.find(r.Name);
+                    if(it == before.end()){
+                        continue;
+                    }
+                    double change = r.Nanos / it->second.first - 1.0;
+                    bool slower = change > threshold;
+                    bool allocates = r.Allocs > it->second.second + 0.5;
+                    if(slower || allocates){
+                        std::fprintf(stderr, "REGRESSION %s: %+.1f%% time, %.2f -> %.2f allocs\n",
+                                     r.Name.c_str(), change * 100.0, it->second.second, r.Allocs);
+                        status = 1;
+                    }
+                }
+                return status;
+            }
+    };
+} // namespace Bench
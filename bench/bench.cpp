@@ -0,0 +1,393 @@
+/**
+ * @file bench.cpp
+ * @brief Parse, lookup, help, completion, color, fuzzy and dispatch benchmarks for NCLI
+ *
+ * Run ncli_bench (optionally with --filter=parse) and keep the JSON it prints;
+ * pass it back with --baseline=FILE after a change to flag regressions before
+ * the single header is updated.
+ */
+
+#include "NCLI.h"
+#include "Harness.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Count every heap allocation for the allocs/bytes columns. Every form of
+// operator new and delete goes through this one pair, so new[], sized,
+// aligned (std::pmr::new_delete_resource() uses those) and nothrow
+// allocations are all counted, and each allocation is freed the way it
+// was made.
+namespace
+{
+    void* counted_allocate(std::size_t size, std::size_t alignment){
+        Bench::Allocations.fetch_add(1, std::memory_order_relaxed);
+        Bench::AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        size = std::max<std::size_t>(size, 1);
+        if(alignment <= alignof(std::max_align_t)){
+            return std::malloc(size);
+        }
+        return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+
+    void* counted_new(std::size_t size, std::size_t alignment){
+        if(void* p = counted_allocate(size, alignment)){
+            return p;
+        }
+        throw std::bad_alloc();
+    }
+
+    void counted_free(void* p) noexcept { std::free(p); }
+
+    constexpr std::size_t DefaultAlignment = alignof(std::max_align_t);
+}
+
+void* operator new(std::size_t size){ return counted_new(size, DefaultAlignment); }
+void* operator new[](std::size_t size){ return counted_new(size, DefaultAlignment); }
+void* operator new(std::size_t size, std::align_val_t align){ return counted_new(size, static_cast<std::size_t>(align)); }
+void* operator new[](std::size_t size, std::align_val_t align){ return counted_new(size, static_cast<std::size_t>(align)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return counted_allocate(size, DefaultAlignment); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return counted_allocate(size, DefaultAlignment); }
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return counted_allocate(size, static_cast<std::size_t>(align)); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return counted_allocate(size, static_cast<std::size_t>(align)); }
+
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, std::size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::size_t) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { counted_free(p); }
+
+using namespace NCLI;
+
+namespace
+{
+    // N commands with a few options and flags each, plus "wide" with N of each
+    struct Schema {
+        CLI Cli;
+        std::size_t Size;
+
+        explicit Schema(std::size_t size) : Size(size) {
+            for(std::size_t i = 0; i < size; ++i){
+                std::string name = "cmd" + std::to_string(i);
+                Cli.command(name, "Command " + std::to_string(i))
+                    .option("name", "A name").option<int>("count", "A number")
+                    .flag("verbose", "Talk more").flag("force", "Do it anyway")
+                    .action([](const ParsedArgs&){ return true; });
+            }
+            Command& wide = Cli.command("wide", "Many options").action([](const ParsedArgs&){ return true; });
+            for(std::size_t i = 0; i < size; ++i){
+                wide.option("opt" + std::to_string(i), "Option " + std::to_string(i));
+                wide.flag("flag" + std::to_string(i), "Flag " + std::to_string(i));
+            }
+            Cli.add_flag("quiet", "Global flag");
+        }
+    };
+
+    // Built once per size, since 50k commands take a while to register
+    Schema& schema(std::size_t size){
+        static std::map<std::size_t, std::unique_ptr<Schema>> schemas;
+        auto& slot = schemas[size];
+        if(!slot){
+            slot = std::make_unique<Schema>(size);
+        }
+        return *slot;
+    }
+
+    // argv with tokens arguments after the program name: the command, then
+    // options with values and flags of "wide" spread over the schema
+    struct Args {
+        std::vector<std::string> Text;
+        std::vector<char*> Argv;
+
+        Args(std::size_t size, std::size_t tokens){
+            Text.push_back("ncli");
+            Text.push_back("wide");
+            std::uint32_t seed = 12345;
+            while(Text.size() < tokens + 1){
+                seed = seed * 1664525u + 1013904223u;
+                std::size_t at = (seed >> 8) % size;
+                if(Text.size() + 2 <= tokens + 1 && (seed & 1)){
+                    Text.push_back("--opt" + std::to_string(at));
+                    Text.push_back("value" + std::to_string(at));
+                } else {
+                    Text.push_back("-flag" + std::to_string(at));
+                }
+            }
+            for(auto& text : Text){
+                Argv.push_back(text.data());
+            }
+            Argv.push_back(nullptr);
+        }
+
+        int argc() const { return static_cast<int>(Argv.size()) - 1; }
+        char** argv(){ return Argv.data(); }
+    };
+
+    std::string label(const char* group, const char* key, std::size_t value){
+        return std::string(group) + "/" + key + ":" + std::to_string(value);
+    }
+
+    void add_parse(Bench::Suite& suite){
+        for(std::size_t size : {10u, 1000u, 50000u}){
+            for(std::size_t tokens : {1u, 10u, 100u, 1000u, 10000u}){
+                suite.add(label("parse_into", "schema", size) + "/tokens:" + std::to_string(tokens), [size, tokens](Bench::Run& run){
+                    const CLI& cli = schema(size).Cli;
+                    Args args(size, tokens);
+                    ParseResult result;
+                    run.items(static_cast<double>(tokens));
+                    run.measure([&]{
+                        Bench::keep(cli.parse_into(args.argc(), args.argv(), result));
+                    });
+                });
+            }
+            // The original API: reset the CLI and parse into its options
+            suite.add(label("parse", "schema", size) + "/tokens:10", [size](Bench::Run& run){
+                CLI& cli = schema(size).Cli;
+                Args args(size, 10);
+                run.measure([&]{
+                    cli.reset();
+                    cli.parse(args.argc(), args.argv());
+                });
+                cli.reset();
+            });
+            // A new result per command line, as a server handling requests
+            // would use: on the heap, then in a buffer released in one step
+            suite.add(label("parse_into/fresh_result/heap", "schema", size) + "/tokens:10", [size](Bench::Run& run){
+                const CLI& cli = schema(size).Cli;
+                Args args(size, 10);
+                run.measure([&]{
+                    ParseResult result;
+                    Bench::keep(cli.parse_into(args.argc(), args.argv(), result));
+                });
+            });
+            suite.add(label("parse_into/fresh_result/arena", "schema", size) + "/tokens:10", [size](Bench::Run& run){
+                const CLI& cli = schema(size).Cli;
+                Args args(size, 10);
+                std::vector<std::byte> buffer(1 << 20);
+                run.measure([&]{
+                    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+                    ParseResult result(&arena);
+                    Bench::keep(cli.parse_into(args.argc(), args.argv(), result));
+                });
+            });
+        }
+    }
+
+    void add_lookup(Bench::Suite& suite){
+        for(std::size_t size : {10u, 1000u, 50000u}){
+            suite.add(label("lookup/command_hit", "schema", size), [size](Bench::Run& run){
+                const CLI& cli = schema(size).Cli;
+                std::string name = "cmd" + std::to_string(size / 2);
+                run.measure([&]{ Bench::keep(cli.get_command(name)); });
+            });
+            suite.add(label("lookup/command_miss", "schema", size), [size](Bench::Run& run){
+                const CLI& cli = schema(size).Cli;
+                run.measure([&]{ Bench::keep(cli.get_command("no-such-command")); });
+            });
+            suite.add(label("lookup/option", "schema", size), [size](Bench::Run& run){
+                const Command& wide = *schema(size).Cli.get_command("wide");
+                std::string name = "opt" + std::to_string(size - 1);
+                run.measure([&]{ Bench::keep(wide.find_option(name)); });
+            });
+            // 1024 different names spread over the schema, so lookups miss the cache
+            suite.add(label("lookup/command_spread", "schema", size), [size](Bench::Run& run){
+                const CLI& cli = schema(size).Cli;
+                std::vector<std::string> names;
+                for(std::size_t i = 0; i < 1024; ++i){
+                    names.push_back("cmd" + std::to_string(i * 7919 % size));
+                }
+                run.items(static_cast<double>(names.size()));
+                run.measure([&]{
+                    for(const auto& name : names){
+                        Bench::keep(cli.get_command(name));
+                    }
+                });
+            });
+            suite.add(label("lookup/option_spread", "schema", size), [size](Bench::Run& run){
+                const Command& wide = *schema(size).Cli.get_command("wide");
+                std::vector<std::string> names;
+                for(std::size_t i = 0; i < 1024; ++i){
+                    names.push_back("opt" + std::to_string(i * 7919 % size));
+                }
+                run.items(static_cast<double>(names.size()));
+                run.measure([&]{
+                    for(const auto& name : names){
+                        Bench::keep(wide.find_option(name));
+                    }
+                });
+            });
+        }
+    }
+
+    void add_help(Bench::Suite& suite){
+        for(std::size_t size : {10u, 1000u}){
+            suite.add(label("help/display_help", "options", size), [size](Bench::Run& run){
+                const Command& wide = *schema(size).Cli.get_command("wide");
+                MemorySink sink;
+                Output out(sink);
+                run.measure([&]{
+                    wide.display_help(out);
+                    sink.Data.clear();
+                });
+            });
+        }
+        for(std::size_t size : {10u, 1000u, 50000u}){
+            suite.add(label("help/print_help", "commands", size), [size](Bench::Run& run){
+                const CLI& cli = schema(size).Cli;
+                MemorySink sink;
+                Output out(sink);
+                run.measure([&]{
+                    cli.print_help(out);
+                    sink.Data.clear();
+                });
+            });
+        }
+    }
+
+    // One query per Tab, as the __complete entry point answers it
+    void add_complete(Bench::Suite& suite){
+        for(std::size_t size : {1000u, 50000u}){
+            for(const char* prefix : {"", "cmd1"}){
+                suite.add(label("complete/commands", "schema", size) + "/prefix:" + prefix, [size, prefix](Bench::Run& run){
+                    const CLI& cli = schema(size).Cli;
+                    std::string word = prefix;
+                    char* words[] = {word.data()};
+                    std::ostringstream out;
+                    run.measure([&]{
+                        out.str({});
+                        cli.complete(1, words, out);
+                    });
+                });
+            }
+            suite.add(label("complete/options", "schema", size) + "/prefix:--opt1", [size](Bench::Run& run){
+                const CLI& cli = schema(size).Cli;
+                std::string command = "wide";
+                std::string word = "--opt1";
+                char* words[] = {command.data(), word.data()};
+                std::ostringstream out;
+                run.measure([&]{
+                    out.str({});
+                    cli.complete(2, words, out);
+                });
+            });
+        }
+    }
+
+    void add_color(Bench::Suite& suite){
+        const std::string text = "The quick brown fox";
+        suite.add("color/red", [text](Bench::Run& run){
+            run.measure([&]{ Bench::keep(Color::red(text)); });
+        });
+        suite.add("color/bold_cyan", [text](Bench::Run& run){
+            run.measure([&]{ Bench::keep(Color::bold(Color::cyan(text))); });
+        });
+        suite.add("color/color256", [text](Bench::Run& run){
+            run.measure([&]{ Bench::keep(Color::color256(Color::rgb_to_256_color(12, 200, 99), text)); });
+        });
+        suite.add("color/styled_writer_line", [text](Bench::Run& run){
+            std::string buffer;
+            run.measure([&]{
+                buffer.clear();
+                StyledWriter(buffer).write(Style::red().bold(), "Error: ").write(text).write(Style::cyan(), " (hint)").end_line();
+                Bench::keep(buffer);
+            });
+        });
+    }
+
+    std::vector<unsigned> thread_counts(){
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned> counts;
+        for(unsigned n = 1; n < cores; n *= 2){
+            counts.push_back(n);
+        }
+        counts.push_back(cores);
+        return counts;
+    }
+
+    // First keystroke over a large list, scored on 1..cores threads
+    void add_fuzzy(Bench::Suite& suite){
+        for(unsigned threads : thread_counts()){
+            suite.add("fuzzy/candidates:100000/threads:" + std::to_string(threads), [threads](Bench::Run& run){
+                std::vector<std::string> candidates;
+                candidates.reserve(100000);
+                for(std::size_t i = 0; i < 100000; ++i){
+                    candidates.push_back("payment-api-svc-" + std::to_string(i) + (i % 3 ? "-gateway" : "-worker"));
+                }
+                ThreadPool pool(threads - 1);
+                FuzzyMatcher matcher(candidates, &pool);
+                run.items(100000);
+                run.measure([&]{
+                    matcher.update("");
+                    matcher.update("pgw7");
+                    Bench::keep(matcher.size());
+                });
+            });
+        }
+    }
+
+    // Threads dispatching on one const CLI at once, each with its own result
+    void add_dispatch(Bench::Suite& suite){
+        for(unsigned threads : thread_counts()){
+            suite.add("dispatch/concurrent/threads:" + std::to_string(threads), [threads](Bench::Run& run){
+                const CLI& cli = schema(1000).Cli;
+                Args args(1000, 10);
+                ThreadPool pool(threads - 1);
+                std::vector<ParseResult> results(threads);
+                constexpr std::size_t PerThread = 1000;
+                run.items(static_cast<double>(threads * PerThread));
+                run.measure([&]{
+                    pool.parallel_for(threads, [&](std::size_t t){
+                        for(std::size_t i = 0; i < PerThread; ++i){
+                            cli.parse_into(args.argc(), args.argv(), results[t]);
+                            results[t].command()->execute(results[t]);
+                        }
+                    });
+                });
+            });
+        }
+    }
+
+    void add_batch(Bench::Suite& suite){
+        suite.add("batch/run_script/lines:10000", [](Bench::Run& run){
+            const CLI& cli = schema(10).Cli;
+            std::ostringstream script;
+            for(std::size_t i = 0; i < 10000; ++i){
+                script << "cmd" << i % 10 << " --name \"user " << i << "\" --count " << i << " -verbose\n";
+            }
+            std::string text = script.str();
+            run.items(10000);
+            run.measure([&]{
+                std::istringstream in(text);
+                Bench::keep(cli.run_script(in));
+            });
+        });
+    }
+}
+
+int main(int argc, char* argv[]){
+    Bench::Suite suite;
+    add_parse(suite);
+    add_lookup(suite);
+    add_help(suite);
+    add_complete(suite);
+    add_color(suite);
+    add_fuzzy(suite);
+    add_dispatch(suite);
+    add_batch(suite);
+    return suite.main(argc, argv);
+}
@@ -0,0 +1,416 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Coroutine actions need C++20 and a POSIX poll()
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32)
+#define NCLI_ASYNC 1
+#endif
+
+#ifdef NCLI_ASYNC
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <coroutine>
+#include <csignal>
+#include <exception>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace NCLI
+{
+    // Thrown from a co_await once the event loop is cancelled (e.g. by Ctrl-C)
+    class CancelledError : public std::runtime_error {
+        public:
+            CancelledError() : std::runtime_error("Cancelled") {}
+    };
+
+#ifdef NCLI_ASYNC
+    class EventLoop;
+
+    template<typename T>
+    struct TaskResult {
+        std::optional<T> Value;
+        template<typename U>
+        void return_value(U&& value){ Value.emplace(std::forward<U>(value)); }
+        T take(){ return std::move(*Value); }
+    };
+
+    template<>
+    struct TaskResult<void> {
+        void return_void(){}
+        void take(){}
+    };
+
+    // Lazily started coroutine producing a T. co_await it from another task,
+    // or hand it to EventLoop::run() or EventLoop::spawn().
+    template<typename T = void>
+    class Task {
+        public:
+            struct promise_type : TaskResult<T> {
+                std::coroutine_handle<> Continuation;
+                std::exception_ptr Error;
+
+                Task get_return_object(){ return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+                std::suspend_always initial_suspend() noexcept { return {}; }
+                // Resume whoever awaited this task, or return to the event loop
+                auto final_suspend() noexcept {
+                    struct Resume {
+                        bool await_ready() noexcept { return false; }
+                        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> done) noexcept {
+                            std::coroutine_handle<> next = done.promise().Continuation;
+                            return next ? next : std::noop_coroutine();
+                        }
+                        void await_resume() noexcept {}
+                    };
+                    return Resume{};
+                }
+                void unhandled_exception(){ Error = std::current_exception(); }
+            };
+
+            Task(Task&& other) noexcept : m_Handle(std::exchange(other.m_Handle, nullptr)) {}
+            Task& operator=(Task&& other) noexcept {
+                if(this != &other){
+                    if(m_Handle){
+                        m_Handle.destroy();
+                    }
+                    m_Handle = std::exchange(other.m_Handle, nullptr);
+                }
+                return *this;
+            }
+            Task(const Task&) = delete;
+            Task& operator=(const Task&) = delete;
+            ~Task(){
+                if(m_Handle){
+                    m_Handle.destroy();
+                }
+            }
+
+            bool done() const { return !m_Handle || m_Handle.done(); }
+
+            // Value of a finished task; rethrows what it threw
+            T result(){
+                if(m_Handle.promise().Error){
+                    std::rethrow_exception(m_Handle.promise().Error);
+                }
+                return m_Handle.promise().take();
+            }
+
+            // Awaiting a task starts it and resumes the awaiter once it is done
+            bool await_ready() const { return done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter){
+                m_Handle.promise().Continuation = awaiter;
+                return m_Handle;
+            }
+            T await_resume(){ return result(); }
+
+        private:
+            friend class EventLoop;
+            std::coroutine_handle<promise_type> m_Handle;
+
+            explicit Task(std::coroutine_handle<promise_type> handle) : m_Handle(handle) {}
+            void start(){ m_Handle.resume(); }
+    };
+
+    // Single-threaded event loop for coroutine actions: tasks wait on timers
+    // and file descriptors and everything runs on the calling thread, so a
+    // progress display can animate while an action waits. While run() is
+    // active, Ctrl-C cancels the loop: every pending co_await throws
+    // CancelledError. A second Ctrl-C interrupts the process as usual.
+    class EventLoop {
+        public:
+            EventLoop(){
+                if(::pipe(m_Wake) != 0){
+                    throw std::system_error(errno, std::generic_category(), "NCLI: pipe");
+                }
+                for(int fd : m_Wake){
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    fcntl(fd, F_SETFD, FD_CLOEXEC);
+                }
+            }
+            ~EventLoop(){
+                ::close(m_Wake[0]);
+                ::close(m_Wake[1]);
+            }
+            EventLoop(const EventLoop&) = delete;
+            EventLoop& operator=(const EventLoop&) = delete;
+
+            // Loop running on this thread, or nullptr
+            static EventLoop* current(){ return s_Current; }
+
+            // Run task to completion and return its result. Tasks spawned
+            // meanwhile are dropped once it is done.
+            template<typename T>
+            T run(Task<T> task){
+                Scope scope(*this);
+                task.start();
+                while(!task.done()){
+                    step();
+                }
+                return task.result();
+            }
+
+            // Run task alongside the others, e.g. a progress display. Its
+            // result is dropped; exceptions other than CancelledError come
+            // out of run().
+            void spawn(Task<void> task){
+                m_Spawned.push_back(std::move(task));
+                m_Spawned.back().start();
+                reap();
+            }
+
+            // Wake every waiting task with CancelledError
+            void cancel(){
+                m_Cancelled = true;
+                for(const Timer& timer : m_Timers){
+                    m_Ready.push_back(timer.Handle);
+                }
+                for(const Waiter& waiter : m_Waiters){
+                    m_Ready.push_back(waiter.Handle);
+                }
+                m_Timers.clear();
+                m_Waiters.clear();
+            }
+            bool cancelled() const { return m_Cancelled; }
+
+            // co_await loop.sleep(250ms)
+            auto sleep(std::chrono::steady_clock::duration duration){
+                return TimerAwait{*this, std::chrono::steady_clock::now() + duration};
+            }
+            // co_await loop.readable(fd): until fd can be read without blocking
+            auto readable(int fd){ return IoAwait{*this, fd, POLLIN}; }
+            auto writable(int fd){ return IoAwait{*this, fd, POLLOUT}; }
+
+        private:
+            struct Timer {
+                std::chrono::steady_clock::time_point Deadline;
+                std::uint64_t Sequence; // Keeps timers with the same deadline in order
+                std::coroutine_handle<> Handle;
+            };
+            struct Waiter {
+                int Fd;
+                short Events;
+                std::coroutine_handle<> Handle;
+            };
+
+            int m_Wake[2] = {-1, -1}; // Self-pipe the signal handler writes to
+            bool m_Cancelled = false;
+            std::uint64_t m_Sequence = 0;
+            std::vector<Timer> m_Timers; // Min-heap on Deadline
+            std::vector<Waiter> m_Waiters;
+            std::vector<std::coroutine_handle<>> m_Ready;
+            std::vector<std::coroutine_handle<>> m_Due;
+            std::vector<pollfd> m_Polls;
+            std::vector<Task<void>> m_Spawned;
+
+            inline static thread_local EventLoop* s_Current = nullptr;
+            inline static std::atomic<int> s_WakeFd{-1}; // Write end of the loop owning SIGINT
+            inline static volatile std::sig_atomic_t s_Interrupted = 0;
+
+            struct TimerAwait {
+                EventLoop& Loop;
+                std::chrono::steady_clock::time_point Deadline;
+                bool await_ready() const { return Loop.m_Cancelled; }
+                void await_suspend(std::coroutine_handle<> handle){
+                    Loop.m_Timers.push_back(Timer{Deadline, Loop.m_Sequence++, handle});
+                    std::push_heap(Loop.m_Timers.begin(), Loop.m_Timers.end(), later);
+                }
+                void await_resume() const {
+                    if(Loop.m_Cancelled){
+                        throw CancelledError();
+                    }
+                }
+            };
+
+            struct IoAwait {
+                EventLoop& Loop;
+                int Fd;
+                short Events;
+                bool await_ready() const { return Loop.m_Cancelled; }
+                void await_suspend(std::coroutine_handle<> handle){
+                    Loop.m_Waiters.push_back(Waiter{Fd, Events, handle});
+                }
+                void await_resume() const {
+                    if(Loop.m_Cancelled){
+                        throw CancelledError();
+                    }
+                }
+            };
+
+            // Makes the loop current and takes SIGINT (unless another loop
+            // has it) for the duration of run()
+            class Scope {
+                public:
+                    explicit Scope(EventLoop& loop) : m_Loop(loop), m_Outer(s_Current) {
+                        s_Current = &loop;
+                        int free = -1;
+                        m_Signal = s_WakeFd.compare_exchange_strong(free, loop.m_Wake[1]);
+                        if(m_Signal){
+                            s_Interrupted = 0;
+                            struct sigaction action = {};
+                            action.sa_handler = &EventLoop::on_interrupt;
+                            sigemptyset(&action.sa_mask);
+                            sigaction(SIGINT, &action, &m_Previous);
+                        }
+                    }
+                    ~Scope(){
+                        if(m_Signal){
+                            sigaction(SIGINT, &m_Previous, nullptr);
+                            s_WakeFd = -1;
+                        }
+                        // Whatever still waits belongs to dropped tasks
+                        m_Loop.m_Spawned.clear();
+                        m_Loop.m_Timers.clear();
+                        m_Loop.m_Waiters.clear();
+                        m_Loop.m_Ready.clear();
+                        s_Current = m_Outer;
+                    }
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+                private:
+                    EventLoop& m_Loop;
+                    EventLoop* m_Outer;
+                    bool m_Signal = false;
+                    struct sigaction m_Previous = {};
+            };
+
+            static bool later(const Timer& a, const Timer& b){
+                return a.Deadline != b.Deadline ? a.Deadline > b.Deadline : a.Sequence > b.Sequence;
+            }
+
+            static void on_interrupt(int sig){
+                if(s_Interrupted){
+                    signal(sig, SIG_DFL);
+                    raise(sig);
+                    return;
+                }
+                s_Interrupted = 1;
+                char byte = 1;
+                ssize_t ignored = ::write(s_WakeFd.load(), &byte, 1);
+                (void)ignored;
+            }
+
+            // Wait for the next timer, descriptor or signal and resume what it woke
+            void step(){
+                if(m_Ready.empty()){
+                    if(m_Timers.empty() && m_Waiters.empty()){
+                        throw std::logic_error("NCLI: task is waiting on something outside the event loop");
+                    }
+                    int timeout = -1;
+                    if(!m_Timers.empty()){
+                        auto wait = std::chrono::ceil<std::chrono::milliseconds>(m_Timers.front().Deadline - std::chrono::steady_clock::now()).count();
+                        timeout = static_cast<int>(std::clamp<decltype(wait)>(wait, 0, INT_MAX));
+                    }
+                    m_Polls.clear();
+                    m_Polls.push_back(pollfd{m_Wake[0], POLLIN, 0});
+                    for(const Waiter& waiter : m_Waiters){
+                        m_Polls.push_back(pollfd{waiter.Fd, waiter.Events, 0});
+                    }
+                    if(::poll(m_Polls.data(), static_cast<nfds_t>(m_Polls.size()), timeout) < 0 && errno != EINTR){
+                        throw std::system_error(errno, std::generic_category(), "NCLI: poll");
+                    }
+                    if(m_Polls[0].revents != 0){
+                        char buffer[64];
+                        while(::read(m_Wake[0], buffer, sizeof(buffer)) > 0){}
+                        if(s_Interrupted){
+                            cancel();
+                        }
+                    }
+                    // Descriptors are matched by position, so collect before resuming anything
+                    std::size_t kept = 0;
+                    for(std::size_t i = 0; i < m_Waiters.size(); ++i){
+                        if(m_Polls.size() > i + 1 && m_Polls[i + 1].revents != 0){
+                            m_Ready.push_back(m_Waiters[i].Handle);
+                        } else {
+                            m_Waiters[kept++] = m_Waiters[i];
+                        }
+                    }
+                    m_Waiters.resize(kept);
+                    auto now = std::chrono::steady_clock::now();
+                    while(!m_Timers.empty() && m_Timers.front().Deadline <= now){
+                        std::pop_heap(m_Timers.begin(), m_Timers.end(), later);
+                        m_Ready.push_back(m_Timers.back().Handle);
+                        m_Timers.pop_back();
+                    }
+                }
+                m_Due.swap(m_Ready);
+                m_Ready.clear();
+                for(std::coroutine_handle<> handle : m_Due){
+                    handle.resume();
+                }
+                m_Due.clear();
+                reap();
+            }
+
+            // Drop finished spawned tasks
+            void reap(){
+                for(std::size_t i = 0; i < m_Spawned.size();){
+                    if(!m_Spawned[i].done()){
+                        ++i;
+                        continue;
+                    }
+                    Task<void> task = std::move(m_Spawned[i]);
+                    m_Spawned.erase(m_Spawned.begin() + static_cast<std::ptrdiff_t>(i));
+                    try {
+                        task.result();
+                    } catch(const CancelledError&){
+                    }
+                }
+            }
+    };
+
+    inline static EventLoop& current_loop(){
+        EventLoop* loop = EventLoop::current();
+        if(loop == nullptr){
+            throw std::logic_error("NCLI: no event loop is running on this thread");
+        }
+        return *loop;
+    }
+
+    // Awaitables on the loop running the current action
+    inline static auto sleep_for(std::chrono::steady_clock::duration duration){ return current_loop().sleep(duration); }
+    inline static auto readable(int fd){ return current_loop().readable(fd); }
+    inline static auto writable(int fd){ return current_loop().writable(fd); }
+
+    inline static Task<void> spin(std::string label, std::shared_ptr<bool> done){
+        static constexpr const char* Frames[] = {"|", "/", "-", "\\"};
+        for(std::size_t frame = 0; !*done; ++frame){
+            Output& out = Output::standard();
+            out << "\r" << Frames[frame % 4] << " " << label << "\033[K";
+            out.flush();
+            co_await sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    // Await task with a spinner and label animating on stdout meanwhile
+    template<typename T>
+    Task<T> with_spinner(std::string label, Task<T> task){
+        if(!isatty(STDOUT_FILENO)){
+            co_return co_await std::move(task);
+        }
+        auto done = std::make_shared<bool>(false);
+        current_loop().spawn(spin(std::move(label), done));
+        // Clear the line however the task ends
+        struct Stop {
+            std::shared_ptr<bool> Done;
+            ~Stop(){
+                *Done = true;
+                Output& out = Output::standard();
+                out << "\r\033[K";
+                out.flush();
+            }
+        } stop{done};
+        co_return co_await std::move(task);
+    }
+#endif
+} // namespace NCLI
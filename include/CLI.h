@@ -1,6 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 #include <stdexcept>
@@ -8,27 +17,76 @@
 
 namespace NCLI
 {
+    // Thrown instead of exiting when a command line is rejected inside
+    // CLI::repl(); the error has already been reported
+    class ParseError : public std::runtime_error {
+        public:
+            explicit ParseError(int code)
+                : std::runtime_error("NCLI: command line rejected"), Code(code) {}
+            int Code; // Exit status a one-shot run would have used
+    };
+
+    // What to do when a line of a script fails
+    enum class ErrorPolicy { KeepGoing, FailFast };
+
+    // Outcome and timing of CLI::run_script()
+    struct BatchReport {
+        struct CommandStats {
+            std::string_view Name;
+            std::size_t Runs = 0;
+            std::size_t Failed = 0;
+            std::chrono::nanoseconds Time{0};
+        };
+
+        std::size_t Lines = 0;      // Command lines read (blank lines and comments are skipped)
+        std::size_t Failed = 0;
+        std::size_t FirstError = 0; // Line number of the first failure, 0 if none
+        bool Stopped = false;       // Gave up early (ErrorPolicy::FailFast)
+        std::chrono::nanoseconds Time{0};
+        std::vector<CommandStats> Commands; // In registration order
+
+        bool ok() const { return Failed == 0; }
+
+        // Totals, then the commands that ran, one per line
+        void print(std::ostream& out) const {
+            auto ms = [](std::chrono::nanoseconds time){ return std::chrono::duration<double, std::milli>(time).count(); };
+            out << "Batch: " << Lines << " lines, " << Failed << " failed, " << ms(Time) << " ms";
+            if(Stopped){
+                out << " (stopped at line " << FirstError << ")";
+            }
+            out << "\n";
+            for(const auto& cmd : Commands){
+                if(cmd.Runs > 0){
+                    out << "  " << cmd.Name << ": " << cmd.Runs << " runs, " << cmd.Failed << " failed, " << ms(cmd.Time) << " ms\n";
+                }
+            }
+        }
+    };
+
     class CLI {
         public:
+            CLI() = default;
+            // parse() keeps its result and the owned copy of argv (see
+            // own_arguments) in resource; the commands stay on the heap
+            explicit CLI(std::pmr::memory_resource* resource)
+                : m_Parsed(resource), m_ArgStorage(resource), m_ArgPointers(resource) {}
 
             Command& command(const std::string& name){
-                m_Commands.push_back(Command(name));
-                return m_Commands.back();
+                return register_command(Command(name));
             }
             Command& command(const std::string& name, const std::string& help){
-                m_Commands.push_back(Command(name, help));
-                return m_Commands.back();
+                return register_command(Command(name, help));
             }
             Command& command(const std::string& name, const std::string& help, CommandFunc& func){
-                m_Commands.push_back(Command(name, help, func));
-                return m_Commands.back();
+                return register_command(Command(name, help, func));
             }
-            Command* get_command(const std::string& name){
-                auto it = std::find_if(m_Commands.begin(), m_Commands.end(),
-                    [&name](const Command& cmd) {
-                        return cmd.Name == name;
-                    });
-                return it != m_Commands.end() ? &(*it) : nullptr;
+            Command* get_command(std::string_view name){
+                std::uint32_t at = m_CommandIndex.find(name);
+                return at != NameIndex::npos ? &m_Commands[at] : nullptr;
+            }
+            const Command* get_command(std::string_view name) const {
+                std::uint32_t at = m_CommandIndex.find(name);
+                return at != NameIndex::npos ? &m_Commands[at] : nullptr;
             }
 
             bool has_command(){
@@ -36,75 +94,189 @@ namespace NCLI
             }
 
             Option& add_option(const std::string& name) {
-                m_Options.push_back({name, "", "", false});
-                return m_Options.back();
+                return add_option(name, "");
             }
             Option& add_option(const std::string& name, const std::string& help) {
-                m_Options.push_back({name, help, "", false});
-                return m_Options.back();
+                return m_Global.add_option(name, help).Options.back();
             }
-            Option* get_option(const std::string& name){
-                auto it = std::find_if(m_Options.begin(), m_Options.end(),
-                [&name](const Option& opt){
-                    return opt.Name == name;
-                });
-                return it != m_Options.end() ? &(*it) : nullptr;
+            template<typename T>
+            Option& add_option(const std::string& name, const std::string& help) {
+                return m_Global.option<T>(name, help).Options.back();
+            }
+            Option* get_option(std::string_view name){
+                return m_Global.find_option(name);
             }
         
             Flag& add_flag(const std::string& name) {
-                m_Flags.push_back({name, "", false});
-                return m_Flags.back();
+                return add_flag(name, "");
             }
             Flag& add_flag(const std::string& name, const std::string& help) {
-                m_Flags.push_back({name, help, false});
-                return m_Flags.back();
+                return m_Global.add_flag(name, help).Flags.back();
             }
-            Flag* get_flag(const std::string& name){
-                auto it = std::find_if(m_Flags.begin(), m_Flags.end(),
-                [&name](const Flag& flag){
-                    return flag.Name == name;
-                });
-                return it != m_Flags.end() ? &(*it) : nullptr;
+            Flag* get_flag(std::string_view name){
+                return m_Global.find_flag(name);
             }
 
             void display_help(){
-                std::cout << Color::cyan(Color::bold("Available commands:\n"));
+                print_help();
+                exit(0);
+            }
+
+            // Same as display_help() without exiting
+            void print_help(Output& output = Output::standard()) const {
+                NCLI_TRACE_SCOPE(Render, "print_help");
+                Output::Frame frame(output);
+                StyledWriter out(output.buffer());
+                out.write(Style::cyan().bold(), "Available commands:").end_line();
                 for(const auto& cmd: m_Commands){
-                    std::cout << "  " << Color::cyan(Color::bold(cmd.Name)) << ": " << Color::italic(cmd.Help) << "\n";
+                    out.write("  ").write(Style::cyan().bold(), cmd.Name).write(": ").write(Style{}.italic(), cmd.Help).end_line();
                 }
-                exit(0);
+            }
+
+            // Calls, time and allocations per phase so far, process-wide; all
+            // zero unless NCLI is built with NCLI_TRACE (see Trace.h)
+            TraceStats stats() const {
+                return Trace::stats();
+            }
+
+            // Copy argv into storage owned by the CLI before parsing, so parsed
+            // values outlive argv. Off by default: values are views into argv.
+            void own_arguments(bool own=true){
+                m_OwnArguments = own;
+            }
+
+            // Forget the last parse (flags, option values, current command) so
+            // another command line can be parsed; allocations are kept. Only
+            // the commands parse() stored into are visited.
+            void reset(){
+                m_Global.reset();
+                for(std::uint32_t at : m_Applied){
+                    if(at < m_Commands.size()){
+                        m_Commands[at].reset();
+                    }
+                }
+                m_Applied.clear();
+                m_CurrentCommand = {};
+                m_Current = nullptr;
             }
 
             void parse(int argc, char* argv[]) {
-                if(argc == 1 || std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h"){
-                    display_help();
-                }
-                for(int i=1; i<argc; ++i){
-                    std::string arg = argv[i];
-                    // Handle flags first
-                    if(arg[0] == '-'){
-                        if(arg[1] == '-'){ // Long option (e.g. --name)
-                            std::string option_name = arg.substr(2);
-                            std::vector<std::string> values;
-                            while(i+1 < argc && argv[i+1][0] != '-')
-                            {
-                                values.push_back(argv[++i]);
+                // Hidden entry points for shell completion: "__complete <words>"
+                // answers a query, "__completion <shell>" prints the script
+                if(completing(argc, argv)){
+                    complete(argc - 2, argv + 2, std::cout);
+                    std::cout.flush();
+                    stop(0);
+                }
+                if(argc >= 3 && std::string_view(argv[1]) == "__completion"){
+                    std::string_view program = argv[0];
+                    std::string script = completion_script(argv[2], program.substr(program.find_last_of("/\\") + 1));
+                    if(script.empty()){
+                        std::cerr << "Error: no completion for shell " << argv[2] << " (bash, zsh or fish)" << std::endl;
+                        stop(1);
+                    }
+                    std::cout << script;
+                    stop(0);
+                }
+                // --ncli-trace <file> writes a Chrome trace of the run when the program exits
+                if(argc >= 3 && std::string_view(argv[1]) == "--ncli-trace"){
+                    if(!Trace::Enabled){
+                        std::cerr << "Warning: --ncli-trace needs NCLI built with NCLI_TRACE; no trace is written" << std::endl;
+                    } else if(!Trace::start(argv[2])){
+                        std::cerr << "Error: cannot write trace " << argv[2] << std::endl;
+                        stop(1);
+                    }
+                    // The file name takes the place of the program name, which is never read
+                    argv += 2;
+                    argc -= 2;
+                }
+                // --batch <file> [--fail-fast] [--parallel] runs a script instead ("-" for stdin)
+                if(argc >= 3 && std::string_view(argv[1]) == "--batch"){
+                    ErrorPolicy policy = ErrorPolicy::KeepGoing;
+                    bool parallel = false;
+                    for(int i = 3; i < argc; ++i){
+                        std::string_view arg = argv[i];
+                        if(arg == "--fail-fast"){
+                            policy = ErrorPolicy::FailFast;
+                        } else if(arg == "--parallel"){
+                            parallel = true;
+                        } else {
+                            std::cerr << "Error: unknown --batch argument '" << arg << "'\n"
+                                      << "Usage: " << argv[0] << " --batch <file> [--fail-fast] [--parallel]" << std::endl;
+                            stop(1);
+                        }
+                    }
+                    BatchReport report = parallel ? run_script_parallel(argv[2], policy) : run_script(argv[2], policy);
+                    report.print(std::cerr);
+                    stop(report.ok() ? 0 : 1);
+                }
+                if(m_OwnArguments){
+                    argv = own_argv(argc, argv);
+                }
+                parse_into(argc, argv, m_Parsed);
+                report(m_Parsed);
+                apply(m_Parsed);
+            }
+
+            // Parse a command line into result without touching the CLI, so one
+            // CLI can parse any number of command lines, one after another or
+            // from several threads with a ParseResult each. Nothing is printed;
+            // returns false on an error, which result describes. Values are
+            // views into argv and result can be reused once they are done with.
+            bool parse_into(int argc, char* const argv[], ParseResult& result) const {
+                NCLI_TRACE_SCOPE(Parse, "parse_into");
+                result.clear(m_Global);
+                if(argc == 1 || std::string_view(argv[1]) == "--help" || std::string_view(argv[1]) == "-h"){
+                    result.m_Help = true;
+                    return true;
+                }
+                Tokenizer tokens(argc, argv);
+                Token token;
+                while(tokens.next(token)){
+                    switch(token.Type){
+                        case Token::Kind::Option: { // Long option (e.g. --name)
+                            // Global options first, then the current command's
+                            std::size_t slot = result.option_slot(token.Text);
+                            bool numeric = slot != ParseResult::npos && result.option_at(slot).takes_negative();
+                            std::string_view value;
+                            if(!tokens.next_value(value, numeric)){
+                                return result.fail(ParseResult::Error::MissingValue, token.Text, token.Index);
                             }
-                            if(!values.empty()){
-                                set_option_vector(option_name, values);
-                            } else {
-                                std::cerr << "Error: Missing value for option " << option_name << std::endl;
-                                exit(1);
+                            if(slot == ParseResult::npos){
+                                return result.fail(ParseResult::Error::UnknownOption, token.Text, token.Index);
                             }
-                        } else {
-                            // Short flag (e.g. -v)
-                            set_flag(arg.substr(1));
+                            NCLI_TRACE_SCOPE(SetOption, "set_option");
+                            const Option& option = result.option_at(slot);
+                            OptionValue& state = result.set_option(slot);
+                            do {
+                                ConvertResult converted = option.add_value(state, value);
+                                if(!converted.Ok){
+                                    result.m_ErrorValue = value;
+                                    result.m_Conversion = converted;
+                                    return result.fail(ParseResult::Error::InvalidValue, token.Text, tokens.index() - 1);
+                                }
+                            } while(tokens.next_value(value, numeric));
+                            break;
+                        }
+                        case Token::Kind::Flag: { // Short flag (e.g. -v)
+                            std::size_t slot = result.flag_slot(token.Text);
+                            if(slot == ParseResult::npos){
+                                return result.fail(ParseResult::Error::UnknownFlag, token.Text, token.Index);
+                            }
+                            NCLI_TRACE_SCOPE(SetOption, "set_flag");
+                            result.set_flag(slot);
+                            break;
+                        }
+                        case Token::Kind::Word: { // Command (first non-option argument)
+                            const Command* command = get_command(token.Text);
+                            if(command == nullptr || command != result.m_Command){
+                                result.select(command, token.Text);
+                            }
+                            break;
                         }
-                    } else {
-                        // Command (first non-option argument)
-                        m_CurrentCommand = arg;
                     }
                 }
+                return true;
             }
 
             void run(const std::string& name=""){
@@ -117,132 +289,617 @@ namespace NCLI
                 }
                 if(cmd != nullptr){
                     std::cout << "Executing: " << cmd->Name << "\n";
-                    ran = cmd->execute();
+                    try {
+                        ran = cmd->execute(&m_Global);
+                    } catch(const CancelledError&){
+                        std::cerr << "Cancelled" << std::endl;
+                        stop(130);
+                    }
                     std::cout << "Done Executing\n";
                     if(!ran){
                         std::cout << "Displaying Help\n";
                         cmd->display_help();
                     }
                 } else {
-                    if(name.empty()){
-                        std::cout << Color::red("Command not found: ") << Color::bold(m_CurrentCommand) << Color::red("!\n");
-                    } else {
-                        std::cout << Color::red("Command not found: ") << Color::bold(name) << Color::red("!\n");
+                    Output& output = Output::standard();
+                    {
+                        Output::Frame frame(output);
+                        StyledWriter(output.buffer()).write(Style::red(), "Command not found: ").write(Style{}.bold(), name.empty() ? m_CurrentCommand : std::string_view(name)).write(Style::red(), "!").end_line();
+                        print_help(output);
                     }
-                    display_help();
+                    stop(0);
                 }
             }
 
-            std::string get(const std::string& name) const {
-                for(const auto& option : m_Options){
-                    if(option.Name == name){
-                        return option.Value;
-                    }
+            // Run the command of a parse_into() result. Help requests, errors
+            // and unknown commands are reported the way run() and parse() do,
+            // but nothing exits; returns true if the command ran successfully.
+            bool run(const ParseResult& result) const {
+                if(result.help()){
+                    print_help();
+                    return true;
+                }
+                if(!result.ok()){
+                    std::cerr << "Error: " << result.message() << std::endl;
+                    return false;
                 }
-                return "";
+                const Command* cmd = result.command();
+                if(cmd == nullptr){
+                    Output& output = Output::standard();
+                    Output::Frame frame(output);
+                    StyledWriter(output.buffer()).write(Style::red(), "Command not found: ").write(Style{}.bold(), result.command_name()).write(Style::red(), "!").end_line();
+                    print_help(output);
+                    return false;
+                }
+                std::cout << "Executing: " << cmd->Name << "\n";
+                bool ran = false;
+                try {
+                    ran = cmd->execute(result);
+                } catch(const CancelledError&){
+                    std::cerr << "Cancelled" << std::endl;
+                    return false;
+                }
+                std::cout << "Done Executing\n";
+                if(!ran){
+                    std::cout << "Displaying Help\n";
+                    cmd->display_help();
+                }
+                return ran;
             }
 
-            bool is_set(const std::string& name) const {
-                for(const auto& flag : m_Flags){
-                    if(flag.Name == name){
-                        return flag.FlagSet;
+            // parse_into() and run(result) in one go. Both only read the CLI, so
+            // any number of threads can dispatch on one const CLI at once,
+            // each with its own ParseResult.
+            bool dispatch(int argc, char* const argv[], ParseResult& result) const {
+                parse_into(argc, argv, result);
+                return run(result);
+            }
+
+            // Run a script of command lines, one per line, as if each had been
+            // given on the command line. Lines are split with split_line();
+            // blank lines and lines starting with '#' are skipped. Failures
+            // (parse errors, unknown commands, actions returning false or
+            // throwing) are reported to stderr with their line number.
+            BatchReport run_script(std::istream& in, ErrorPolicy policy = ErrorPolicy::KeepGoing) const {
+                BatchReport report = new_report();
+                auto start = std::chrono::steady_clock::now();
+                BatchJob job;
+                std::string line;
+                std::size_t number = 0;
+                while(!report.Stopped && std::getline(in, line)){
+                    ++number;
+                    if(skip_line(line)){
+                        continue;
                     }
+                    prepare(job, line, number);
+                    execute(job);
+                    finish(job, policy, report);
                 }
+                report.Time = std::chrono::steady_clock::now() - start;
+                return report;
             }
 
-        private:
-            std::vector<Command> m_Commands;
-            std::vector<Option> m_Options; // Global Options
-            std::vector<Flag> m_Flags; // Global Flags
-            std::string m_CurrentCommand;
+            // Run the script in a file, or stdin for "-"
+            BatchReport run_script(const std::string& path, ErrorPolicy policy = ErrorPolicy::KeepGoing) const {
+                return open_script(path, [&](std::istream& in){ return run_script(in, policy); });
+            }
 
-        private:
-            void set_option(const std::string& name, const std::string& value){
-                // First check if global options are set
-                for(auto& option : m_Options){
-                    if(option.Name == name){
-                        option.Value = value;
-                        option.Set = true;
-                        return;
+            // run_script(), with the lines of parallel_safe() commands run on
+            // pool. What each of them prints through Output::standard() is
+            // collected and written out in script order, errors included, so
+            // the log reads the same as a serial run. Any other command waits
+            // for the lines before it and runs on its own. With FailFast,
+            // lines after the failing one may already have run.
+            BatchReport run_script_parallel(std::istream& in, ErrorPolicy policy = ErrorPolicy::KeepGoing,
+                                            ThreadPool& pool = ThreadPool::shared()) const {
+                BatchReport report = new_report();
+                auto start = std::chrono::steady_clock::now();
+                std::vector<BatchJob> jobs(BatchWindow);
+                std::string line;
+                std::size_t number = 0;
+                bool more = true;
+                while(more && !report.Stopped){
+                    // Read a window of lines, then run it
+                    std::size_t count = 0;
+                    while(count < jobs.size() && (more = static_cast<bool>(std::getline(in, line)))){
+                        ++number;
+                        if(!skip_line(line)){
+                            prepare(jobs[count++], line, number);
+                        }
                     }
-                }
-                // Then check if options are set on current command
-                if(!m_CurrentCommand.empty()){
-                    Command* current = get_command(m_CurrentCommand);
-                    if(current != nullptr){
-                        if(current->set_option(name, value)){
-                            return;
-                        } else {
-                            std::cout << Color::red(Color::bold("Unknown option: ")) << name << "\n";
-                            current->display_help();
-                            exit(0);
+                    for(std::size_t i = 0; i < count && !report.Stopped;){
+                        std::size_t end = i;
+                        while(end < count && concurrent(jobs[end])){
+                            ++end;
+                        }
+                        if(end == i){
+                            execute(jobs[i]);
+                            finish(jobs[i++], policy, report);
+                            continue;
+                        }
+                        std::atomic<std::size_t> failed{end - i}; // First failure so far
+                        pool.parallel_for(end - i, [&](std::size_t k){
+                            if(policy == ErrorPolicy::FailFast && k > failed.load()){
+                                return; // Not reported: an earlier line stops the batch
+                            }
+                            BatchJob& job = jobs[i + k];
+                            capture(job);
+                            std::size_t seen = failed.load();
+                            while(!job.Ok && k < seen && !failed.compare_exchange_weak(seen, k)){}
+                        });
+                        for(; i < end && !report.Stopped; ++i){
+                            finish(jobs[i], policy, report);
                         }
                     }
                 }
-                // Nothing left to check, throw an error and show help
-                throw std::invalid_argument("Unknown option: " + name);
+                report.Time = std::chrono::steady_clock::now() - start;
+                return report;
             }
 
-            void set_option_vector(const std::string& name, const std::vector<std::string>& values)
-            {
-                // First check if global options are set
-                for(auto& option : m_Options){
-                    if(option.Name == name){
-                        // Check if option value is already set, if so make it first
-                        if(!option.Value.empty()){
-                            if (std::find(option.Values.begin(), option.Values.end(), option.Value) != option.Values.end())
-                            {
-                                option.Values.insert(option.Values.begin(), option.Value);
+            BatchReport run_script_parallel(const std::string& path, ErrorPolicy policy = ErrorPolicy::KeepGoing,
+                                            ThreadPool& pool = ThreadPool::shared()) const {
+                return open_script(path, [&](std::istream& in){ return run_script_parallel(in, policy, pool); });
+            }
+
+            // True when a shell asks for completions. parse() answers and exits
+            // before anything runs; a program can check this first to skip
+            // setup with side effects (connections, files) on every Tab.
+            static bool completing(int argc, char* const argv[]){
+                return argc >= 2 && std::string_view(argv[1]) == "__complete";
+            }
+
+            // Shell completion. words are the arguments after the program name,
+            // the last being the word under the cursor (possibly empty). Calls
+            // emit(text, help) for every candidate in registration order (the
+            // shells sort them): commands, then --options and -flags of the
+            // command given, then values of an option from its Choices and
+            // completer. Nothing is parsed into the CLI and no action runs.
+            // Names are matched in one pass over the packed name indexes.
+            template<typename Emit, typename = std::enable_if_t<std::is_invocable_v<Emit&, std::string_view, std::string_view>>>
+            void complete(int count, char* const words[], Emit&& emit) const {
+                if(count < 1){
+                    return;
+                }
+                // Walk the words before the cursor the way parse_into() does
+                const Command* command = nullptr;
+                const Option* value_of = nullptr;
+                bool in_values = false; // The cursor is in the values of an option
+                Tokenizer tokens(count - 1, words, 0);
+                Token token;
+                std::string_view value;
+                while(tokens.next(token)){
+                    switch(token.Type){
+                        case Token::Kind::Option:
+                            value_of = m_Global.find_option(token.Text);
+                            if(value_of == nullptr && command != nullptr){
+                                value_of = command->find_option(token.Text);
                             }
+                            in_values = true;
+                            while(tokens.next_value(value, value_of != nullptr && value_of->takes_negative())){}
+                            break;
+                        case Token::Kind::Flag:
+                            in_values = false;
+                            break;
+                        case Token::Kind::Word:
+                            command = get_command(token.Text);
+                            in_values = false;
+                            break;
+                    }
+                }
+
+                std::string_view word = words[count - 1];
+                std::string text; // Candidate with its dashes
+                auto options = [&](std::string_view prefix){
+                    for(const Command* owner : {&m_Global, command}){
+                        if(owner == nullptr){
+                            continue;
                         }
-                        option.Set = true;
-                        for(auto value : values)
-                        {
-                            option.Values.push_back(value);
+                        owner->m_OptionIndex.each_prefixed(prefix, [&](std::string_view name, std::uint32_t at){
+                            text.assign("--").append(name);
+                            emit(std::string_view(text), std::string_view(owner->Options[at].Help));
+                        });
+                    }
+                };
+                auto flags = [&](std::string_view prefix){
+                    for(const Command* owner : {&m_Global, command}){
+                        if(owner == nullptr){
+                            continue;
                         }
+                        owner->m_FlagIndex.each_prefixed(prefix, [&](std::string_view name, std::uint32_t at){
+                            text.assign("-").append(name);
+                            emit(std::string_view(text), std::string_view(owner->Flags[at].Help));
+                        });
+                    }
+                };
+
+                if(word.size() > 1 && word[0] == '-' && word[1] == '-'){
+                    options(word.substr(2));
+                } else if(!word.empty() && word[0] == '-'){
+                    flags(word.substr(1));
+                    if(word.size() == 1){
+                        options({});
+                    }
+                } else if(in_values){
+                    if(value_of == nullptr){
                         return;
                     }
+                    for(const auto& choice : value_of->Choices){
+                        if(choice.first.compare(0, word.size(), word) == 0){
+                            emit(std::string_view(choice.first), std::string_view());
+                        }
+                    }
+                    if(value_of->Complete){
+                        for(const std::string& candidate : value_of->Complete(word)){
+                            if(candidate.compare(0, word.size(), word) == 0){
+                                emit(std::string_view(candidate), std::string_view());
+                            }
+                        }
+                    }
+                } else if(command == nullptr){
+                    m_CommandIndex.each_prefixed(word, [&](std::string_view name, std::uint32_t at){
+                        emit(name, std::string_view(m_Commands[at].Help));
+                    });
+                } else if(word.empty()){
+                    options({});
+                    flags({});
                 }
-                // Then check if options are set on current command
-                if(!m_CurrentCommand.empty()){
-                    Command* current = get_command(m_CurrentCommand);
-                    if(current != nullptr){
-                        if(current->set_option_vector(name, values)){
-                            return;
-                        } else {
-                            std::cout << Color::red(Color::bold("Unknown option: ")) << name << "\n";
-                            current->display_help();
-                            exit(0);
+            }
+
+            // complete() as "text<TAB>help" lines, the format the scripts from
+            // completion_script() read, written in one go
+            void complete(int count, char* const words[], std::ostream& out) const {
+                std::string buffer;
+                complete(count, words, [&buffer](std::string_view text, std::string_view help){
+                    buffer.append(text).push_back('\t');
+                    buffer.append(help.substr(0, help.find('\n'))).push_back('\n');
+                });
+                out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            }
+
+            // Script hooking completion up for program in bash, zsh or fish
+            // (empty for any other shell), e.g. source <(prog __completion bash)
+            static std::string completion_script(std::string_view shell, std::string_view program){
+                std::string name(program);
+                std::string function = "_ncli_";
+                for(char c : program){
+                    function.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+                }
+                if(shell == "bash"){
+                    return function + "() {\n"
+                        "    local IFS=$'\\n'\n"
+                        "    COMPREPLY=($(\"${COMP_WORDS[0]}\" __complete \"${COMP_WORDS[@]:1:COMP_CWORD}\" 2>/dev/null | cut -f1))\n"
+                        "}\n"
+                        "complete -o default -F " + function + " " + name + "\n";
+                }
+                if(shell == "zsh"){
+                    return "#compdef " + name + "\n" + function + "() {\n"
+                        "    local -a candidates\n"
+                        "    local line\n"
+                        "    for line in \"${(@f)$(\"${words[1]}\" __complete \"${(@)words[2,CURRENT]}\" 2>/dev/null)}\"; do\n"
+                        "        [[ -n $line ]] && candidates+=(\"${${line%%$'\\t'*}//:/\\\\:}:${line#*$'\\t'}\")\n"
+                        "    done\n"
+                        "    _describe 'values' candidates\n"
+                        "}\n"
+                        "compdef " + function + " " + name + "\n";
+                }
+                if(shell == "fish"){
+                    return "complete -c " + name + " -f -a '(" + name + " __complete (commandline -opc)[2..-1] (commandline -ct))'\n";
+                }
+                return {};
+            }
+
+            // Interactive shell: read command lines with editing and history,
+            // then parse and run each one on this CLI, until end of input
+            // (Ctrl-D), "exit" or "quit". Errors are reported and the session
+            // goes on; "help" lists the commands.
+            void repl(const std::string& prompt = "> "){
+                std::string text = Color::cyan(prompt);
+                LineEditor editor;
+                std::string line;
+                std::string storage;
+                std::vector<char*> args;
+                bool interactive = m_Interactive;
+                m_Interactive = true;
+                while(editor.read(text, line)){
+                    editor.add_history(line);
+                    if(!split_line(line, storage, args)){
+                        std::cerr << "Error: Unterminated quote" << std::endl;
+                        continue;
+                    }
+                    int argc = static_cast<int>(args.size()) - 1;
+                    if(argc == 2){
+                        std::string_view word = args[1];
+                        if(word == "exit" || word == "quit"){
+                            break;
+                        }
+                        if(word == "help"){
+                            print_help();
+                            continue;
                         }
                     }
+                    if(argc < 2){
+                        continue;
+                    }
+                    reset();
+                    try {
+                        parse(argc, args.data());
+                        run();
+                    } catch(const ParseError&){
+                        // Already reported
+                    } catch(const std::exception& e){
+                        std::cerr << "Error: " << e.what() << std::endl;
+                    }
+                }
+                reset();
+                m_Interactive = interactive;
+            }
+
+            // Value of a global option, copied
+            std::string get(std::string_view name) const {
+                return std::string(get_view(name));
+            }
+
+            // Value of a global option without copying; a view into argv (or
+            // the option's default), valid as long as the parse is
+            std::string_view get_view(std::string_view name) const {
+                const Option* option = m_Global.find_option(name);
+                return option != nullptr ? option->Value : std::string_view();
+            }
+
+            bool is_set(std::string_view name) const {
+                const Flag* flag = m_Global.find_flag(name);
+                return flag != nullptr && flag->FlagSet;
+            }
+
+        private:
+            std::vector<Command> m_Commands;
+            Command m_Global; // Global options and flags
+            std::string_view m_CurrentCommand;
+            Command* m_Current = nullptr; // Resolved m_CurrentCommand, reset on registration
+
+            NameIndex m_CommandIndex;
+            std::vector<std::uint32_t> m_Applied; // Commands parse() stored into since reset()
+
+            ParseResult m_Parsed; // Scratch result behind parse()
+
+            bool m_OwnArguments = false;
+            bool m_Interactive = false; // Inside repl(): errors throw ParseError instead of exiting
+            std::pmr::string m_ArgStorage;
+            std::pmr::vector<char*> m_ArgPointers;
+
+        private:
+            // Give up on the current command line
+            [[noreturn]] void stop(int code) const {
+                if(m_Interactive){
+                    throw ParseError(code);
+                }
+                exit(code);
+            }
+
+            Command& register_command(Command&& cmd){
+                NCLI_TRACE_SCOPE(Register, "register_command");
+                m_Commands.push_back(std::move(cmd));
+                m_CommandIndex.insert(m_Commands.back().Name, m_Commands.size() - 1);
+                m_Current = nullptr;
+                return m_Commands.back();
+            }
+
+            char** own_argv(int argc, char* argv[]){
+                std::size_t total = 0;
+                for(int i=0; i<argc; ++i){
+                    total += std::strlen(argv[i]) + 1;
+                }
+                // Reserve up front so the pointers taken below stay valid
+                m_ArgStorage.clear();
+                m_ArgStorage.reserve(total);
+                m_ArgPointers.clear();
+                for(int i=0; i<argc; ++i){
+                    std::size_t at = m_ArgStorage.size();
+                    m_ArgStorage.append(argv[i]);
+                    m_ArgStorage.push_back('\0');
+                    m_ArgPointers.push_back(&m_ArgStorage[at]);
+                }
+                m_ArgPointers.push_back(nullptr);
+                return m_ArgPointers.data();
+            }
+
+            // One line of a script on its way through run_script()
+            struct BatchJob {
+                std::size_t Number = 0;
+                std::string Storage;
+                std::vector<char*> Args;
+                ParseResult Result;
+                const Command* Ran = nullptr; // Command that was run, if any
+                bool Ok = false;
+                std::string Text;  // Output collected while running
+                std::string Error; // Why the line failed
+                std::chrono::nanoseconds Time{0};
+            };
+
+            static constexpr std::size_t BatchWindow = 4096; // Lines read ahead by run_script_parallel()
+
+            BatchReport new_report() const {
+                BatchReport report;
+                report.Commands.resize(m_Commands.size());
+                for(std::size_t i = 0; i < m_Commands.size(); ++i){
+                    report.Commands[i].Name = m_Commands[i].Name;
+                }
+                return report;
+            }
+
+            template<typename Run>
+            BatchReport open_script(const std::string& path, Run&& run) const {
+                if(path == "-"){
+                    return run(std::cin);
+                }
+                std::ifstream file(path);
+                if(!file){
+                    std::cerr << "Error: Cannot open script " << path << std::endl;
+                    BatchReport report;
+                    report.Failed = 1;
+                    return report;
+                }
+                return run(file);
+            }
+
+            // Blank lines and comments
+            static bool skip_line(std::string_view line){
+                std::size_t first = line.find_first_not_of(" \t\r");
+                return first == std::string_view::npos || line[first] == '#';
+            }
+
+            // Split and parse a line
+            void prepare(BatchJob& job, std::string_view line, std::size_t number) const {
+                job.Number = number;
+                job.Ran = nullptr;
+                job.Ok = false;
+                job.Text.clear();
+                job.Error.clear();
+                job.Time = std::chrono::nanoseconds(0);
+                if(!split_line(line, job.Storage, job.Args)){
+                    job.Error = "Unterminated quote";
+                    return;
+                }
+                // Scripts hold what would follow the program name
+                if(!parse_into(static_cast<int>(job.Args.size()) - 1, job.Args.data(), job.Result)){
+                    job.Error = job.Result.message();
+                } else if(!job.Result.help() && job.Result.command() == nullptr){
+                    job.Error = job.Result.command_name().empty() ? std::string("No command given")
+                                                                  : "Command not found: " + std::string(job.Result.command_name());
+                }
+            }
+
+            // Whether a prepared line may run alongside others
+            static bool concurrent(const BatchJob& job){
+                return !job.Error.empty() || job.Result.help() || job.Result.command()->ParallelSafe;
+            }
+
+            void execute(BatchJob& job) const {
+                if(!job.Error.empty()){
+                    return;
+                }
+                if(job.Result.help()){
+                    print_help();
+                    job.Ok = true;
+                    return;
+                }
+                job.Ran = job.Result.command();
+                auto start = std::chrono::steady_clock::now();
+                try {
+                    job.Ok = job.Ran->execute(job.Result);
+                    if(!job.Ok){
+                        job.Error.assign(job.Ran->Name).append(" failed");
+                    }
+                } catch(const std::exception& e){
+                    job.Error = e.what();
+                }
+                job.Time = std::chrono::steady_clock::now() - start;
+            }
+
+            // execute(), collecting what the line prints into job.Text
+            void capture(BatchJob& job) const {
+                MemorySink sink;
+                sink.Data.swap(job.Text);
+                {
+                    Output out(sink, 0);
+                    Output::Redirect redirect(out);
+                    execute(job);
+                }
+                job.Text.swap(sink.Data);
+            }
+
+            // Print what a line left behind and count it; stops the batch on a failure with FailFast
+            void finish(BatchJob& job, ErrorPolicy policy, BatchReport& report) const {
+                ++report.Lines;
+                if(!job.Text.empty()){
+                    Output& out = Output::standard();
+                    out << job.Text;
+                    out.flush();
+                }
+                if(job.Ran != nullptr){
+                    BatchReport::CommandStats& stats = report.Commands[static_cast<std::size_t>(job.Ran - m_Commands.data())];
+                    stats.Time += job.Time;
+                    ++stats.Runs;
+                    if(!job.Ok){
+                        ++stats.Failed;
+                    }
+                }
+                if(job.Ok){
+                    return;
+                }
+                std::cerr << "Error: line " << job.Number << ": " << job.Error << std::endl;
+                ++report.Failed;
+                if(report.FirstError == 0){
+                    report.FirstError = job.Number;
+                }
+                if(policy == ErrorPolicy::FailFast){
+                    report.Stopped = true;
                 }
-                // Nothing left to check, throw an error and show help
-                throw std::invalid_argument("Unknown option: " + name);
             }
 
-            void set_flag(const std::string& name){
-                // First check if global flags are set
-                for(auto& flag : m_Flags){
-                    if(flag.Name == name){
-                        flag.FlagSet = true;
+            // Print a failed parse the way parse() always has, and give up
+            void report(const ParseResult& result) const {
+                if(result.help()){
+                    print_help();
+                    stop(0);
+                }
+                switch(result.error()){
+                    case ParseResult::Error::None:
                         return;
+                    case ParseResult::Error::MissingValue:
+                    case ParseResult::Error::InvalidValue:
+                        std::cerr << "Error: " << result.message() << std::endl;
+                        stop(1);
+                    case ParseResult::Error::UnknownOption:
+                    case ParseResult::Error::UnknownFlag:
+                        break;
+                }
+                // Nothing left to check without a command, throw an error
+                if(result.command() == nullptr){
+                    throw std::invalid_argument(result.message());
+                }
+                Output& output = Output::standard();
+                {
+                    Output::Frame frame(output);
+                    StyledWriter(output.buffer()).write(Style::red().bold(), result.error() == ParseResult::Error::UnknownOption ? "Unknown option: " : "Unknown flag: ").write(result.error_name()).end_line();
+                    result.command()->display_help(output);
+                }
+                stop(0);
+            }
+
+            // Copy a parse into the flags and options, for run() and the getters
+            void apply(const ParseResult& result){
+                NCLI_TRACE_SCOPE(Parse, "apply");
+                if(!result.command_name().empty()){
+                    m_CurrentCommand = result.command_name();
+                    m_Current = get_command(m_CurrentCommand);
+                    if(m_Current != nullptr){
+                        m_Applied.push_back(static_cast<std::uint32_t>(m_Current - m_Commands.data()));
                     }
                 }
-                // Then check if flags are set on current command
-                if(!m_CurrentCommand.empty()){
-                    Command* current = get_command(m_CurrentCommand);
-                    if(current != nullptr){
-                        if(current->set_flag(name)){
-                            return;
-                        } else {
-                            std::cout << Color::red(Color::bold("Unknown flag: ")) << name << "\n";
-                            current->display_help();
-                            exit(0);
-                        }
+                // Slots past the global ones belong to the command
+                NCLI_TRACE_SCOPE(SetOption, "apply_options");
+                std::size_t global_flags = m_Global.Flags.size();
+                for(std::uint32_t slot : result.m_SetFlags){
+                    if(slot < global_flags){
+                        m_Global.mark_flag(m_Global.Flags[slot]);
+                    } else {
+                        m_Current->mark_flag(m_Current->Flags[slot - global_flags]);
+                    }
+                }
+                std::size_t global_options = m_Global.Options.size();
+                for(std::uint32_t slot : result.m_SetOptions){
+                    const OptionValue& state = result.m_Options[slot];
+                    Command& owner = slot < global_options ? m_Global : *m_Current;
+                    Option& option = owner.Options[slot < global_options ? slot : slot - global_options];
+                    if(state.Set){
+                        owner.mark_option(option);
+                        option.Value = state.Value;
+                        option.Values = state.Values;
+                        option.Typed = state.Typed;
+                        option.Set = true;
                     }
                 }
-                // Nothing left to check, throw an error and show help
-                throw std::invalid_argument("Unknown flag: " + name);
             }
 
     };
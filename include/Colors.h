@@ -1,63 +1,93 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <cstdio>
 #include <cstdlib>
 #include <unistd.h>
 #include <sstream>
 
 namespace NCLI::Color
 {
-    inline static bool terminal_supports_colors() {
-        const char* term_type = std::getenv("TERM");
+    enum class Stream { Out, Err };
+
+    // Terminal capabilities, detected once per stream and cached. Detection
+    // reads TERM/COLORTERM and calls isatty(), so it is kept off the hot path
+    // of the color helpers; call refresh() if the environment changes.
+    struct TerminalCaps {
+        bool Colors = false;
+        bool Colors256 = false;
+        bool TrueColor = false;
+        bool Italic = false;
+
+        static TerminalCaps detect(Stream stream){
+            TerminalCaps caps;
+            const char* term_type = std::getenv("TERM");
+            const char* color_term = std::getenv("COLORTERM");
+            bool tty = isatty(fileno(stream == Stream::Err ? stderr : stdout));
+
+            // Check if we're on a Unix-like system with a terminal and color support
+            if (term_type) {
+                // Check if the terminal supports color (e.g., "xterm", "xterm-256color", etc.)
+                caps.Colors = std::string_view(term_type) != "dumb" && tty;
+                caps.Colors256 = caps.Colors;
+            } else {
+#ifdef _WIN32
+                // For Windows, check if virtual terminal processing is enabled
+                DWORD dwMode = 0;
+                caps.Colors = GetConsoleMode(GetStdHandle(stream == Stream::Err ? STD_ERROR_HANDLE : STD_OUTPUT_HANDLE), &dwMode)
+                    && (dwMode & ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#else
+                caps.Colors = true;  // Assume color support for other systems
+#endif
+            }
+            // Check for true color support
+            caps.TrueColor = color_term != nullptr && std::string_view(color_term) == "truecolor";
+            // Check if the terminal supports italic (not all terminals do)
+            // This is a simple check, some terminals use different values for italic support
+            caps.Italic = term_type && (std::string_view(term_type).find("xterm") != std::string_view::npos ||
+                                        std::string_view(term_type).find("screen") != std::string_view::npos);
+            return caps;
+        }
 
-        // Check if we're on a Unix-like system with a terminal and color support
-        if (term_type && (std::getenv("TERM") != nullptr)) {
-            // Check if the terminal supports color (e.g., "xterm", "xterm-256color", etc.)
-            return std::string(term_type) != "dumb" && isatty(fileno(stdout));
+        static const TerminalCaps& get(Stream stream = Stream::Out){
+            return cache()[stream == Stream::Err ? 1 : 0];
         }
 
-#ifdef _WIN32
-        // For Windows, check if virtual terminal processing is enabled
-        DWORD dwMode = 0;
-        if (GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &dwMode)) {
-            return (dwMode & ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+        // Re-detect the capabilities of both streams
+        static void refresh(){
+            cache()[0] = detect(Stream::Out);
+            cache()[1] = detect(Stream::Err);
         }
-        return false;
-#else
-        return true;  // Assume color support for other systems
-#endif
-    }
 
-    // Determine if we support 256 colors
-    inline static bool terminal_supports_256_colors(){
-        const char* term_type = std::getenv("TERM");
-        // Check for 256 color support
-        if (term_type && (std::getenv("TERM") != nullptr)) {
-            return std::string(term_type) != "dumb" && isatty(fileno(stdout));
+    private:
+        static TerminalCaps* cache(){
+            static TerminalCaps caps[2] = { detect(Stream::Out), detect(Stream::Err) };
+            return caps;
         }
+    };
 
-        return false;
+    inline static bool terminal_supports_colors(Stream stream = Stream::Out) {
+        return TerminalCaps::get(stream).Colors;
     }
 
-    // Detect if the terminal supports true colors (24-bit)
-    inline static bool terminal_supports_true_color() {
-        const char* term_type = std::getenv("TERM");
+    // Determine if we support 256 colors
+    inline static bool terminal_supports_256_colors(Stream stream = Stream::Out){
+        return TerminalCaps::get(stream).Colors256;
+    }
 
-        // Check for true color support
-        return std::getenv("COLORTERM") != nullptr && std::string(std::getenv("COLORTERM")) == "truecolor";
+    // Detect if the terminal supports true colors (24-bit)
+    inline static bool terminal_supports_true_color(Stream stream = Stream::Out) {
+        return TerminalCaps::get(stream).TrueColor;
     }
 
     // Determine if terminal supports styling
-    inline static bool terminal_supports_styles(){
-        return terminal_supports_colors(); 
+    inline static bool terminal_supports_styles(Stream stream = Stream::Out){
+        return terminal_supports_colors(stream);
     }
 
-    inline static bool terminal_supports_italic() {
-        const char* term_type = std::getenv("TERM");
-        // Check if the terminal supports italic (not all terminals do)
-        // This is a simple check, some terminals use different values for italic support
-        return term_type && (std::string(term_type).find("xterm") != std::string::npos || 
-                             std::string(term_type).find("screen") != std::string::npos);
+    inline static bool terminal_supports_italic(Stream stream = Stream::Out) {
+        return TerminalCaps::get(stream).Italic;
     }
 
     inline static int rgb_to_256_color(int r, int g, int b){
@@ -90,28 +120,30 @@ namespace NCLI::Color
 
     inline static void set_terminal_background_color(int r, int g, int b)
     {
-        if(terminal_supports_true_color()){
+        const TerminalCaps& caps = TerminalCaps::get();
+        if(caps.TrueColor){
             std::cout << "\033[48;2;" << r << ";" << g << ";" << b << "m";  // True-color background
-        } else if(terminal_supports_256_colors()){
+        } else if(caps.Colors256){
             // Convert RGB to 256 color index            
             int color_code = rgb_to_256_color(r,g,b);
             std::cout << "\033[48;5;" << color_code << "m";  // 256-color background    
-        } else if(terminal_supports_colors()){
+        } else if(caps.Colors){
             std::cout << "\033[48;5;0m";  // Default to black background if no advanced support
         }
     }
 
     // Color application based on the terminal's capabilities
-    inline static std::string apply_color(int r, int g, int b, const std::string& text){
+    inline static std::string apply_color(int r, int g, int b, const std::string& text, Stream stream = Stream::Out){
+        const TerminalCaps& caps = TerminalCaps::get(stream);
         std::stringstream buffer;
-        if (terminal_supports_true_color()) {
+        if (caps.TrueColor) {
             buffer << "\033[38;2;" << r << ';' << g << ';' << b << "m" << text << "\033[0m";  // Applying true color (example orange)
         }
-        else if (terminal_supports_256_colors()) {
+        else if (caps.Colors256) {
             int color_code = rgb_to_256_color(r,g,b);
             buffer << "\033[38;5;" << color_code << "m" << text << "\033[0m";    
         }
-        else if (terminal_supports_colors()) {
+        else if (caps.Colors) {
             int color_code = rgb_to_ansi_color(r,g,b);
             buffer << "\033[38;5;" << color_code << "m" << text << "\033[0m";
         } else {
@@ -121,8 +153,8 @@ namespace NCLI::Color
     }
 
     // Apply styles dynamically
-    inline static std::string apply_style(const std::string& style_code, const std::string& text) {
-        if (terminal_supports_styles()) {
+    inline static std::string apply_style(const std::string& style_code, const std::string& text, Stream stream = Stream::Out) {
+        if (terminal_supports_styles(stream)) {
             return style_code + text + "\033[0m";  // Apply style if terminal supports it
         }
         return text;  // Return plain text if no styles are supported
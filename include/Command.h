@@ -1,8 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <unordered_map>
 #include <functional>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace NCLI
 {
@@ -19,12 +29,99 @@ namespace NCLI
             : Name(name), Help(help), FlagSet(set){}
     };
 
+    // Values given to an option. The first few are stored inline, so a typical
+    // command line never allocates; longer lists spill into a vector.
+    class ValueList {
+        public:
+            static constexpr std::size_t InlineCapacity = 4;
+
+            ValueList() = default;
+            explicit ValueList(std::pmr::memory_resource* resource) : m_Spill(resource) {}
+
+            void push_back(std::string_view value){
+                if(m_Size < InlineCapacity){
+                    m_Inline[m_Size] = value;
+                } else {
+                    if(m_Size == InlineCapacity){
+                        m_Spill.assign(m_Inline.begin(), m_Inline.end());
+                    }
+                    m_Spill.push_back(value);
+                }
+                ++m_Size;
+            }
+
+            // Keeps any spilled capacity for reuse
+            void clear(){
+                m_Spill.clear();
+                m_Size = 0;
+            }
+
+            const std::string_view* begin() const { return m_Size > InlineCapacity ? m_Spill.data() : m_Inline.data(); }
+            const std::string_view* end() const { return begin() + m_Size; }
+            std::size_t size() const { return m_Size; }
+            bool empty() const { return m_Size == 0; }
+            std::string_view front() const { return *begin(); }
+            std::string_view operator[](std::size_t i) const { return begin()[i]; }
+
+        private:
+            std::array<std::string_view, InlineCapacity> m_Inline{};
+            std::pmr::vector<std::string_view> m_Spill;
+            std::size_t m_Size = 0;
+    };
+
+    // What one parse gave an option, kept outside the Option itself (see
+    // ParseResult). Clearing keeps the allocated capacity. Allocator-aware,
+    // so the value lists share the memory resource of the ParseResult.
+    struct OptionValue {
+        using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+        std::string_view Value;
+        ValueList Values;
+        bool Set=false;
+        TypedValue Typed;
+
+        OptionValue() = default;
+        explicit OptionValue(const allocator_type& alloc)
+            : Values(alloc.resource()), Typed(alloc.resource()) {}
+        OptionValue(const OptionValue& other, const allocator_type& alloc)
+            : OptionValue(alloc) { *this = other; }
+        OptionValue(OptionValue&& other, const allocator_type& alloc)
+            : OptionValue(alloc) { *this = std::move(other); }
+        OptionValue(const OptionValue&) = default;
+        OptionValue(OptionValue&&) = default;
+        OptionValue& operator=(const OptionValue&) = default;
+        OptionValue& operator=(OptionValue&&) = default;
+
+        void clear(){
+            Value = {};
+            Values.clear();
+            Set = false;
+            Typed.Int = 0;
+            Typed.List.clear();
+        }
+    };
+
+    // Values to offer for an option in shell completion, given the word typed
+    // so far; candidates that do not start with it are dropped afterwards
+    using OptionCompleter = std::function<std::vector<std::string>(std::string_view prefix)>;
+
+    // Value and Values are views into argv (or the CLI's owned copy of it, see
+    // CLI::own_arguments) or into Default. The default given at registration
+    // is copied and owned by the option.
     struct Option{
         std::string Name;
         std::string Help;
-        std::string Value;
-        std::vector<std::string> Values;
+        std::string_view Value;
+        std::string_view Default; // Value before anything is parsed
+        ValueList Values;
         bool Set=false;
+        // Typed options (Command::option<T>) are converted once while parsing
+        ValueType Type = ValueType::String;
+        TypedValue Typed;
+        std::int64_t Min = std::numeric_limits<std::int64_t>::min(); // Accepted range for Int/UInt
+        std::uint64_t Max = std::numeric_limits<std::uint64_t>::max();
+        std::vector<std::pair<std::string, std::int64_t>> Choices; // Names accepted by Enum options
+        OptionCompleter Complete; // Values offered in shell completion, besides Choices
         Option() = default;
         Option(const std::string& name)
             : Name(name){}
@@ -32,20 +129,176 @@ namespace NCLI
             : Name(name), Help(help){}
         Option(const std::string& name, const std::string& help, bool set)
             : Name(name), Help(help), Set(set){}
-        Option(const std::string& name, const std::string& help, const std::string& default_value)
-            : Name(name), Help(help), Value(default_value){}
-        Option(const std::string& name, const std::string& help, const std::string& default_value, bool set)
-            : Name(name), Help(help), Value(default_value), Set(set) {}
+        Option(const std::string& name, const std::string& help, std::string_view default_value)
+            : Name(name), Help(help) { own_default(default_value); }
+        Option(const std::string& name, const std::string& help, std::string_view default_value, bool set)
+            : Name(name), Help(help), Set(set) { own_default(default_value); }
+
+        // Back to the unparsed state; allocated capacity is kept
+        void reset(){
+            Value = Default;
+            Values.clear();
+            Set = false;
+            Typed.Int = 0;
+            Typed.List.clear();
+        }
+
+        // Int, Double and Duration values may be negative, so -5 is a value
+        // of this option rather than a flag
+        bool takes_negative() const {
+            return Type == ValueType::Int || Type == ValueType::Double || Type == ValueType::Duration;
+        }
+
+        // Convert text into Typed according to Type
+        ConvertResult convert(std::string_view text){
+            return convert(text, Typed);
+        }
+
+        // Convert text into out according to Type
+        ConvertResult convert(std::string_view text, TypedValue& out) const {
+            switch(Type){
+                case ValueType::String:
+                    return {};
+                case ValueType::Int:
+                    return convert_int(text, Min, static_cast<std::int64_t>(Max), out.Int);
+                case ValueType::UInt:
+                    return convert_uint(text, Max, out.UInt);
+                case ValueType::Double:
+                    return convert_double(text, out.Double);
+                case ValueType::Bool:
+                    return convert_bool(text, out.Bool);
+                case ValueType::Duration:
+                    return convert_duration(text, out.Nanos);
+                case ValueType::Enum:
+                    for(const auto& choice : Choices){
+                        if(choice.first == text){
+                            out.Int = choice.second;
+                            return {};
+                        }
+                    }
+                    return convert_failed(text, text.data(), "one of the listed choices");
+                case ValueType::UIntList: {
+                    // Accepts both --ids 1 2 3 and --ids 1,2,3
+                    std::size_t begin = 0;
+                    while(true){
+                        std::size_t end = text.find(',', begin);
+                        std::string_view item = text.substr(begin, end == std::string_view::npos ? end : end - begin);
+                        std::uint64_t id = 0;
+                        ConvertResult result = convert_uint(item, Max, id);
+                        if(!result.Ok){
+                            result.Column += begin;
+                            return result;
+                        }
+                        out.List.push_back(id);
+                        if(end == std::string_view::npos){
+                            return {};
+                        }
+                        begin = end + 1;
+                    }
+                }
+            }
+            return {};
+        }
+
+        // Converted value; T must match the type the option was declared with
+        template<typename T>
+        T get() const {
+            return get<T>(Value, Typed);
+        }
+
+        // Same for a value parsed into an OptionValue
+        template<typename T>
+        T get(std::string_view value, const TypedValue& typed) const {
+            constexpr ValueType type = value_type_of<T>();
+            if(type != Type){
+                throw std::logic_error("NCLI: option --" + Name + " was declared with a different type");
+            }
+            if constexpr (type == ValueType::String) return T(value);
+            else if constexpr (type == ValueType::Int || type == ValueType::Enum) return static_cast<T>(typed.Int);
+            else if constexpr (type == ValueType::UInt) return static_cast<T>(typed.UInt);
+            else if constexpr (type == ValueType::Double) return static_cast<T>(typed.Double);
+            else if constexpr (type == ValueType::Bool) return typed.Bool;
+            else if constexpr (type == ValueType::Duration) return std::chrono::duration_cast<T>(std::chrono::nanoseconds(typed.Nanos));
+            else return T(typed.List.begin(), typed.List.end());
+        }
+
+        // Record a value from the command line in state: the first replaces
+        // the default, later ones are appended. Typed options convert the
+        // first value (every value for lists).
+        ConvertResult add_value(OptionValue& state, std::string_view value) const {
+            bool first = !state.Set;
+            if(first){
+                state.Value = value;
+                state.Set = true;
+            }
+            state.Values.push_back(value);
+            if(first || Type == ValueType::UIntList){
+                return convert(value, state.Typed);
+            }
+            return {};
+        }
+
+    private:
+        // Storage behind Default, shared by copies so views into it stay valid
+        std::shared_ptr<const std::string> m_DefaultText;
+
+        void own_default(std::string_view text){
+            m_DefaultText = std::make_shared<const std::string>(text);
+            Default = *m_DefaultText;
+            Value = Default;
+        }
     };
 
+    struct Command;
+    class ParseResult;
+
+    // Read-only view of a parsed command handed to actions. Nothing is copied;
+    // lookups go through the command's (and the CLI's global) name indexes,
+    // or into a ParseResult when the command line was parsed into one.
+    class ParsedArgs {
+        public:
+            ParsedArgs(const Command& command, const Command* global=nullptr)
+                : m_Command(command), m_Global(global) {}
+            explicit ParsedArgs(const ParseResult& result);
+
+            const Command& command() const { return m_Command; }
+
+            // True if the flag was given on the command line
+            bool flag(std::string_view name) const;
+            // The option if it was given on the command line, otherwise nullptr.
+            // For a ParseResult this is the definition only: read what was given
+            // through value(), values(), get() and list().
+            const Option* option(std::string_view name) const;
+            // First value of the option, its default, or fallback
+            std::string_view value(std::string_view name, std::string_view fallback="") const;
+            // Every value given to the option (empty if it was not given)
+            const ValueList& values(std::string_view name) const;
+            // Converted value of a typed option, or fallback if it was not given
+            template<typename T>
+            T get(std::string_view name, T fallback=T()) const;
+            // Converted values of an option<std::vector<...>>, without copying
+            const std::pmr::vector<std::uint64_t>& list(std::string_view name) const;
+
+        private:
+            const Command& m_Command;
+            const Command* m_Global;
+            const ParseResult* m_Result = nullptr;
+
+            const Flag* find_flag(std::string_view name) const;
+            const Option* find_option(std::string_view name) const;
+    };
+
+    using ActionFunc = std::function<bool(const ParsedArgs& args)>;
+    // Original action signature, still accepted by Command::action
     using CommandFunc = std::function<bool(const std::vector<Flag> flags, const std::vector<Option> options)>;
 
     struct Command {
         std::string Name;
         std::string Help;
-        CommandFunc Function;
+        ActionFunc Function;
         std::vector<Flag> Flags;
         std::vector<Option> Options;
+        bool ParallelSafe = false; // See parallel_safe()
 
         Command() = default;
         Command(const std::string& name)
@@ -53,19 +306,23 @@ namespace NCLI
         Command(const std::string& name, const std::string& help)
             : Name(name), Help(help) {}
         Command(const std::string& name, const std::string& help, CommandFunc func)
-            : Name(name), Help(help), Function(func) {}
+            : Name(name), Help(help), Function(adapt(func)) {}
         Command(const std::string& name, const std::string& help, CommandFunc func, std::vector<Flag> flags)
-            : Name(name), Help(help), Function(func), Flags(flags) {}
+            : Name(name), Help(help), Function(adapt(func)), Flags(flags) { reindex(); }
         Command(const std::string& name, const std::string& help, CommandFunc func, std::vector<Flag> flags, std::vector<Option> options)
-            : Name(name), Help(help), Function(func), Flags(flags), Options(options) {}
+            : Name(name), Help(help), Function(adapt(func)), Flags(flags), Options(options) { reindex(); }
         
         Command& add_flag(const std::string& flag_name, const std::string& help=""){
+            NCLI_TRACE_SCOPE(Register, "add_flag");
             Flags.emplace_back(flag_name, help, false);
+            m_FlagIndex.insert(Flags.back().Name, Flags.size() - 1);
             return *this;
         }
 
         Command& add_option(const std::string& option_name, const std::string& help=""){
+            NCLI_TRACE_SCOPE(Register, "add_option");
             Options.emplace_back(option_name, help, false);
+            m_OptionIndex.insert(Options.back().Name, Options.size() - 1);
             return *this;
         }
 
@@ -77,99 +334,565 @@ namespace NCLI
             return add_flag(name, help);
         }
 
-        Command& action(CommandFunc action){
-            Function = action;
+        // Typed option: values are converted to T while parsing, and errors
+        // are reported with their position (e.g. option<int>, option<double>,
+        // option<std::chrono::milliseconds>, option<std::vector<uint64_t>>)
+        template<typename T>
+        Command& option(const std::string& name, const std::string& help=""){
+            add_option(name, help);
+            Option& option = Options.back();
+            option.Type = value_type_of<T>();
+            if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>){
+                option.Min = static_cast<std::int64_t>(std::numeric_limits<T>::min());
+                option.Max = static_cast<std::uint64_t>(std::numeric_limits<T>::max());
+            } else if constexpr (is_uint_list<T>::value){
+                option.Max = static_cast<std::uint64_t>(std::numeric_limits<typename T::value_type>::max());
+            }
             return *this;
         }
 
-        bool set_flag(const std::string& name){
-            for(auto& flag : Flags){
-                if(flag.Name == name){
-                    flag.FlagSet = true;
-                    return true;
-                }
+        // Enum option accepting the given names
+        template<typename T>
+        Command& option(const std::string& name, const std::string& help, std::initializer_list<std::pair<std::string_view, T>> choices){
+            static_assert(std::is_enum_v<T>, "NCLI: choices are only supported for enum options");
+            option<T>(name, help);
+            for(const auto& choice : choices){
+                Options.back().Choices.emplace_back(std::string(choice.first), static_cast<std::int64_t>(choice.second));
             }
-            return false;
+            return *this;
         }
 
-        bool set_option(const std::string& name, const std::string& value){
-            for(auto& option : Options){
-                if(option.Name == name){
-                    option.Value = value;
-                    option.Set = true;
-                    return true;
-                }
+        // Values offered for an option in shell completion (see
+        // CLI::complete); only called when that option's value is completed
+        Command& completer(const std::string& name, OptionCompleter complete){
+            if(Option* option = find_option(name)){
+                option->Complete = std::move(complete);
             }
-            return false;
+            return *this;
         }
 
-        bool set_option_vector(const std::string& name, const std::vector<std::string> values)
-        {
-            for(auto& option : Options) {
-                if(option.Name == name) {
-                    if(!option.Value.empty()){
-                        if (std::find(option.Values.begin(), option.Values.end(), option.Value) != option.Values.end())
-                        {
-                            option.Values.insert(option.Values.begin(), option.Value);
-                        }
-                    } else if(!values.empty()) {
-                        option.Value = values.front();
-                    }
-                    for(const auto& value : values)
-                    {
-                        option.Values.push_back(value);
-                    }
-                    option.Set = true;
-                    return true;
-                }
+        // Accepts bool(const ParsedArgs&), or the original bool(flags, options)
+        template<typename Func>
+        Command& action(Func&& action){
+            if constexpr (std::is_invocable_r_v<bool, Func&, const ParsedArgs&>){
+                Function = std::forward<Func>(action);
+            } else {
+                Function = adapt(CommandFunc(std::forward<Func>(action)));
             }
-            return false;
+            return *this;
+        }
+
+#ifdef NCLI_ASYNC
+        // Coroutine action, Task<bool>(const ParsedArgs&), run to completion
+        // on an EventLoop of its own: it can co_await sleep_for(), readable(),
+        // writable() and other tasks, and Ctrl-C cancels it (CancelledError)
+        template<typename Func>
+        Command& action_async(Func&& action){
+            Function = [action = std::forward<Func>(action)](const ParsedArgs& args){
+                EventLoop loop;
+                return loop.run(Task<bool>(action(args)));
+            };
+            return *this;
+        }
+#endif
+
+        // The action may run alongside other lines of a parallel batch
+        // (CLI::run_script_parallel): it only touches thread-safe state and
+        // prints through Output::standard(), which is collected per line
+        Command& parallel_safe(bool safe=true){
+            ParallelSafe = safe;
+            return *this;
         }
 
-        bool execute(){
-            // Collect flags that are set
-            std::vector<Flag> flags;
-            if(!Flags.empty()){
-                for(auto& flag : Flags){
-                    if(flag.FlagSet){
-                        std::cout << "Flag: " << flag.Name << "\n"; 
+        // Wraps an original-style action, copying the set flags and options
+        // into the vectors it expects
+        static ActionFunc adapt(CommandFunc func){
+            if(!func){
+                return nullptr;
+            }
+            return [func](const ParsedArgs& args){
+                std::vector<Flag> flags;
+                for(const auto& flag : args.command().Flags){
+                    if(args.flag(flag.Name)){
                         flags.push_back(flag);
+                        flags.back().FlagSet = true;
                     }
                 }
-            }
-            // Collect options that are set
-            std::vector<Option> options = { Option{} };
-            if(!Options.empty()){
-                for(auto& opt : Options){
-                    if(opt.Set){
-                        std::cout << "Option: " << opt.Name << "\n";
+                // Starts with an empty Option, as the original signature always did
+                std::vector<Option> options = { Option{} };
+                for(const auto& opt : args.command().Options){
+                    if(args.option(opt.Name) != nullptr){
                         options.push_back(opt);
+                        Option& copy = options.back();
+                        copy.reset();
+                        for(std::string_view value : args.values(opt.Name)){
+                            add_value(copy, value);
+                        }
                     }
                 }
+                return func(flags, options);
+            };
+        }
+
+        Flag* find_flag(std::string_view name){
+            std::uint32_t at = m_FlagIndex.find(name);
+            return at != NameIndex::npos ? &Flags[at] : nullptr;
+        }
+        const Flag* find_flag(std::string_view name) const {
+            std::uint32_t at = m_FlagIndex.find(name);
+            return at != NameIndex::npos ? &Flags[at] : nullptr;
+        }
+
+        Option* find_option(std::string_view name){
+            std::uint32_t at = m_OptionIndex.find(name);
+            return at != NameIndex::npos ? &Options[at] : nullptr;
+        }
+        const Option* find_option(std::string_view name) const {
+            std::uint32_t at = m_OptionIndex.find(name);
+            return at != NameIndex::npos ? &Options[at] : nullptr;
+        }
+
+        // Rebuild the lookup indexes, needed only if Flags/Options were edited directly
+        void reindex(){
+            build_name_index(m_FlagIndex, Flags);
+            build_name_index(m_OptionIndex, Options);
+            m_SetFlags.clear();
+            for(std::size_t i = 0; i < Flags.size(); ++i){
+                if(Flags[i].FlagSet){
+                    m_SetFlags.push_back(static_cast<std::uint32_t>(i));
+                }
+            }
+            m_SetOptions.clear();
+            for(std::size_t i = 0; i < Options.size(); ++i){
+                if(Options[i].Set){
+                    m_SetOptions.push_back(static_cast<std::uint32_t>(i));
+                }
+            }
+        }
+
+        // Clear what parsing and the set_* calls stored on this command, so it
+        // can be parsed again. Only the flags and options that were set are
+        // visited, however many the command has.
+        void reset(){
+            for(std::uint32_t at : m_SetFlags){
+                if(at < Flags.size()){
+                    Flags[at].FlagSet = false;
+                }
+            }
+            for(std::uint32_t at : m_SetOptions){
+                if(at < Options.size()){
+                    Options[at].reset();
+                }
+            }
+            m_SetFlags.clear();
+            m_SetOptions.clear();
+        }
+
+        bool set_flag(std::string_view name){
+            NCLI_TRACE_SCOPE(SetOption, "set_flag");
+            Flag* flag = find_flag(name);
+            if(flag == nullptr){
+                return false;
+            }
+            mark_flag(*flag);
+            return true;
+        }
+
+        // The option keeps a view of value; the caller owns the storage
+        bool set_option(std::string_view name, std::string_view value){
+            NCLI_TRACE_SCOPE(SetOption, "set_option");
+            Option* option = find_option(name);
+            if(option == nullptr){
+                return false;
+            }
+            add_value(mark_option(*option), value);
+            return true;
+        }
+
+        // Replaces whatever the option held before
+        bool set_option_vector(std::string_view name, const std::vector<std::string_view>& values)
+        {
+            NCLI_TRACE_SCOPE(SetOption, "set_option_vector");
+            Option* option = find_option(name);
+            if(option == nullptr){
+                return false;
+            }
+            mark_option(*option).reset();
+            for(const auto& value : values)
+            {
+                add_value(*option, value);
             }
-            return Function(flags, options);
+            return true;
+        }
+
+        // The first value given replaces the default, later ones are appended.
+        // Typed options convert the first value (every value for lists).
+        static ConvertResult add_value(Option& option, std::string_view value){
+            bool first = !option.Set;
+            if(first){
+                option.Value = value;
+                option.Set = true;
+            }
+            option.Values.push_back(value);
+            if(first || option.Type == ValueType::UIntList){
+                return option.convert(value);
+            }
+            return {};
+        }
+
+        bool execute(const Command* global=nullptr) const {
+            NCLI_TRACE_SCOPE(Execute, "execute");
+            if(!Function){
+                return false;
+            }
+            return Function(ParsedArgs(*this, global));
+        }
+
+        // Run the action on a command line parsed into result
+        bool execute(const ParseResult& result) const {
+            NCLI_TRACE_SCOPE(Execute, "execute");
+            if(!Function){
+                return false;
+            }
+            return Function(ParsedArgs(result));
         }
         
-        void display_help(){
-            std::cout << Color::cyan(Color::bold("Command: ")) << Color::green(Name) << "\n";
-            std::cout << Color::cyan(Color::bold("  Usage: ")) << Color::italic(Help) << "\n";
-            std::cout << Color::cyan(Color::bold("  Options:\n"));
+        void display_help(Output& output = Output::standard()) const {
+            NCLI_TRACE_SCOPE(Render, "display_help");
+            Output::Frame frame(output);
+            StyledWriter out(output.buffer());
+            const Style heading = Style::cyan().bold();
+            out.write(heading, "Command: ").write(Style::green(), Name).end_line();
+            out.write(heading, "  Usage: ").write(Style{}.italic(), Help).end_line();
+            out.write(heading, "  Options:").end_line();
             for(const auto& option : Options){
                 if(option.Set){
-                    std::cout << Color::green("    [x] --" + option.Name) << ": " << Color::italic(option.Help) << "\n";
-                    std::cout << Color::green("            Current Value: ") << Color::bold(option.Value) << "\n";
+                    out.write(Style::green(), "    [x] --").write(Style::green(), option.Name).write(": ").write(Style{}.italic(), option.Help).end_line();
+                    out.write(Style::green(), "            Current Value: ").write(Style{}.bold(), option.Value).end_line();
                 } else {
-                    std::cout << Color::yellow("    [ ] --" + option.Name) << ": " << Color::italic(option.Help) << "\n";
+                    out.write(Style::yellow(), "    [ ] --").write(Style::yellow(), option.Name).write(": ").write(Style{}.italic(), option.Help).end_line();
                 }
             }
-            std::cout << Color::cyan(Color::bold("  Flags:\n"));
+            out.write(heading, "  Flags:").end_line();
             for(const auto& flag : Flags){
-                if(flag.FlagSet){
-                    std::cout << Color::green("    [x] -" + flag.Name) << ": " << Color::italic(flag.Help) << "\n";
-                } else {
-                    std::cout << Color::yellow("    [ ] -" + flag.Name) << ": " << Color::italic(flag.Help) << "\n";
-                }
+                const Style mark = flag.FlagSet ? Style::green() : Style::yellow();
+                out.write(mark, flag.FlagSet ? "    [x] -" : "    [ ] -").write(mark, flag.Name).write(": ").write(Style{}.italic(), flag.Help).end_line();
+            }
+        }
+
+    private:
+        friend class CLI;
+
+        NameIndex m_FlagIndex;
+        NameIndex m_OptionIndex;
+        // Positions of the flags and options set since the last reset()
+        std::vector<std::uint32_t> m_SetFlags;
+        std::vector<std::uint32_t> m_SetOptions;
+
+        void mark_flag(Flag& flag){
+            if(!flag.FlagSet){
+                flag.FlagSet = true;
+                m_SetFlags.push_back(static_cast<std::uint32_t>(&flag - Flags.data()));
+            }
+        }
+
+        // Call before the option is given a value
+        Option& mark_option(Option& option){
+            if(!option.Set){
+                m_SetOptions.push_back(static_cast<std::uint32_t>(&option - Options.data()));
             }
+            return option;
         }
     };
+
+    // Everything one parse produced, kept apart from the commands so the same
+    // CLI can parse any number of command lines (see CLI::parse_into). Flags
+    // and options live in slots: the CLI's global ones first, then those of
+    // the command given. A ParseResult that is reused keeps its capacity, so
+    // once warm, parsing into it does not allocate.
+    class ParseResult {
+        public:
+            enum class Error { None, MissingValue, InvalidValue, UnknownOption, UnknownFlag };
+
+            ParseResult() = default;
+            // Everything the result stores (slots, value lists, converted
+            // lists) comes from resource, e.g. a monotonic_buffer_resource per
+            // request that is released in one step once the request is done
+            explicit ParseResult(std::pmr::memory_resource* resource)
+                : m_Flags(resource), m_Options(resource), m_SetFlags(resource), m_SetOptions(resource) {}
+
+            bool ok() const { return m_Error == Error::None; }
+            Error error() const { return m_Error; }
+            std::string_view error_name() const { return m_ErrorName; }   // Option or flag at fault
+            std::string_view error_value() const { return m_ErrorValue; } // Value that failed to convert
+            int error_index() const { return m_ErrorIndex; }              // Position in argv
+            const ConvertResult& conversion() const { return m_Conversion; }
+
+            // Description of the error, as printed by CLI::parse
+            std::string message() const {
+                switch(m_Error){
+                    case Error::None:
+                        return {};
+                    case Error::MissingValue:
+                        return "Missing value for option " + std::string(m_ErrorName);
+                    case Error::InvalidValue:
+                        return "Invalid value '" + std::string(m_ErrorValue) + "' for option " + std::string(m_ErrorName) +
+                               " (argument " + std::to_string(m_ErrorIndex) + ", column " + std::to_string(m_Conversion.Column + 1) +
+                               "): expected " + m_Conversion.Expected;
+                    case Error::UnknownOption:
+                        return "Unknown option: " + std::string(m_ErrorName);
+                    case Error::UnknownFlag:
+                        return "Unknown flag: " + std::string(m_ErrorName);
+                }
+                return {};
+            }
+
+            // No arguments, --help or -h
+            bool help() const { return m_Help; }
+            // Command word as given (the last one, if several)
+            std::string_view command_name() const { return m_CommandName; }
+            // The command, or nullptr if none was given or the name is unknown
+            const Command* command() const { return m_Command; }
+
+            bool flag(std::string_view name) const {
+                std::size_t slot = flag_slot(name);
+                return slot != npos && m_Flags[slot];
+            }
+            // Parsed state of the option if it was given, otherwise nullptr
+            const OptionValue* option(std::string_view name) const {
+                std::size_t slot = option_slot(name);
+                return slot != npos && m_Options[slot].Set ? &m_Options[slot] : nullptr;
+            }
+            // Definition of an option of the global set or the command
+            const Option* definition(std::string_view name) const {
+                std::size_t slot = option_slot(name);
+                return slot != npos ? &option_at(slot) : nullptr;
+            }
+            // First value of the option, its default, or fallback
+            std::string_view value(std::string_view name, std::string_view fallback="") const {
+                std::size_t slot = option_slot(name);
+                if(slot == npos){
+                    return fallback;
+                }
+                std::string_view value = m_Options[slot].Set ? m_Options[slot].Value : option_at(slot).Default;
+                return value.empty() ? fallback : value;
+            }
+            const ValueList& values(std::string_view name) const {
+                static const ValueList none;
+                const OptionValue* state = option(name);
+                return state != nullptr ? state->Values : none;
+            }
+            template<typename T>
+            T get(std::string_view name, T fallback=T()) const {
+                std::size_t slot = option_slot(name);
+                if(slot == npos || !m_Options[slot].Set){
+                    return fallback;
+                }
+                return option_at(slot).template get<T>(m_Options[slot].Value, m_Options[slot].Typed);
+            }
+            const std::pmr::vector<std::uint64_t>& list(std::string_view name) const {
+                static const std::pmr::vector<std::uint64_t> none;
+                const OptionValue* state = option(name);
+                return state != nullptr ? state->Typed.List : none;
+            }
+
+        private:
+            friend class CLI;
+            static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+            const Command* m_Global = nullptr;
+            const Command* m_Command = nullptr;
+            std::string_view m_CommandName;
+            bool m_Help = false;
+            // Slots, sized for the widest command seen so far. Only the slots
+            // listed in m_SetFlags/m_SetOptions hold anything, so starting over
+            // costs what the last parse set rather than the width of the schema.
+            std::pmr::vector<std::uint8_t> m_Flags;
+            std::pmr::vector<OptionValue> m_Options;
+            std::pmr::vector<std::uint32_t> m_SetFlags;
+            std::pmr::vector<std::uint32_t> m_SetOptions;
+
+            Error m_Error = Error::None;
+            std::string_view m_ErrorName;
+            std::string_view m_ErrorValue;
+            int m_ErrorIndex = 0;
+            ConvertResult m_Conversion;
+
+            // Start over for a new parse against global
+            void clear(const Command& global){
+                m_Global = &global;
+                m_Command = nullptr;
+                m_CommandName = {};
+                m_Help = false;
+                m_Error = Error::None;
+                m_ErrorName = {};
+                m_ErrorValue = {};
+                m_ErrorIndex = 0;
+                m_Conversion = ConvertResult{};
+                use(0, global.Flags.size(), 0, global.Options.size());
+            }
+
+            // Switch to a command (or none); the global slots are kept
+            void select(const Command* command, std::string_view name){
+                m_Command = command;
+                m_CommandName = name;
+                std::size_t flags = m_Global->Flags.size();
+                std::size_t options = m_Global->Options.size();
+                use(flags, flags + (command != nullptr ? command->Flags.size() : 0),
+                    options, options + (command != nullptr ? command->Options.size() : 0));
+            }
+
+            // Make room for flags/options slots, and clear those set from first_flag/first_option on
+            void use(std::size_t first_flag, std::size_t flags, std::size_t first_option, std::size_t options){
+                if(m_Flags.size() < flags){
+                    m_Flags.resize(flags);
+                }
+                if(m_Options.size() < options){
+                    m_Options.resize(options);
+                }
+                auto flag_end = std::remove_if(m_SetFlags.begin(), m_SetFlags.end(), [&](std::uint32_t slot){
+                    if(slot < first_flag){
+                        return false;
+                    }
+                    m_Flags[slot] = 0;
+                    return true;
+                });
+                m_SetFlags.erase(flag_end, m_SetFlags.end());
+                auto option_end = std::remove_if(m_SetOptions.begin(), m_SetOptions.end(), [&](std::uint32_t slot){
+                    if(slot < first_option){
+                        return false;
+                    }
+                    m_Options[slot].clear();
+                    return true;
+                });
+                m_SetOptions.erase(option_end, m_SetOptions.end());
+            }
+
+            void set_flag(std::size_t slot){
+                if(!m_Flags[slot]){
+                    m_Flags[slot] = 1;
+                    m_SetFlags.push_back(static_cast<std::uint32_t>(slot));
+                }
+            }
+
+            // State of an option slot, about to be given a value
+            OptionValue& set_option(std::size_t slot){
+                if(!m_Options[slot].Set){
+                    m_SetOptions.push_back(static_cast<std::uint32_t>(slot));
+                }
+                return m_Options[slot];
+            }
+
+            std::size_t flag_slot(std::string_view name) const {
+                if(m_Global == nullptr){
+                    return npos;
+                }
+                if(const Flag* flag = m_Global->find_flag(name)){
+                    return static_cast<std::size_t>(flag - m_Global->Flags.data());
+                }
+                if(m_Command != nullptr){
+                    if(const Flag* flag = m_Command->find_flag(name)){
+                        return m_Global->Flags.size() + static_cast<std::size_t>(flag - m_Command->Flags.data());
+                    }
+                }
+                return npos;
+            }
+
+            std::size_t option_slot(std::string_view name) const {
+                if(m_Global == nullptr){
+                    return npos;
+                }
+                if(const Option* option = m_Global->find_option(name)){
+                    return static_cast<std::size_t>(option - m_Global->Options.data());
+                }
+                if(m_Command != nullptr){
+                    if(const Option* option = m_Command->find_option(name)){
+                        return m_Global->Options.size() + static_cast<std::size_t>(option - m_Command->Options.data());
+                    }
+                }
+                return npos;
+            }
+
+            const Option& option_at(std::size_t slot) const {
+                std::size_t globals = m_Global->Options.size();
+                return slot < globals ? m_Global->Options[slot] : m_Command->Options[slot - globals];
+            }
+
+            bool fail(Error error, std::string_view name, int index){
+                m_Error = error;
+                m_ErrorName = name;
+                m_ErrorIndex = index;
+                return false;
+            }
+    };
+
+    inline ParsedArgs::ParsedArgs(const ParseResult& result)
+        : m_Command(*result.command()), m_Global(nullptr), m_Result(&result) {}
+
+    inline const Flag* ParsedArgs::find_flag(std::string_view name) const {
+        const Flag* flag = m_Command.find_flag(name);
+        if(flag == nullptr && m_Global != nullptr){
+            flag = m_Global->find_flag(name);
+        }
+        return flag;
+    }
+
+    inline const Option* ParsedArgs::find_option(std::string_view name) const {
+        const Option* option = m_Command.find_option(name);
+        if(option == nullptr && m_Global != nullptr){
+            option = m_Global->find_option(name);
+        }
+        return option;
+    }
+
+    inline bool ParsedArgs::flag(std::string_view name) const {
+        if(m_Result != nullptr){
+            return m_Result->flag(name);
+        }
+        const Flag* flag = find_flag(name);
+        return flag != nullptr && flag->FlagSet;
+    }
+
+    inline const Option* ParsedArgs::option(std::string_view name) const {
+        if(m_Result != nullptr){
+            return m_Result->option(name) != nullptr ? m_Result->definition(name) : nullptr;
+        }
+        const Option* option = find_option(name);
+        return option != nullptr && option->Set ? option : nullptr;
+    }
+
+    inline std::string_view ParsedArgs::value(std::string_view name, std::string_view fallback) const {
+        if(m_Result != nullptr){
+            return m_Result->value(name, fallback);
+        }
+        const Option* option = find_option(name);
+        return option != nullptr && !option->Value.empty() ? option->Value : fallback;
+    }
+
+    inline const ValueList& ParsedArgs::values(std::string_view name) const {
+        if(m_Result != nullptr){
+            return m_Result->values(name);
+        }
+        static const ValueList none;
+        const Option* option = this->option(name);
+        return option != nullptr ? option->Values : none;
+    }
+
+    template<typename T>
+    T ParsedArgs::get(std::string_view name, T fallback) const {
+        if(m_Result != nullptr){
+            return m_Result->get<T>(name, fallback);
+        }
+        const Option* opt = option(name);
+        return opt != nullptr ? opt->get<T>() : fallback;
+    }
+
+    inline const std::pmr::vector<std::uint64_t>& ParsedArgs::list(std::string_view name) const {
+        if(m_Result != nullptr){
+            return m_Result->list(name);
+        }
+        static const std::pmr::vector<std::uint64_t> none;
+        const Option* option = this->option(name);
+        return option != nullptr ? option->Typed.List : none;
+    }
 } // namespace NCLI
\ No newline at end of file
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NCLI
+{
+    struct FuzzyMatch {
+        std::uint32_t Index;
+        std::int32_t Score;
+        std::uint32_t End; // Just past the last matched character
+    };
+
+    // Better score first, then original order
+    inline static bool fuzzy_better(const FuzzyMatch& a, const FuzzyMatch& b){
+        return a.Score != b.Score ? a.Score > b.Score : a.Index < b.Index;
+    }
+
+    // Case-insensitive subsequence matcher over a fixed candidate set.
+    //
+    // Candidates are folded to lower case once and stored back to back, each
+    // with a 64-bit mask of the characters it contains, so most non-matches
+    // are rejected by one AND before any text is touched, and the scan for
+    // each query character is a memchr over contiguous bytes.
+    //
+    // update() is incremental: extending the query only rescores the
+    // survivors of the previous query, and only for the new characters, since
+    // the leftmost match of a query starts with the leftmost match of its
+    // prefix. Shortening the query (backspace) goes back to the survivors
+    // already computed for the shorter query. Results are ordered lazily;
+    // at(pos) only sorts as far as pos. Large sets are scored in parallel,
+    // and a search made stale by new input can be cut short.
+    class FuzzyMatcher {
+        public:
+            static constexpr std::int32_t NoMatch = INT32_MIN;
+
+            // Large candidate sets are scored on pool, or on ThreadPool::shared()
+            // if none is given
+            explicit FuzzyMatcher(const std::vector<std::string>& candidates, ThreadPool* pool = nullptr)
+                : m_Pool(pool) {
+                std::size_t total = 0;
+                for(const std::string& candidate : candidates){
+                    total += candidate.size();
+                }
+                m_Text.reserve(total);
+                m_Bonus.reserve(total);
+                m_Offsets.reserve(candidates.size() + 1);
+                m_Masks.reserve(candidates.size());
+                for(const std::string& candidate : candidates){
+                    add(candidate);
+                }
+                m_Offsets.push_back(static_cast<std::uint32_t>(m_Text.size()));
+            }
+
+            std::size_t candidates() const { return m_Masks.size(); }
+            const std::string& query() const { return m_Query; }
+
+            // Number of candidates matching the current query
+            std::size_t size() const {
+                return m_Levels.empty() ? candidates() : m_Levels.back().Matches.size();
+            }
+
+            // Candidate index of the pos-th best match. With an empty query
+            // every candidate matches, in its original order.
+            std::uint32_t at(std::size_t pos){
+                if(m_Levels.empty()){
+                    return static_cast<std::uint32_t>(pos);
+                }
+                sort_to(m_Levels.back(), pos + 1);
+                return m_Levels.back().Matches[pos].Index;
+            }
+
+            // The best k matches, best first (fewer if fewer match)
+            const FuzzyMatch* top(std::size_t k){
+                if(m_Levels.empty()){
+                    return nullptr;
+                }
+                sort_to(m_Levels.back(), k);
+                return m_Levels.back().Matches.data();
+            }
+
+            // Match against query. interrupted, if given, is polled between
+            // chunks of work (possibly from pool threads); when it returns true
+            // the search stops and update() returns false, leaving the matches
+            // of the longest prefix of query already computed. Calling update()
+            // again resumes from there.
+            bool update(std::string_view query, const std::function<bool()>& interrupted = nullptr){
+                std::string folded(query);
+                for(char& c : folded){
+                    c = fold(c);
+                }
+                std::size_t common = 0;
+                while(common < folded.size() && common < m_Query.size() && folded[common] == m_Query[common]){
+                    ++common;
+                }
+                // Survivors of any query that is still a prefix remain valid
+                while(!m_Levels.empty() && m_Levels.back().Length > common){
+                    m_Levels.pop_back();
+                }
+                m_Query = std::move(folded);
+                if(m_Query.size() > (m_Levels.empty() ? 0 : m_Levels.back().Length)){
+                    return narrow(interrupted);
+                }
+                return true;
+            }
+
+            // Score of candidate i against a folded query, or NoMatch
+            std::int32_t score(std::uint32_t i, std::string_view query) const {
+                FuzzyMatch match{i, length_penalty(i), 0};
+                return extend(match, query, true) ? match.Score : NoMatch;
+            }
+
+        private:
+            static constexpr std::int32_t MatchScore = 16;
+            static constexpr std::int32_t ConsecutiveBonus = 8;
+            static constexpr std::size_t MaxGapPenalty = 8;
+            static constexpr std::uint8_t WordBonus = 8;  // First character or after a separator
+            static constexpr std::uint8_t CamelBonus = 6; // Upper case after lower case
+            static constexpr std::size_t ChunkSize = 16384;
+            static constexpr std::size_t ParallelThreshold = 4 * ChunkSize;
+            static constexpr std::size_t TopK = 64; // Matches ranked while filtering
+
+            struct Level {
+                std::size_t Length = 0; // Query length this level was computed for
+                std::vector<FuzzyMatch> Matches;
+                std::size_t Sorted = 0; // Matches[0, Sorted) are the best, in order
+            };
+
+            std::string m_Text; // All candidates, folded, back to back
+            std::vector<std::uint8_t> m_Bonus;
+            std::vector<std::uint32_t> m_Offsets;
+            std::vector<std::uint64_t> m_Masks;
+            std::string m_Query;
+            std::vector<Level> m_Levels;
+            ThreadPool* m_Pool;
+            std::vector<std::vector<FuzzyMatch>> m_Parts; // Per-chunk results, reused
+            std::vector<std::size_t> m_Taken;
+
+            static char fold(char c){
+                return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+            }
+
+            static bool separator(char c){
+                return c == ' ' || c == '-' || c == '_' || c == '/' || c == '.' || c == ':' || c == ',';
+            }
+
+            // Which of the 64 mask bits a folded character sets
+            static std::uint64_t bit(char c){
+                unsigned char u = static_cast<unsigned char>(c);
+                if(u >= 'a' && u <= 'z'){
+                    return 1ull << (u - 'a');
+                }
+                if(u >= '0' && u <= '9'){
+                    return 1ull << (26 + u - '0');
+                }
+                if(u < 0x80){
+                    return 1ull << (36 + u % 27);
+                }
+                return 1ull << 63;
+            }
+
+            static std::uint64_t mask(std::string_view folded){
+                std::uint64_t m = 0;
+                for(char c : folded){
+                    m |= bit(c);
+                }
+                return m;
+            }
+
+            // Prefer shorter candidates among otherwise equal matches
+            std::int32_t length_penalty(std::uint32_t i) const {
+                return -static_cast<std::int32_t>(std::min<std::size_t>((m_Offsets[i + 1] - m_Offsets[i]) / 8, MaxGapPenalty));
+            }
+
+            // Match more query characters after match.End, updating its score
+            bool extend(FuzzyMatch& match, std::string_view more, bool first) const {
+                const char* text = m_Text.data() + m_Offsets[match.Index];
+                const std::uint8_t* bonus = m_Bonus.data() + m_Offsets[match.Index];
+                std::size_t length = m_Offsets[match.Index + 1] - m_Offsets[match.Index];
+                std::size_t from = match.End;
+                for(char c : more){
+                    const void* hit = std::memchr(text + from, c, length - from);
+                    if(hit == nullptr){
+                        return false;
+                    }
+                    std::size_t at = static_cast<std::size_t>(static_cast<const char*>(hit) - text);
+                    std::size_t gap = at - from;
+                    match.Score += MatchScore + bonus[at];
+                    match.Score += (!first && gap == 0) ? ConsecutiveBonus : -static_cast<std::int32_t>(std::min<std::size_t>(gap, MaxGapPenalty));
+                    from = at + 1;
+                    first = false;
+                }
+                match.End = static_cast<std::uint32_t>(from);
+                return true;
+            }
+
+            void add(const std::string& candidate){
+                m_Offsets.push_back(static_cast<std::uint32_t>(m_Text.size()));
+                std::uint64_t m = 0;
+                char previous = ' ';
+                for(char c : candidate){
+                    char folded = fold(c);
+                    std::uint8_t bonus = 0;
+                    if(separator(previous)){
+                        bonus = WordBonus;
+                    } else if(c != folded && previous == fold(previous) && !separator(c)){
+                        bonus = CamelBonus;
+                    }
+                    m_Text.push_back(folded);
+                    m_Bonus.push_back(bonus);
+                    m |= bit(folded);
+                    previous = c;
+                }
+                m_Masks.push_back(m);
+            }
+
+            // Push a level for m_Query, rescoring only the previous survivors.
+            // The work is cut into chunks, spread over the pool when there is
+            // enough of it; each chunk keeps its own best TopK in front, and
+            // those are merged at the end. Returns false, pushing nothing, if
+            // interrupted() reports newer input between chunks.
+            bool narrow(const std::function<bool()>& interrupted){
+                const Level* previous = m_Levels.empty() ? nullptr : &m_Levels.back();
+                std::size_t total = previous != nullptr ? previous->Matches.size() : m_Masks.size();
+                std::string_view query = m_Query;
+                std::string_view more = previous != nullptr ? query.substr(previous->Length) : query;
+                std::uint64_t needed = mask(query);
+                std::size_t chunks = (total + ChunkSize - 1) / ChunkSize;
+                m_Parts.resize(chunks);
+                std::atomic<bool> cancelled{false};
+                auto run = [&](std::size_t chunk){
+                    if(cancelled.load(std::memory_order_relaxed)){
+                        return;
+                    }
+                    if(interrupted && interrupted()){
+                        cancelled.store(true, std::memory_order_relaxed);
+                        return;
+                    }
+                    std::size_t begin = chunk * ChunkSize;
+                    std::size_t end = std::min(total, begin + ChunkSize);
+                    std::vector<FuzzyMatch>& out = m_Parts[chunk];
+                    out.clear();
+                    if(previous != nullptr){
+                        for(std::size_t i = begin; i < end; ++i){
+                            FuzzyMatch match = previous->Matches[i];
+                            if((m_Masks[match.Index] & needed) == needed && extend(match, more, false)){
+                                out.push_back(match);
+                            }
+                        }
+                    } else {
+                        const std::uint64_t* masks = m_Masks.data();
+                        for(std::size_t i = begin; i < end; ++i){
+                            if((masks[i] & needed) != needed){
+                                continue;
+                            }
+                            FuzzyMatch match{static_cast<std::uint32_t>(i), length_penalty(static_cast<std::uint32_t>(i)), 0};
+                            if(extend(match, query, true)){
+                                out.push_back(match);
+                            }
+                        }
+                    }
+                    std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(std::min(TopK, out.size())), out.end(), fuzzy_better);
+                };
+                if(chunks > 1 && total >= ParallelThreshold){
+                    ThreadPool& pool = m_Pool != nullptr ? *m_Pool : ThreadPool::shared();
+                    pool.parallel_for(chunks, run);
+                } else {
+                    for(std::size_t chunk = 0; chunk < chunks; ++chunk){
+                        run(chunk);
+                    }
+                }
+                if(cancelled.load()){
+                    return false;
+                }
+                Level level;
+                level.Length = m_Query.size();
+                merge(level);
+                m_Levels.push_back(std::move(level));
+                return true;
+            }
+
+            // Best TopK of all chunks first (a merge of their sorted fronts), then the rest
+            void merge(Level& level){
+                std::size_t total = 0;
+                for(const std::vector<FuzzyMatch>& part : m_Parts){
+                    total += part.size();
+                }
+                level.Matches.reserve(total);
+                m_Taken.assign(m_Parts.size(), 0);
+                std::size_t best_count = std::min(TopK, total);
+                for(std::size_t n = 0; n < best_count; ++n){
+                    std::size_t best = m_Parts.size();
+                    for(std::size_t c = 0; c < m_Parts.size(); ++c){
+                        if(m_Taken[c] < std::min(TopK, m_Parts[c].size()) &&
+                           (best == m_Parts.size() || fuzzy_better(m_Parts[c][m_Taken[c]], m_Parts[best][m_Taken[best]]))){
+                            best = c;
+                        }
+                    }
+                    level.Matches.push_back(m_Parts[best][m_Taken[best]++]);
+                }
+                for(std::size_t c = 0; c < m_Parts.size(); ++c){
+                    level.Matches.insert(level.Matches.end(), m_Parts[c].begin() + static_cast<std::ptrdiff_t>(m_Taken[c]), m_Parts[c].end());
+                }
+                level.Sorted = best_count;
+            }
+
+            // Partial sort so the first count matches are final. Grows
+            // geometrically, so scrolling down a long result stays cheap.
+            static void sort_to(Level& level, std::size_t count){
+                std::vector<FuzzyMatch>& matches = level.Matches;
+                if(count <= level.Sorted || level.Sorted == matches.size()){
+                    return;
+                }
+                std::size_t target = std::min(matches.size(), std::max({count, level.Sorted * 2, TopK}));
+                std::partial_sort(matches.begin() + static_cast<std::ptrdiff_t>(level.Sorted),
+                                  matches.begin() + static_cast<std::ptrdiff_t>(target),
+                                  matches.end(), fuzzy_better);
+                level.Sorted = target;
+            }
+    };
+} // namespace NCLI
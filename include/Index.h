@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NCLI
+{
+    // FNV-1a, used to key the name indexes below
+    inline static constexpr std::uint32_t hash_name(std::string_view name){
+        std::uint32_t hash = 2166136261u;
+        for(char c : name){
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    // Open-addressing (linear probing) index from a name to its position in a
+    // container. Names are interned back to back in one string table and each
+    // slot keeps the hash, position and place of its name, so a lookup reads
+    // the slot array and the table only, never the (much larger) items.
+    // Positions stay valid when the container reallocates.
+    class NameIndex {
+        public:
+            static constexpr std::uint32_t npos = UINT32_MAX;
+
+            bool insert(std::string_view name, std::uint32_t index){
+                if((m_Size + 1) * 4 > m_Slots.size() * 3){
+                    grow();
+                }
+                std::uint32_t hash = hash_name(name);
+                std::size_t mask = m_Slots.size() - 1;
+                for(std::size_t i = hash & mask;; i = (i + 1) & mask){
+                    Slot& slot = m_Slots[i];
+                    if(slot.Index == npos){
+                        slot = {hash, index, static_cast<std::uint32_t>(m_Names.size()), static_cast<std::uint32_t>(name.size())};
+                        m_Order.push_back({slot.Offset, index});
+                        m_Names.append(name);
+                        ++m_Size;
+                        return true;
+                    }
+                    // Keep the first registration, like the old linear scan did
+                    if(matches(slot, hash, name)){
+                        return false;
+                    }
+                }
+            }
+
+            std::uint32_t find(std::string_view name) const {
+                if(m_Size == 0){
+                    return npos;
+                }
+                std::uint32_t hash = hash_name(name);
+                std::size_t mask = m_Slots.size() - 1;
+                for(std::size_t i = hash & mask;; i = (i + 1) & mask){
+                    const Slot& slot = m_Slots[i];
+                    if(slot.Index == npos){
+                        return npos;
+                    }
+                    if(matches(slot, hash, name)){
+                        return slot.Index;
+                    }
+                }
+            }
+
+            // Call fn(name, position) for every name starting with prefix, in
+            // insertion order. One pass over the packed names, for completion.
+            template<typename Fn>
+            void each_prefixed(std::string_view prefix, Fn&& fn) const {
+                for(std::size_t i = 0; i < m_Order.size(); ++i){
+                    std::size_t begin = m_Order[i].Offset;
+                    std::size_t end = i + 1 < m_Order.size() ? m_Order[i + 1].Offset : m_Names.size();
+                    if(end - begin >= prefix.size() && std::char_traits<char>::compare(m_Names.data() + begin, prefix.data(), prefix.size()) == 0){
+                        fn(std::string_view(m_Names.data() + begin, end - begin), m_Order[i].Index);
+                    }
+                }
+            }
+
+            void clear(){
+                m_Slots.clear();
+                m_Order.clear();
+                m_Names.clear();
+                m_Size = 0;
+            }
+
+            std::size_t size() const { return m_Size; }
+
+        private:
+            struct Slot {
+                std::uint32_t Hash = 0;
+                std::uint32_t Index = npos;
+                std::uint32_t Offset = 0; // Name in m_Names
+                std::uint32_t Length = 0;
+            };
+            // Where each name starts in m_Names, in insertion order
+            struct Entry {
+                std::uint32_t Offset;
+                std::uint32_t Index;
+            };
+            std::vector<Slot> m_Slots;
+            std::vector<Entry> m_Order;
+            std::string m_Names;
+            std::size_t m_Size = 0;
+
+            bool matches(const Slot& slot, std::uint32_t hash, std::string_view name) const {
+                return slot.Hash == hash && slot.Length == name.size()
+                    && std::char_traits<char>::compare(m_Names.data() + slot.Offset, name.data(), name.size()) == 0;
+            }
+
+            void grow(){
+                std::vector<Slot> old;
+                old.swap(m_Slots);
+                m_Slots.resize(old.empty() ? 8 : old.size() * 2);
+                std::size_t mask = m_Slots.size() - 1;
+                for(const Slot& slot : old){
+                    if(slot.Index == npos){
+                        continue;
+                    }
+                    std::size_t i = slot.Hash & mask;
+                    while(m_Slots[i].Index != npos){
+                        i = (i + 1) & mask;
+                    }
+                    m_Slots[i] = slot;
+                }
+            }
+    };
+
+    // Build (or rebuild) an index over a vector of named items
+    template<typename T>
+    inline static void build_name_index(NameIndex& index, const std::vector<T>& items){
+        index.clear();
+        for(std::uint32_t i = 0; i < items.size(); ++i){
+            index.insert(items[i].Name, i);
+        }
+    }
+} // namespace NCLI
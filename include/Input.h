@@ -0,0 +1,266 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NCLI
+{
+    struct KeyEvent {
+        enum class Key {
+            None, Char, Enter, Tab, Backspace, Escape,
+            Up, Down, Left, Right, Home, End, PageUp, PageDown, Insert, Delete,
+            Ctrl, Paste, Unknown
+        };
+        Key Type = Key::None;
+        char32_t Codepoint = 0; // Char: the character; Ctrl: the letter, e.g. 'c' for Ctrl-C
+        std::string Text;       // Char: its UTF-8 bytes; Paste: the pasted text
+    };
+
+    // Incremental decoder from raw terminal bytes to KeyEvents. Bytes can be
+    // fed in any split (one at a time or a whole pasted buffer); each byte is
+    // looked at once. A sequence still open when input pauses (a bare Escape,
+    // say) is completed by timeout().
+    class InputDecoder {
+        public:
+            void feed(unsigned char byte){
+                switch(m_State){
+                    case State::Ground: ground(byte); break;
+                    case State::Escape: escape(byte); break;
+                    case State::Csi: csi(byte); break;
+                    case State::Ss3: ss3(byte); break;
+                    case State::Utf8: utf8(byte); break;
+                    case State::Paste: paste(byte); break;
+                }
+            }
+
+            void feed(std::string_view bytes){
+                for(char c : bytes){
+                    feed(static_cast<unsigned char>(c));
+                }
+            }
+
+            // Next decoded event, if any
+            bool next(KeyEvent& event){
+                if(m_Read == m_Events.size()){
+                    return false;
+                }
+                event = std::move(m_Events[m_Read++]);
+                if(m_Read == m_Events.size()){
+                    m_Events.clear();
+                    m_Read = 0;
+                }
+                return true;
+            }
+
+            // True if next() has an event
+            bool queued() const { return m_Read < m_Events.size(); }
+
+            // True while in the middle of a sequence that a pause should complete
+            bool pending() const {
+                return m_State == State::Escape || m_State == State::Csi || m_State == State::Ss3 || m_State == State::Utf8;
+            }
+
+            // Input paused mid-sequence: a lone ESC is the Escape key, anything else is dropped
+            void timeout(){
+                if(m_State == State::Escape){
+                    emit(KeyEvent::Key::Escape);
+                } else if(pending()){
+                    emit(KeyEvent::Key::Unknown);
+                }
+                m_State = State::Ground;
+            }
+
+        private:
+            enum class State { Ground, Escape, Csi, Ss3, Utf8, Paste };
+            State m_State = State::Ground;
+            std::vector<KeyEvent> m_Events;
+            std::size_t m_Read = 0;
+            std::string m_Params;   // CSI parameter bytes
+            std::string m_Pending;  // UTF-8 bytes of the character being decoded
+            char32_t m_Codepoint = 0;
+            int m_Remaining = 0;
+            std::string m_Paste;
+
+            KeyEvent& emit(KeyEvent::Key type, char32_t codepoint=0){
+                m_Events.emplace_back();
+                KeyEvent& event = m_Events.back();
+                event.Type = type;
+                event.Codepoint = codepoint;
+                return event;
+            }
+
+            void ground(unsigned char byte){
+                if(byte == 0x1b){
+                    m_State = State::Escape;
+                } else if(byte == '\r' || byte == '\n'){
+                    emit(KeyEvent::Key::Enter);
+                } else if(byte == '\t'){
+                    emit(KeyEvent::Key::Tab);
+                } else if(byte == 0x7f || byte == 0x08){
+                    emit(KeyEvent::Key::Backspace);
+                } else if(byte < 0x20){
+                    emit(KeyEvent::Key::Ctrl, U'a' + byte - 1);
+                } else if(byte < 0x80){
+                    emit(KeyEvent::Key::Char, byte).Text.assign(1, static_cast<char>(byte));
+                } else if(byte >= 0xc2 && byte <= 0xf4){
+                    // UTF-8 lead byte
+                    m_Remaining = byte >= 0xf0 ? 3 : byte >= 0xe0 ? 2 : 1;
+                    m_Codepoint = byte & (0x3f >> m_Remaining);
+                    m_Pending.assign(1, static_cast<char>(byte));
+                    m_State = State::Utf8;
+                } else {
+                    emit(KeyEvent::Key::Unknown);
+                }
+            }
+
+            void escape(unsigned char byte){
+                if(byte == '['){
+                    m_Params.clear();
+                    m_State = State::Csi;
+                } else if(byte == 'O'){
+                    m_State = State::Ss3;
+                } else {
+                    // ESC followed by something else: the Escape key, then that byte
+                    emit(KeyEvent::Key::Escape);
+                    m_State = State::Ground;
+                    ground(byte);
+                }
+            }
+
+            void csi(unsigned char byte){
+                if(byte >= 0x20 && byte <= 0x3f){
+                    m_Params.push_back(static_cast<char>(byte));
+                    return;
+                }
+                m_State = State::Ground;
+                // Only the first parameter matters here; modifiers (e.g. 1;5A) are ignored
+                int param = 0;
+                for(char c : m_Params){
+                    if(c < '0' || c > '9'){
+                        break;
+                    }
+                    param = param * 10 + (c - '0');
+                }
+                switch(byte){
+                    case 'A': emit(KeyEvent::Key::Up); break;
+                    case 'B': emit(KeyEvent::Key::Down); break;
+                    case 'C': emit(KeyEvent::Key::Right); break;
+                    case 'D': emit(KeyEvent::Key::Left); break;
+                    case 'H': emit(KeyEvent::Key::Home); break;
+                    case 'F': emit(KeyEvent::Key::End); break;
+                    case '~':
+                        switch(param){
+                            case 1: case 7: emit(KeyEvent::Key::Home); break;
+                            case 4: case 8: emit(KeyEvent::Key::End); break;
+                            case 2: emit(KeyEvent::Key::Insert); break;
+                            case 3: emit(KeyEvent::Key::Delete); break;
+                            case 5: emit(KeyEvent::Key::PageUp); break;
+                            case 6: emit(KeyEvent::Key::PageDown); break;
+                            case 200:
+                                m_Paste.clear();
+                                m_State = State::Paste;
+                                break;
+                            default: emit(KeyEvent::Key::Unknown); break;
+                        }
+                        break;
+                    default: emit(KeyEvent::Key::Unknown); break;
+                }
+            }
+
+            void ss3(unsigned char byte){
+                m_State = State::Ground;
+                switch(byte){
+                    case 'A': emit(KeyEvent::Key::Up); break;
+                    case 'B': emit(KeyEvent::Key::Down); break;
+                    case 'C': emit(KeyEvent::Key::Right); break;
+                    case 'D': emit(KeyEvent::Key::Left); break;
+                    case 'H': emit(KeyEvent::Key::Home); break;
+                    case 'F': emit(KeyEvent::Key::End); break;
+                    default: emit(KeyEvent::Key::Unknown); break;
+                }
+            }
+
+            void utf8(unsigned char byte){
+                if((byte & 0xc0) != 0x80){
+                    // Truncated character; decode the byte on its own
+                    emit(KeyEvent::Key::Unknown);
+                    m_State = State::Ground;
+                    ground(byte);
+                    return;
+                }
+                m_Codepoint = (m_Codepoint << 6) | (byte & 0x3f);
+                m_Pending.push_back(static_cast<char>(byte));
+                if(--m_Remaining == 0){
+                    emit(KeyEvent::Key::Char, m_Codepoint).Text = m_Pending;
+                    m_State = State::Ground;
+                }
+            }
+
+            // Bracketed paste: everything up to ESC[201~ is one Paste event
+            void paste(unsigned char byte){
+                static constexpr std::string_view End = "\033[201~";
+                m_Paste.push_back(static_cast<char>(byte));
+                if(byte == '~' && m_Paste.size() >= End.size() &&
+                   std::string_view(m_Paste).substr(m_Paste.size() - End.size()) == End){
+                    m_Paste.resize(m_Paste.size() - End.size());
+                    emit(KeyEvent::Key::Paste).Text = std::move(m_Paste);
+                    m_Paste.clear();
+                    m_State = State::Ground;
+                }
+            }
+    };
+
+    // Reads KeyEvents from a RawTerminalSession through an InputDecoder.
+    // A sequence left open for escape_timeout_ms is completed, so a bare
+    // Escape never blocks. With paste enabled, bracketed paste mode is on
+    // while the reader exists and a paste arrives as one event.
+    class KeyReader {
+        public:
+            explicit KeyReader(RawTerminalSession& session, bool paste=false, int escape_timeout_ms=25)
+                : m_Session(session), m_Paste(paste), m_Timeout(escape_timeout_ms) {
+                if(m_Paste){
+                    Output::standard().write("\033[?2004h").flush();
+                }
+            }
+            ~KeyReader(){
+                if(m_Paste){
+                    Output::standard().write("\033[?2004l").flush();
+                }
+            }
+            KeyReader(const KeyReader&) = delete;
+            KeyReader& operator=(const KeyReader&) = delete;
+
+            // Blocks for the next event. Returns false if input ended or a
+            // signal (e.g. SIGWINCH) interrupted the read.
+            bool next(KeyEvent& event){
+                while(!m_Decoder.next(event)){
+                    if(m_Decoder.pending() && !m_Session.wait(m_Timeout)){
+                        m_Decoder.timeout();
+                        continue;
+                    }
+                    int byte = m_Session.read_byte();
+                    if(byte < 0){
+                        return false;
+                    }
+                    m_Decoder.feed(static_cast<unsigned char>(byte));
+                }
+                return true;
+            }
+
+            // True if next() can return without waiting for the terminal, e.g.
+            // while working through a paste; callers may skip redrawing
+            bool ready() const {
+                return m_Decoder.queued() || m_Session.buffered() > 0;
+            }
+
+            bool eof() const { return m_Session.eof(); }
+
+        private:
+            RawTerminalSession& m_Session;
+            InputDecoder m_Decoder;
+            bool m_Paste;
+            int m_Timeout;
+    };
+} // namespace NCLI
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <charconv>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NCLI
+{
+    // Columns text takes on screen: UTF-8 characters count one each and
+    // escape sequences (e.g. colors) count nothing
+    inline static std::size_t display_width(std::string_view text){
+        std::size_t width = 0;
+        for(std::size_t i = 0; i < text.size(); ++i){
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if(c == 0x1b && i + 1 < text.size() && text[i + 1] == '['){
+                i += 2;
+                while(i < text.size() && !(text[i] >= 0x40 && text[i] <= 0x7e)){
+                    ++i;
+                }
+            } else if((c & 0xc0) != 0x80){
+                ++width;
+            }
+        }
+        return width;
+    }
+
+    // Single-line editor with history, driven by KeyEvents. Supports
+    // Left/Right, Home/End (Ctrl-A/Ctrl-E), Backspace/Delete, Ctrl-U/Ctrl-K
+    // (delete to start/end), Ctrl-W (delete word), Ctrl-L (clear screen),
+    // Up/Down through history and bracketed paste. Lines longer than the
+    // terminal scroll sideways. When stdin is not a terminal, lines are
+    // read as they are, without echo or editing.
+    class LineEditor {
+        public:
+            explicit LineEditor(Output& out = Output::standard(), std::size_t history_limit = 1000)
+                : m_Out(out), m_Limit(history_limit) {}
+
+            // Show prompt and read a line into line; false at end of input
+            // (or Ctrl-D on an empty line)
+            bool read(std::string_view prompt, std::string& line){
+                if(!stdin_is_terminal()){
+                    return static_cast<bool>(std::getline(std::cin, line));
+                }
+                RawTerminalSession session;
+                KeyReader keys(session, true);
+                KeyEvent key;
+                m_Line.clear();
+                m_Cursor = 0;
+                std::size_t browsing = m_History.size();
+                std::string draft; // The line being typed, while browsing history
+                while(true){
+                    if(!keys.ready()){
+                        render(prompt);
+                    }
+                    if(!keys.next(key)){
+                        if(keys.eof()){
+                            m_Out << "\n";
+                            m_Out.flush();
+                            return false;
+                        }
+                        continue; // Interrupted, e.g. by a resize: redraw
+                    }
+                    switch(key.Type){
+                        case KeyEvent::Key::Char:
+                            insert(key.Text);
+                            break;
+                        case KeyEvent::Key::Paste:
+                            // Pasted line breaks become spaces; the line is entered with Enter
+                            for(char& c : key.Text){
+                                if(c == '\n' || c == '\r' || c == '\t'){
+                                    c = ' ';
+                                }
+                            }
+                            insert(key.Text);
+                            break;
+                        case KeyEvent::Key::Backspace:
+                            erase(previous(m_Cursor), m_Cursor);
+                            break;
+                        case KeyEvent::Key::Delete:
+                            erase(m_Cursor, next(m_Cursor));
+                            break;
+                        case KeyEvent::Key::Left:
+                            m_Cursor = previous(m_Cursor);
+                            break;
+                        case KeyEvent::Key::Right:
+                            m_Cursor = next(m_Cursor);
+                            break;
+                        case KeyEvent::Key::Home:
+                            m_Cursor = 0;
+                            break;
+                        case KeyEvent::Key::End:
+                            m_Cursor = m_Line.size();
+                            break;
+                        case KeyEvent::Key::Up:
+                            if(browsing > 0){
+                                if(browsing == m_History.size()){
+                                    draft = m_Line;
+                                }
+                                m_Line = m_History[--browsing];
+                                m_Cursor = m_Line.size();
+                            }
+                            break;
+                        case KeyEvent::Key::Down:
+                            if(browsing < m_History.size()){
+                                ++browsing;
+                                m_Line = browsing == m_History.size() ? draft : m_History[browsing];
+                                m_Cursor = m_Line.size();
+                            }
+                            break;
+                        case KeyEvent::Key::Enter:
+                            // Leave the whole line on screen, even if typed ahead of redraws
+                            m_Cursor = m_Line.size();
+                            render(prompt);
+                            m_Out << "\n";
+                            m_Out.flush();
+                            line = m_Line;
+                            return true;
+                        case KeyEvent::Key::Ctrl:
+                            if(!control(key.Codepoint)){
+                                m_Out << "\n";
+                                m_Out.flush();
+                                return false;
+                            }
+                            break;
+                        default:
+                            break;
+                    }
+                }
+            }
+
+            // Remember a line for Up/Down; blank lines and repeats are skipped
+            void add_history(std::string_view line){
+                if(line.find_first_not_of(" \t") == std::string_view::npos ||
+                   (!m_History.empty() && m_History.back() == line)){
+                    return;
+                }
+                if(m_History.size() >= m_Limit && !m_History.empty()){
+                    m_History.erase(m_History.begin());
+                }
+                m_History.emplace_back(line);
+            }
+
+            const std::vector<std::string>& history() const { return m_History; }
+
+        private:
+            Output& m_Out;
+            std::size_t m_Limit;
+            std::vector<std::string> m_History;
+            std::string m_Line;
+            std::size_t m_Cursor = 0; // Byte offset into m_Line
+
+            // Ctrl-key commands; false for end of input
+            bool control(char32_t key){
+                switch(key){
+                    case 'a': m_Cursor = 0; break;
+                    case 'e': m_Cursor = m_Line.size(); break;
+                    case 'b': m_Cursor = previous(m_Cursor); break;
+                    case 'f': m_Cursor = next(m_Cursor); break;
+                    case 'u': erase(0, m_Cursor); break;
+                    case 'k': erase(m_Cursor, m_Line.size()); break;
+                    case 'd':
+                        if(m_Line.empty()){
+                            return false;
+                        }
+                        erase(m_Cursor, next(m_Cursor));
+                        break;
+                    case 'w': {
+                        std::size_t from = m_Cursor;
+                        while(from > 0 && m_Line[from - 1] == ' '){
+                            --from;
+                        }
+                        while(from > 0 && m_Line[from - 1] != ' '){
+                            --from;
+                        }
+                        erase(from, m_Cursor);
+                        break;
+                    }
+                    case 'l':
+                        m_Out << "\033[H\033[J";
+                        break;
+                    default:
+                        break;
+                }
+                return true;
+            }
+
+            void insert(std::string_view text){
+                m_Line.insert(m_Cursor, text);
+                m_Cursor += text.size();
+            }
+
+            void erase(std::size_t from, std::size_t to){
+                m_Line.erase(from, to - from);
+                m_Cursor = from;
+            }
+
+            // Start of the character before/after a byte offset
+            std::size_t previous(std::size_t at) const {
+                while(at > 0 && (static_cast<unsigned char>(m_Line[--at]) & 0xc0) == 0x80){}
+                return at;
+            }
+            std::size_t next(std::size_t at) const {
+                if(at < m_Line.size()){
+                    ++at;
+                }
+                while(at < m_Line.size() && (static_cast<unsigned char>(m_Line[at]) & 0xc0) == 0x80){
+                    ++at;
+                }
+                return at;
+            }
+
+            // Redraw the prompt and the visible part of the line in one write
+            void render(std::string_view prompt){
+                std::size_t prompt_width = display_width(prompt);
+                std::size_t columns = terminal_size().Cols;
+                std::size_t room = columns > prompt_width + 1 ? columns - prompt_width - 1 : 1;
+                std::size_t cursor = display_width(std::string_view(m_Line).substr(0, m_Cursor));
+                // Scroll so the cursor stays on screen
+                std::size_t skip = cursor >= room ? cursor - room + 1 : 0;
+                std::size_t begin = 0;
+                for(std::size_t n = 0; n < skip; ++n){
+                    begin = next(begin);
+                }
+                std::size_t end = begin;
+                for(std::size_t n = 0; n < room && end < m_Line.size(); ++n){
+                    end = next(end);
+                }
+                Output::Frame frame(m_Out);
+                m_Out << "\r" << prompt << std::string_view(m_Line).substr(begin, end - begin) << "\033[K\r";
+                std::size_t column = prompt_width + cursor - skip;
+                if(column > 0){
+                    char number[24];
+                    auto result = std::to_chars(number, number + sizeof(number), column);
+                    m_Out << "\033[" << std::string_view(number, static_cast<std::size_t>(result.ptr - number)) << "C";
+                }
+            }
+    };
+} // namespace NCLI
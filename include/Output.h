@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace NCLI
+{
+    // Destination for rendered output
+    class Sink {
+        public:
+            virtual ~Sink() = default;
+            virtual void write(const char* data, std::size_t size) = 0;
+    };
+
+    // Writes straight to a file descriptor. For stdout/stderr, anything still
+    // buffered in std::cout/stdio is flushed first so ordering is preserved.
+    class FdSink : public Sink {
+        public:
+            explicit FdSink(int fd) : m_Fd(fd) {}
+
+            void write(const char* data, std::size_t size) override {
+                if(m_Fd == 1 || m_Fd == 2){
+                    std::cout.flush();
+                    std::fflush(m_Fd == 1 ? stdout : stderr);
+                }
+                while(size > 0){
+#ifdef _WIN32
+                    int written = ::_write(m_Fd, data, static_cast<unsigned int>(size));
+#else
+                    ssize_t written = ::write(m_Fd, data, size);
+#endif
+                    if(written < 0){
+                        if(errno == EINTR){
+                            continue;
+                        }
+                        return;
+                    }
+                    data += written;
+                    size -= static_cast<std::size_t>(written);
+                }
+            }
+
+        private:
+            int m_Fd;
+    };
+
+    class FileSink : public Sink {
+        public:
+            explicit FileSink(std::FILE* file) : m_File(file) {}
+
+            void write(const char* data, std::size_t size) override {
+                std::fwrite(data, 1, size, m_File);
+                std::fflush(m_File);
+            }
+
+        private:
+            std::FILE* m_File;
+    };
+
+    // Collects output in memory, e.g. to test or benchmark rendering without a TTY
+    class MemorySink : public Sink {
+        public:
+            std::string Data;
+            std::size_t Writes = 0;
+
+            void write(const char* data, std::size_t size) override {
+                Data.append(data, size);
+                ++Writes;
+            }
+    };
+
+    // Buffered output. Everything written between begin_frame() and the
+    // matching end_frame() reaches the sink in a single write; frames nest,
+    // and only the outermost one flushes.
+    class Output {
+        public:
+            explicit Output(Sink& sink, std::size_t capacity = 64 * 1024)
+                : m_Sink(sink) {
+                m_Buffer.reserve(capacity);
+            }
+            Output(const Output&) = delete;
+            Output& operator=(const Output&) = delete;
+            ~Output(){
+                flush();
+            }
+
+            // Buffer to render into, e.g. with a StyledWriter
+            std::string& buffer(){ return m_Buffer; }
+
+            Output& write(std::string_view text){
+                m_Buffer.append(text);
+                return *this;
+            }
+            Output& operator<<(std::string_view text){
+                return write(text);
+            }
+
+            void begin_frame(){
+                ++m_Depth;
+            }
+
+            void end_frame(){
+                if(m_Depth > 0 && --m_Depth == 0){
+                    flush();
+                }
+            }
+
+            void flush(){
+                if(!m_Buffer.empty()){
+                    m_Sink.write(m_Buffer.data(), m_Buffer.size());
+                    m_Buffer.clear();
+                }
+            }
+
+            // Scoped begin_frame()/end_frame()
+            class Frame {
+                public:
+                    explicit Frame(Output& out) : m_Out(out) { m_Out.begin_frame(); }
+                    ~Frame(){ m_Out.end_frame(); }
+                    Frame(const Frame&) = delete;
+                    Frame& operator=(const Frame&) = delete;
+                private:
+                    Output& m_Out;
+            };
+
+            // Output for stdout. Each thread buffers on its own and every
+            // frame is one write, so threads never share a buffer and their
+            // frames do not interleave.
+            static Output& standard(){
+                if(s_Redirect != nullptr){
+                    return *s_Redirect;
+                }
+#ifdef _WIN32
+                static FileSink sink(stdout);
+#else
+                static FdSink sink(STDOUT_FILENO);
+#endif
+                thread_local Output out(sink);
+                return out;
+            }
+
+            // Makes standard() on this thread return another Output while in
+            // scope, e.g. to collect what a command prints
+            class Redirect {
+                public:
+                    explicit Redirect(Output& out) : m_Previous(s_Redirect) { s_Redirect = &out; }
+                    ~Redirect(){ s_Redirect = m_Previous; }
+                    Redirect(const Redirect&) = delete;
+                    Redirect& operator=(const Redirect&) = delete;
+                private:
+                    Output* m_Previous;
+            };
+
+        private:
+            Sink& m_Sink;
+            std::string m_Buffer;
+            int m_Depth = 0;
+
+            inline static thread_local Output* s_Redirect = nullptr;
+    };
+} // namespace NCLI
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -20,18 +21,33 @@ namespace NCLI
     }
     inline static std::string prompt(const std::string &message)
     {
-        std::cout << NCLI::Color::cyan(NCLI::CFG::promptChar) << NCLI::Color::bold(message) << ": ";
+        std::string text = NCLI::Color::cyan(NCLI::CFG::promptChar) + NCLI::Color::bold(message) + ": ";
         std::string input;
-        std::getline(std::cin, input);
+        if (stdin_is_terminal())
+        {
+            LineEditor editor;
+            editor.read(text, input);
+        }
+        else
+        {
+            std::cout << text;
+            std::getline(std::cin, input);
+        }
         return input;
     }
 
-    // Platform independent function to capture a single key press
+    // Platform independent function to capture a single key press. Inside a
+    // RawTerminalSession the key comes from the session's buffer; otherwise
+    // the terminal is switched to raw mode just for this key.
     inline static char getch()
     {
+        if (RawTerminalSession* session = RawTerminalSession::current())
+        {
+            return static_cast<char>(session->read_byte());
+        }
         char ch;
 #ifdef _WIN32
-        ch = _getch()
+        ch = _getch();
 #else
         struct termios old = {0};
         if (tcgetattr(STDIN_FILENO, &old) < 0)
@@ -41,7 +57,10 @@ namespace NCLI
         old.c_cc[VMIN] = 1;
         old.c_cc[VTIME] = 0;
         tcsetattr(STDIN_FILENO, TCSANOW, &old);
-        ch = getchar();
+        int c = getchar();
+        if (c == EOF)
+            clearerr(stdin); // Interrupted, e.g. by SIGWINCH
+        ch = static_cast<char>(c);
         old.c_lflag |= ICANON; // Enable canonical mode
         old.c_lflag |= ECHO;   // Enable echo
         tcsetattr(STDIN_FILENO, TCSANOW, &old);
@@ -57,106 +76,372 @@ namespace NCLI
         std::cout << "\033[?25h";  // Show the cursor
     }
 
-    inline static std::string list(const std::string &message, const std::vector<std::string> &options)
+    // Scrolling window over a list of rows, shared by the selection widgets.
+    // Only the rows in view are produced and drawn, and the window follows
+    // the terminal size.
+    class ListView {
+        public:
+            Viewport View;
+
+            ListView(Output& out, const std::string& message, std::size_t count)
+                : m_Screen(out), m_Message(message) {
+                View.Count = count;
+                layout();
+            }
+
+            // Fit the window to the terminal; everything is redrawn
+            void layout(){
+                TerminalSize size = terminal_size();
+                m_Width = size.Cols;
+                m_Height = size.Rows > 2 ? size.Rows - 2 : 1;
+                View.Height = m_Height;
+                View.follow();
+                m_Screen.clear();
+                m_Screen.resize(View.Height + 1);
+            }
+
+            // Show a different number of rows (e.g. after filtering), from the top
+            void reset(std::size_t count){
+                View.Count = count;
+                View.Height = m_Height;
+                View.Top = 0;
+                View.Selected = 0;
+                View.follow();
+                m_Screen.resize(View.Height + 1);
+            }
+
+            // Header line above the rows
+            void set_message(std::string message){
+                m_Message = std::move(message);
+            }
+
+            // Draw the rows in view; row(i, width) returns the text of item i
+            template<typename Row>
+            void present(Row&& row){
+                m_Screen.set(0, m_Message);
+                for(std::size_t r = 0; r < View.Height; ++r){
+                    m_Screen.set(r + 1, row(View.Top + r, m_Width));
+                }
+                m_Screen.present();
+            }
+
+        private:
+            FrameRenderer m_Screen;
+            std::string m_Message;
+            std::size_t m_Width = 80;
+            std::size_t m_Height = 1;
+    };
+
+    // Move the selection for the navigation keys shared by the list widgets;
+    // false if the key is not one of them
+    inline static bool navigate(Viewport& view, const KeyEvent& key){
+        if(view.Count == 0){
+            return key.Type == KeyEvent::Key::Up || key.Type == KeyEvent::Key::Down ||
+                   key.Type == KeyEvent::Key::PageUp || key.Type == KeyEvent::Key::PageDown ||
+                   key.Type == KeyEvent::Key::Home || key.Type == KeyEvent::Key::End;
+        }
+        switch(key.Type){
+            case KeyEvent::Key::Up: view.up(); return true;
+            case KeyEvent::Key::Down: view.down(); return true;
+            case KeyEvent::Key::PageUp: view.page_up(); return true;
+            case KeyEvent::Key::PageDown: view.page_down(); return true;
+            case KeyEvent::Key::Home: view.home(); return true;
+            case KeyEvent::Key::End: view.end(); return true;
+            default: return false;
+        }
+    }
+
+    // Type-to-filter for the selection widgets. Printable keys and pastes
+    // extend the query, Backspace shortens it and Escape clears it; the rows
+    // shown are the fuzzy matches, best first. A search is dropped as soon
+    // as interrupted() reports more input, so typing ahead never waits on a
+    // stale query.
+    class ListFilter {
+        public:
+            ListFilter(const std::vector<std::string>& options, std::function<bool()> interrupted = nullptr)
+                : m_Matcher(options), m_Interrupted(std::move(interrupted)) {}
+
+            // Apply a key to the query; true if it changed. The matches are
+            // brought up to date by search().
+            bool edit(const KeyEvent& key){
+                switch(key.Type){
+                    case KeyEvent::Key::Char:
+                        if(key.Codepoint == ' '){
+                            return false;
+                        }
+                        m_Query += key.Text;
+                        break;
+                    case KeyEvent::Key::Paste:
+                        for(char c : key.Text){
+                            if(static_cast<unsigned char>(c) > ' '){
+                                m_Query.push_back(c);
+                            }
+                        }
+                        break;
+                    case KeyEvent::Key::Backspace:
+                        if(m_Query.empty()){
+                            return false;
+                        }
+                        // Drop a whole UTF-8 character
+                        while(!m_Query.empty() && (static_cast<unsigned char>(m_Query.back()) & 0xc0) == 0x80){
+                            m_Query.pop_back();
+                        }
+                        if(!m_Query.empty()){
+                            m_Query.pop_back();
+                        }
+                        break;
+                    case KeyEvent::Key::Escape:
+                        if(m_Query.empty()){
+                            return false;
+                        }
+                        m_Query.clear();
+                        break;
+                    default:
+                        return false;
+                }
+                m_Pending = true;
+                return true;
+            }
+
+            // True if the matches lag behind the query
+            bool pending() const { return m_Pending; }
+
+            // Match the query; false if cut short by new input. With
+            // interruptible false, always runs to completion.
+            bool search(bool interruptible = true){
+                static const std::function<bool()> none;
+                m_Pending = !m_Matcher.update(m_Query, interruptible ? m_Interrupted : none);
+                return !m_Pending;
+            }
+
+            const std::string& query() const { return m_Query; }
+            std::size_t size() const { return m_Matcher.size(); }
+
+            // Option index shown at row pos
+            std::size_t at(std::size_t pos){ return m_Matcher.at(pos); }
+
+            // Header with the query appended
+            std::string message(const std::string& message) const {
+                return m_Query.empty() ? message : message + " " + NCLI::Color::cyan(m_Query);
+            }
+
+        private:
+            FuzzyMatcher m_Matcher;
+            std::function<bool()> m_Interrupted;
+            std::string m_Query;
+            bool m_Pending = false;
+    };
+
+    // Cut text to fit in width columns (counted in bytes)
+    inline static std::string fit(std::string text, std::size_t width){
+        if(text.size() > width){
+            text.resize(width);
+        }
+        return text;
+    }
+
+    // Single choice over count items fetched on demand with item(i). Memory and
+    // work per keypress depend on the terminal height, not on count.
+    // Returns the chosen index, or count if there is nothing to choose.
+    inline static std::size_t virtual_list(const std::string &message, std::size_t count, const std::function<std::string(std::size_t)> &item, Output& out = Output::standard())
     {
-        int selected = 0;
-        char key = 0;
-        hide_cursor();
-        cls(); // Clear screen first to prevent ugly jumping
+        if (count == 0)
+        {
+            return count;
+        }
+        RawTerminalSession session;
+        ResizeWatcher resize;
+        KeyReader keys(session);
+        KeyEvent key;
+        ListView list(out, message, count);
+        auto row = [&](std::size_t i, std::size_t width){
+            std::string text = fit(item(i), width > 3 ? width - 3 : 0);
+            return i == list.View.Selected ? "\033[1;32m> " + text + " \033[0m" // Green for the selected option
+                                           : "  " + text;
+        };
+        out.write("\033[?25l"); // Hide the cursor
         while (true)
         {
-            std::cout << message << "\n";
-            // Display the options with the currently selected highlighted
-            for (int i = 0; i < options.size(); ++i)
+            if (!keys.ready())
             {
-                if (i == selected)
+                list.present(row);
+            }
+            bool got = keys.next(key);
+            if (resize.resized())
+            {
+                list.layout();
+            }
+            if (!got)
+            {
+                if (keys.eof())
                 {
-                    std::cout << "\033[1;32m> " << options[i] << " \033[0m\n"; // Green for the selected option
+                    break; // Input closed; keep the current choice
                 }
-                else
+                continue;
+            }
+            if (navigate(list.View, key))
+            {
+                continue;
+            }
+            if (key.Type == KeyEvent::Key::Enter)
+            {
+                break;
+            }
+        }
+        out.write("\033[?25h"); // Show the cursor
+        out.flush();
+        return list.View.Selected;
+    }
+
+    // Single choice; typing filters the options
+    inline static std::string list(const std::string &message, const std::vector<std::string> &options, Output& out = Output::standard())
+    {
+        if (options.empty())
+        {
+            return std::string();
+        }
+        RawTerminalSession session;
+        ResizeWatcher resize;
+        KeyReader keys(session, true);
+        KeyEvent key;
+        ListFilter filter(options, [&session]{ return session.wait(0); });
+        ListView list(out, message, options.size());
+        auto row = [&](std::size_t pos, std::size_t width){
+            std::string text = fit(options[filter.at(pos)], width > 3 ? width - 3 : 0);
+            return pos == list.View.Selected ? "\033[1;32m> " + text + " \033[0m" // Green for the selected option
+                                             : "  " + text;
+        };
+        out.write("\033[?25l"); // Hide the cursor
+        while (true)
+        {
+            if (filter.pending())
+            {
+                filter.search();
+                list.set_message(filter.message(message));
+                list.reset(filter.size());
+            }
+            if (!keys.ready())
+            {
+                list.present(row);
+            }
+            bool got = keys.next(key);
+            if (resize.resized())
+            {
+                list.layout();
+            }
+            if (!got)
+            {
+                if (keys.eof())
                 {
-                    std::cout << "  " << options[i] << "\n";
+                    break; // Input closed; keep the current choice
                 }
+                continue;
             }
-
-            key = getch();
-            if (key == 27)
-            {            // Escape sequence (arrow key)
-                getch(); // Skip '['
-                key = getch();
-                if (key == 'A')
+            if (navigate(list.View, key))
+            {
+                continue;
+            }
+            if (key.Type == KeyEvent::Key::Enter)
+            {
+                if (filter.pending())
                 {
-                    // Up arrow
-                    selected = (selected == 0) ? options.size() - 1 : selected - 1;
+                    filter.search(false); // Choose from what the final query matches
+                    list.reset(filter.size());
                 }
-                else if (key == 'B')
+                if (list.View.Count > 0)
                 {
-                    selected = (selected + 1) % options.size();
+                    break;
                 }
             }
-            else if (key == '\n')
-            {
-                show_cursor();
-                return options[selected];
-            }
-            cls();
+            filter.edit(key);
         }
+        out.write("\033[?25h"); // Show the cursor
+        out.flush();
+        return list.View.Count > 0 ? options[filter.at(list.View.Selected)] : std::string();
     }
 
-    inline static std::set<std::string> checkbox(const std::string &message, const std::vector<std::string> &options)
+    inline static std::set<std::string> checkbox(const std::string &message, const std::vector<std::string> &options, Output& out = Output::standard())
     {
-        hide_cursor();
         std::set<std::string> selected;
-        int selected_index = 0;
-        char key = 0;
-        cls(); // Clear screen first to prevent ugly jumping
+        if (options.empty())
+        {
+            return selected;
+        }
+        std::string line;
+        RawTerminalSession session;
+        ResizeWatcher resize;
+        KeyReader keys(session, true);
+        KeyEvent key;
+        ListFilter filter(options, [&session]{ return session.wait(0); });
+        ListView list(out, message, options.size());
+        auto row = [&](std::size_t pos, std::size_t width){
+            std::size_t i = filter.at(pos);
+            line.clear();
+            StyledWriter styled(line);
+            std::string text = fit(options[i], width > 5 ? width - 5 : 0);
+            // Highlight selected region, green for the selected option
+            styled.write(pos == list.View.Selected ? "\033[1;32m> \033[0m" : " ");
+            if(selected.count(options[i])){
+                styled.write(Style::green(), "[x] ").write(Style::green(), text).finish();
+            } else {
+                styled.write("[ ] ").write(text);
+            }
+            return line;
+        };
+        out.write("\033[?25l"); // Hide the cursor
         while (true)
         {
-            std::cout << message << "\n";
-            // Display the options with checkboxes
-            for (int i = 0; i < options.size(); ++i)
-            {
-                if(i == selected_index){
-                    // Highlight selected region
-                    std::cout << "\033[1;32m> \033[0m";  // Green for the selected option
-                } else {
-                    std::cout << " "; // no highlighting for other options;
-                }
-                std::cout << (selected.count(options[i]) ? Color::green("[x] " + options[i]) : "[ ] " + options[i]) << "\n";
+            if (filter.pending())
+            {
+                filter.search();
+                list.set_message(filter.message(message));
+                list.reset(filter.size());
             }
-
-            key = getch();
-            if (key == 27)
-            {            // Escape sequence (arrow key)
-                getch(); // Skip '['
-                key = getch();
-                if (key == 'A')
-                { // Up arrow
-                    selected_index = (selected_index == 0) ? options.size() - 1 : selected_index - 1;
-                }
-                else if (key == 'B')
-                { // Down arrow
-                    selected_index = (selected_index + 1) % options.size();
+            if (!keys.ready())
+            {
+                list.present(row);
+            }
+            bool got = keys.next(key);
+            if (resize.resized())
+            {
+                list.layout();
+            }
+            if (!got)
+            {
+                if (keys.eof())
+                {
+                    break;
                 }
+                continue;
+            }
+            if (navigate(list.View, key))
+            {
+                continue;
             }
-            else if (key == ' ')
+            if (key.Type == KeyEvent::Key::Char && key.Codepoint == ' ')
             { // Space to toggle checkbox
-                if (selected.count(options[selected_index]))
+                if (list.View.Count == 0)
+                {
+                    continue;
+                }
+                const std::string& option = options[filter.at(list.View.Selected)];
+                if (selected.count(option))
                 {
-                    selected.erase(options[selected_index]); // Deselect
+                    selected.erase(option); // Deselect
                 }
                 else
                 {
-                    selected.insert(options[selected_index]); // Select
+                    selected.insert(option); // Select
                 }
             }
-            else if (key == '\n')
+            else if (key.Type == KeyEvent::Key::Enter)
             { // Enter to finalize selection
                 break;
             }
-            std::cout << "\033[H\033[J"; // Clear the screen (optional)
+            filter.edit(key);
         }
-        show_cursor();
+        out.write("\033[?25h"); // Show the cursor
+        out.flush();
         return selected;
     }
 } // namespace NCLI
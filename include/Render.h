@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace NCLI
+{
+    // Draws a block of lines in place, starting at the cursor's line, and
+    // keeps what is on screen. present() only rewrites the lines that changed
+    // since the last call, moving the cursor with relative escapes, so the
+    // rest of the screen and the scrollback are left alone. Lines should fit
+    // the terminal width and the block its height.
+    class FrameRenderer {
+        public:
+            explicit FrameRenderer(Output& out) : m_Out(out) {}
+
+            std::size_t size() const { return m_Lines.size(); }
+
+            void resize(std::size_t count){
+                if(count < m_Lines.size()){
+                    m_Lines.resize(count);
+                    m_Dirty.resize(count);
+                    return;
+                }
+                while(m_Lines.size() < count){
+                    m_Lines.emplace_back();
+                    m_Dirty.push_back(0);
+                    mark(m_Lines.size() - 1);
+                }
+            }
+
+            // Replace a line; nothing is redrawn if the text is unchanged
+            void set(std::size_t row, std::string line){
+                if(m_Lines[row] == line){
+                    return;
+                }
+                m_Lines[row] = std::move(line);
+                mark(row);
+            }
+
+            const std::string& line(std::size_t row) const { return m_Lines[row]; }
+
+            // Write the pending changes as one frame
+            void present(){
+                NCLI_TRACE_SCOPE(Render, "present");
+                Output::Frame frame(m_Out);
+                std::size_t rows = m_Lines.size();
+                std::sort(m_DirtyRows.begin(), m_DirtyRows.end());
+                for(std::size_t row : m_DirtyRows){
+                    if(row >= rows || row >= m_OnScreen){
+                        break;
+                    }
+                    move_to(row);
+                    m_Out << "\r" << m_Lines[row] << "\033[K";
+                }
+                if(rows > m_OnScreen){
+                    // Grow the block below what is already drawn
+                    move_to(m_OnScreen);
+                    for(std::size_t row = m_OnScreen; row < rows; ++row){
+                        m_Out << "\r" << m_Lines[row] << "\033[K\n";
+                    }
+                    m_Cursor = rows;
+                } else if(rows < m_OnScreen){
+                    move_to(rows);
+                    m_Out << "\r\033[J";
+                }
+                move_to(rows);
+                m_Out << "\r";
+                m_OnScreen = rows;
+                for(std::size_t row : m_DirtyRows){
+                    if(row < m_Dirty.size()){
+                        m_Dirty[row] = 0;
+                    }
+                }
+                m_DirtyRows.clear();
+            }
+
+            // Erase the block and leave the cursor where it started
+            void clear(){
+                Output::Frame frame(m_Out);
+                move_to(0);
+                m_Out << "\r\033[J";
+                m_OnScreen = 0;
+                m_Lines.clear();
+                m_Dirty.clear();
+                m_DirtyRows.clear();
+            }
+
+        private:
+            Output& m_Out;
+            std::vector<std::string> m_Lines;
+            std::vector<std::uint8_t> m_Dirty;
+            std::vector<std::size_t> m_DirtyRows;
+            std::size_t m_OnScreen = 0; // Rows drawn by the last present()
+            std::size_t m_Cursor = 0;   // Row the cursor is on, relative to the block
+
+            void mark(std::size_t row){
+                if(!m_Dirty[row]){
+                    m_Dirty[row] = 1;
+                    m_DirtyRows.push_back(row);
+                }
+            }
+
+            void move_to(std::size_t row){
+                if(row == m_Cursor){
+                    return;
+                }
+                char number[24];
+                std::size_t distance = row < m_Cursor ? m_Cursor - row : row - m_Cursor;
+                auto result = std::to_chars(number, number + sizeof(number), distance);
+                m_Out << "\033[" << std::string_view(number, static_cast<std::size_t>(result.ptr - number)) << (row < m_Cursor ? "A" : "B");
+                m_Cursor = row;
+            }
+    };
+} // namespace NCLI
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+// Compile-time command schemas.
+//
+// A schema is declared as a constexpr value instead of being registered at
+// startup, and parse() walks argv against its fixed-size tables without
+// allocating. Names are looked up in open-addressing hash tables built at
+// compile time, so lookups stay O(1) however many commands there are. Name
+// lookups (Spec.command/flag/option) are constexpr, so a misspelt name used
+// to initialise a constexpr index fails to compile, and so does a schema
+// with two commands of the same name or a command with a repeated flag or
+// option name.
+//
+//   constexpr auto Spec = NCLI::Static::schema(
+//       NCLI::Static::command("greet", "Greet a user",
+//           NCLI::Static::option("name", "Specify the user's name"),
+//           NCLI::Static::flag("formal", "Use a formal greeting")));
+//   constexpr auto Greet  = Spec.command("greet");
+//   constexpr auto Formal = Spec.flag("greet", "formal");
+//
+//   auto args = NCLI::Static::parse(Spec, argc, argv);
+//   if(args.Command == Greet && args.Flags[Formal]) { ... }
+namespace NCLI::Static
+{
+    inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    struct FlagSpec {
+        std::string_view Name;
+        std::string_view Help;
+    };
+
+    struct OptionSpec {
+        std::string_view Name;
+        std::string_view Help;
+    };
+
+    template<std::size_t NF, std::size_t NO>
+    struct CommandSpec {
+        static constexpr std::size_t FlagCount = NF;
+        static constexpr std::size_t OptionCount = NO;
+        std::string_view Name;
+        std::string_view Help;
+        std::array<FlagSpec, NF> Flags{};
+        std::array<OptionSpec, NO> Options{};
+    };
+
+    constexpr FlagSpec flag(std::string_view name, std::string_view help = ""){
+        return {name, help};
+    }
+
+    constexpr OptionSpec option(std::string_view name, std::string_view help = ""){
+        return {name, help};
+    }
+
+    namespace detail
+    {
+        template<std::size_t NF, std::size_t NO>
+        constexpr void place(CommandSpec<NF, NO>& cmd, std::size_t& f, std::size_t&, const FlagSpec& spec){
+            cmd.Flags[f++] = spec;
+        }
+        template<std::size_t NF, std::size_t NO>
+        constexpr void place(CommandSpec<NF, NO>& cmd, std::size_t&, std::size_t& o, const OptionSpec& spec){
+            cmd.Options[o++] = spec;
+        }
+
+        template<typename T>
+        constexpr std::size_t count_of(){
+            return 0;
+        }
+        template<typename T, typename Item, typename... Rest>
+        constexpr std::size_t count_of(){
+            return (std::is_same<T, Item>::value ? 1 : 0) + count_of<T, Rest...>();
+        }
+
+        constexpr bool starts_with_dash(std::string_view s){
+            return !s.empty() && s[0] == '-';
+        }
+
+        // Slots for n names at most half full, a power of two
+        constexpr std::size_t slots_for(std::size_t n){
+            std::size_t size = 2;
+            while(size < 2 * n){
+                size *= 2;
+            }
+            return size;
+        }
+
+        // Flags and options are keyed by name and owning command, so the same
+        // name in several commands lands in different slots
+        constexpr std::uint32_t scoped_hash(std::size_t command, std::string_view name){
+            return hash_name(name) ^ (static_cast<std::uint32_t>(command) * 0x9E3779B9u);
+        }
+
+        // Linear probing over slots holding table positions + 1 (0 is empty).
+        // Returns the slot of the entry in [begin, end) named name, or the
+        // empty slot where it would go; a free slot always exists.
+        template<std::size_t S, typename Table>
+        constexpr std::size_t find_slot(const std::array<std::uint32_t, S>& slots, const Table& table, std::uint32_t hash,
+                                        std::string_view name, std::size_t begin, std::size_t end){
+            for(std::size_t i = hash & (S - 1);; i = (i + 1) & (S - 1)){
+                std::size_t at = slots[i];
+                if(at == 0){
+                    return i;
+                }
+                --at;
+                if(at >= begin && at < end && table[at].Hash == hash && table[at].Name == name){
+                    return i;
+                }
+            }
+        }
+    } // namespace detail
+
+    template<typename... Items>
+    constexpr auto command(std::string_view name, std::string_view help, const Items&... items){
+        CommandSpec<detail::count_of<FlagSpec, Items...>(), detail::count_of<OptionSpec, Items...>()> cmd{};
+        cmd.Name = name;
+        cmd.Help = help;
+        [[maybe_unused]] std::size_t f = 0, o = 0; // Unused by a command with no flags or options
+        (detail::place(cmd, f, o, items), ...);
+        return cmd;
+    }
+
+    struct CommandEntry {
+        std::string_view Name;
+        std::string_view Help;
+        std::uint32_t Hash = 0;
+        std::size_t FlagBegin = 0, FlagEnd = 0;
+        std::size_t OptionBegin = 0, OptionEnd = 0;
+    };
+
+    struct NameEntry {
+        std::string_view Name;
+        std::string_view Help;
+        std::uint32_t Hash = 0; // detail::scoped_hash of the name and its command
+    };
+
+    // Flattened schema: every command's flags and options live in one table
+    // each, and a command owns a contiguous [Begin, End) slice of them.
+    template<std::size_t NC, std::size_t NF, std::size_t NO>
+    struct Schema {
+        static constexpr std::size_t CommandCount = NC;
+        static constexpr std::size_t FlagCount = NF;
+        static constexpr std::size_t OptionCount = NO;
+
+        std::array<CommandEntry, NC> Commands{};
+        std::array<NameEntry, NF> Flags{};
+        std::array<NameEntry, NO> Options{};
+
+        // Hash indexes into the tables above, filled in by schema()
+        std::array<std::uint32_t, detail::slots_for(NC)> CommandSlots{};
+        std::array<std::uint32_t, detail::slots_for(NF)> FlagSlots{};
+        std::array<std::uint32_t, detail::slots_for(NO)> OptionSlots{};
+
+        constexpr std::size_t command(std::string_view name) const {
+            std::size_t at = find_command(name);
+            if(at == npos){
+                throw std::invalid_argument("NCLI::Static: unknown command");
+            }
+            return at;
+        }
+
+        constexpr std::size_t flag(std::string_view cmd, std::string_view name) const {
+            std::size_t at = find_flag(command(cmd), name);
+            if(at == npos){
+                throw std::invalid_argument("NCLI::Static: unknown flag");
+            }
+            return at;
+        }
+
+        constexpr std::size_t option(std::string_view cmd, std::string_view name) const {
+            std::size_t at = find_option(command(cmd), name);
+            if(at == npos){
+                throw std::invalid_argument("NCLI::Static: unknown option");
+            }
+            return at;
+        }
+
+        // Lookups used by parse(), npos when there is no such name
+        constexpr std::size_t find_command(std::string_view name) const {
+            std::size_t at = CommandSlots[detail::find_slot(CommandSlots, Commands, hash_name(name), name, 0, NC)];
+            return at != 0 ? at - 1 : npos;
+        }
+
+        constexpr std::size_t find_flag(std::size_t cmd, std::string_view name) const {
+            const CommandEntry& entry = Commands[cmd];
+            std::size_t at = FlagSlots[detail::find_slot(FlagSlots, Flags, detail::scoped_hash(cmd, name), name, entry.FlagBegin, entry.FlagEnd)];
+            return at != 0 ? at - 1 : npos;
+        }
+
+        constexpr std::size_t find_option(std::size_t cmd, std::string_view name) const {
+            const CommandEntry& entry = Commands[cmd];
+            std::size_t at = OptionSlots[detail::find_slot(OptionSlots, Options, detail::scoped_hash(cmd, name), name, entry.OptionBegin, entry.OptionEnd)];
+            return at != 0 ? at - 1 : npos;
+        }
+    };
+
+    namespace detail
+    {
+        // Index table[at] among the names in [begin, at). Throwing while a
+        // constexpr schema is built makes the duplicate a compile error.
+        template<std::size_t S, typename Table>
+        constexpr void index_name(std::array<std::uint32_t, S>& slots, const Table& table, std::size_t at, std::size_t begin, const char* duplicate){
+            std::size_t slot = find_slot(slots, table, table[at].Hash, table[at].Name, begin, at);
+            if(slots[slot] != 0){
+                throw std::invalid_argument(duplicate);
+            }
+            slots[slot] = static_cast<std::uint32_t>(at + 1);
+        }
+
+        template<std::size_t NC, std::size_t NF, std::size_t NO, std::size_t CF, std::size_t CO>
+        constexpr void append(Schema<NC, NF, NO>& s, std::size_t& c, std::size_t& f, std::size_t& o, const CommandSpec<CF, CO>& cmd){
+            std::size_t at = c++;
+            CommandEntry& entry = s.Commands[at];
+            entry.Name = cmd.Name;
+            entry.Help = cmd.Help;
+            entry.Hash = hash_name(cmd.Name);
+            index_name(s.CommandSlots, s.Commands, at, 0, "NCLI::Static: duplicate command name");
+            entry.FlagBegin = f;
+            for(std::size_t i = 0; i < CF; ++i, ++f){
+                s.Flags[f] = {cmd.Flags[i].Name, cmd.Flags[i].Help, scoped_hash(at, cmd.Flags[i].Name)};
+                index_name(s.FlagSlots, s.Flags, f, entry.FlagBegin, "NCLI::Static: duplicate flag name in a command");
+            }
+            entry.FlagEnd = f;
+            entry.OptionBegin = o;
+            for(std::size_t i = 0; i < CO; ++i, ++o){
+                s.Options[o] = {cmd.Options[i].Name, cmd.Options[i].Help, scoped_hash(at, cmd.Options[i].Name)};
+                index_name(s.OptionSlots, s.Options, o, entry.OptionBegin, "NCLI::Static: duplicate option name in a command");
+            }
+            entry.OptionEnd = o;
+        }
+    } // namespace detail
+
+    template<typename... Cmds>
+    constexpr auto schema(const Cmds&... cmds){
+        Schema<sizeof...(Cmds), (std::size_t{0} + ... + Cmds::FlagCount), (std::size_t{0} + ... + Cmds::OptionCount)> s{};
+        std::size_t c = 0, f = 0, o = 0;
+        (detail::append(s, c, f, o, cmds), ...);
+        return s;
+    }
+
+    // Non-owning view of the argv tokens given to one option
+    struct ArgRange {
+        char* const* Begin = nullptr;
+        char* const* End = nullptr;
+
+        struct iterator {
+            char* const* At;
+            std::string_view operator*() const { return *At; }
+            iterator& operator++(){ ++At; return *this; }
+            bool operator!=(const iterator& other) const { return At != other.At; }
+        };
+
+        iterator begin() const { return {Begin}; }
+        iterator end() const { return {End}; }
+        std::size_t size() const { return static_cast<std::size_t>(End - Begin); }
+        bool empty() const { return Begin == End; }
+        std::string_view operator[](std::size_t i) const { return Begin[i]; }
+    };
+
+    // Result of parse(): fixed-size, indexed by the positions the schema's
+    // constexpr lookups return. Option values point into argv.
+    template<typename SchemaT>
+    struct Result {
+        std::size_t Command = npos;
+        std::array<bool, SchemaT::FlagCount> Flags{};
+        std::array<ArgRange, SchemaT::OptionCount> Options{};
+
+        // Set when parsing failed; Error is a static message, ErrorIndex the argv position
+        const char* Error = nullptr;
+        int ErrorIndex = 0;
+
+        bool ok() const { return Error == nullptr; }
+        bool has(std::size_t option) const { return !Options[option].empty(); }
+        std::string_view value(std::size_t option, std::string_view fallback = "") const {
+            return has(option) ? Options[option][0] : fallback;
+        }
+    };
+
+    // Like CLI::parse, the first bare word selects the command, -name sets a
+    // flag and --name takes every following non-dash token. Unlike CLI::parse,
+    // one command per line: a second bare word is an "unexpected argument"
+    // error rather than a switch to another command.
+    template<std::size_t NC, std::size_t NF, std::size_t NO>
+    Result<Schema<NC, NF, NO>> parse(const Schema<NC, NF, NO>& s, int argc, char* const argv[]){
+        Result<Schema<NC, NF, NO>> result;
+        auto fail = [&result](const char* error, int index){
+            result.Error = error;
+            result.ErrorIndex = index;
+            return result;
+        };
+        for(int i = 1; i < argc; ++i){
+            std::string_view arg = argv[i];
+            if(!detail::starts_with_dash(arg)){
+                if(result.Command != npos){
+                    return fail("unexpected argument", i);
+                }
+                result.Command = s.find_command(arg);
+                if(result.Command == npos){
+                    return fail("unknown command", i);
+                }
+                continue;
+            }
+            if(result.Command == npos){
+                return fail("expected a command before options", i);
+            }
+            if(arg.size() > 1 && arg[1] == '-'){
+                std::size_t at = s.find_option(result.Command, arg.substr(2));
+                if(at == npos){
+                    return fail("unknown option", i);
+                }
+                int first = i + 1;
+                while(i + 1 < argc && argv[i + 1][0] != '-'){
+                    ++i;
+                }
+                if(first > i){
+                    return fail("missing value for option", first - 1);
+                }
+                result.Options[at] = {argv + first, argv + i + 1};
+            } else {
+                std::size_t at = s.find_flag(result.Command, arg.substr(1));
+                if(at == npos){
+                    return fail("unknown flag", i);
+                }
+                result.Flags[at] = true;
+            }
+        }
+        return result;
+    }
+} // namespace NCLI::Static
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace NCLI
+{
+    // A combination of SGR attributes and a foreground color. Styles compose
+    // (Style::cyan().bold()) into a single escape sequence instead of nesting.
+    struct Style {
+        enum Attribute : std::uint8_t {
+            Bold = 1 << 0,
+            Italic = 1 << 1,
+            Underline = 1 << 2,
+            Blink = 1 << 3,
+            Reverse = 1 << 4,
+            Hidden = 1 << 5,
+        };
+        std::uint8_t Attributes = 0;
+        bool HasColor = false;
+        std::uint8_t R = 0, G = 0, B = 0;
+
+        constexpr Style with(std::uint8_t attributes) const {
+            Style style = *this;
+            style.Attributes |= attributes;
+            return style;
+        }
+        constexpr Style fg(int r, int g, int b) const {
+            Style style = *this;
+            style.HasColor = true;
+            style.R = static_cast<std::uint8_t>(r);
+            style.G = static_cast<std::uint8_t>(g);
+            style.B = static_cast<std::uint8_t>(b);
+            return style;
+        }
+        constexpr Style bold() const { return with(Bold); }
+        constexpr Style italic() const { return with(Italic); }
+        constexpr Style underline() const { return with(Underline); }
+        constexpr Style blink() const { return with(Blink); }
+        constexpr Style reverse() const { return with(Reverse); }
+        constexpr Style hidden() const { return with(Hidden); }
+
+        // Same colors as the Color:: helpers
+        static constexpr Style plain() { return Style{}; }
+        static constexpr Style red() { return Style{}.fg(255, 0, 0); }
+        static constexpr Style green() { return Style{}.fg(0, 255, 0); }
+        static constexpr Style yellow() { return Style{}.fg(255, 255, 0); }
+        static constexpr Style cyan() { return Style{}.fg(0, 255, 255); }
+
+        constexpr bool empty() const { return Attributes == 0 && !HasColor; }
+        constexpr bool operator==(const Style& other) const {
+            return Attributes == other.Attributes && HasColor == other.HasColor &&
+                   (!HasColor || (R == other.R && G == other.G && B == other.B));
+        }
+        constexpr bool operator!=(const Style& other) const { return !(*this == other); }
+    };
+
+    // Appends styled text into one reusable buffer. The writer remembers the
+    // style currently in effect, so consecutive fragments with the same style
+    // share one escape sequence and a reset is only written when an attribute
+    // has to be turned off or the line ends.
+    class StyledWriter {
+        public:
+            explicit StyledWriter(Color::Stream stream = Color::Stream::Out)
+                : m_Out(&m_Own), m_Caps(Color::TerminalCaps::get(stream)) {}
+            explicit StyledWriter(std::string& buffer, Color::Stream stream = Color::Stream::Out)
+                : m_Out(&buffer), m_Caps(Color::TerminalCaps::get(stream)) {}
+            StyledWriter(const StyledWriter&) = delete;
+            StyledWriter& operator=(const StyledWriter&) = delete;
+
+            StyledWriter& write(const Style& style, std::string_view text){
+                transition(effective(style));
+                m_Out->append(text);
+                return *this;
+            }
+
+            StyledWriter& write(std::string_view text){
+                return write(Style{}, text);
+            }
+
+            StyledWriter& operator<<(std::string_view text){
+                return write(text);
+            }
+
+            StyledWriter& operator<<(char c){
+                transition(Style{});
+                m_Out->push_back(c);
+                return *this;
+            }
+
+            // Reset any active style, then end the line
+            StyledWriter& end_line(){
+                transition(Style{});
+                m_Out->push_back('\n');
+                return *this;
+            }
+
+            // Reset any active style without writing text
+            StyledWriter& finish(){
+                transition(Style{});
+                return *this;
+            }
+
+            const std::string& str() const { return *m_Out; }
+
+            void clear(){
+                m_Out->clear();
+                m_Active = Style{};
+            }
+
+        private:
+            std::string m_Own;
+            std::string* m_Out;
+            const Color::TerminalCaps& m_Caps;
+            Style m_Active;
+
+            // Drop what the terminal cannot show
+            Style effective(Style style) const {
+                if(!m_Caps.Colors){
+                    return Style{};
+                }
+                if(!m_Caps.Italic){
+                    style.Attributes &= ~Style::Italic;
+                }
+                return style;
+            }
+
+            void transition(const Style& next){
+                if(next == m_Active){
+                    return;
+                }
+                bool removes = (m_Active.Attributes & ~next.Attributes) != 0 || (m_Active.HasColor && !next.HasColor);
+                if(next.empty()){
+                    m_Out->append("\033[0m");
+                    m_Active = next;
+                    return;
+                }
+                // One sequence: optional reset, then every attribute still needed
+                std::uint8_t attributes = removes ? next.Attributes : static_cast<std::uint8_t>(next.Attributes & ~m_Active.Attributes);
+                bool recolor = !m_Active.HasColor || m_Active.R != next.R || m_Active.G != next.G || m_Active.B != next.B;
+                bool color = next.HasColor && (removes || recolor);
+                m_Out->append("\033[");
+                bool first = true;
+                auto param = [this, &first](std::string_view code){
+                    if(!first){
+                        m_Out->push_back(';');
+                    }
+                    m_Out->append(code);
+                    first = false;
+                };
+                if(removes){
+                    param("0");
+                }
+                static constexpr const char* Codes[] = {"1", "3", "4", "5", "7", "8"};
+                for(int bit = 0; bit < 6; ++bit){
+                    if(attributes & (1 << bit)){
+                        param(Codes[bit]);
+                    }
+                }
+                if(color){
+                    append_color(param, next);
+                }
+                m_Out->push_back('m');
+                m_Active = next;
+            }
+
+            template<typename Param>
+            void append_color(Param& param, const Style& style){
+                if(m_Caps.TrueColor){
+                    param("38;2");
+                    param(number(style.R));
+                    param(number(style.G));
+                    param(number(style.B));
+                } else if(m_Caps.Colors256){
+                    param("38;5");
+                    param(number(Color::rgb_to_256_color(style.R, style.G, style.B)));
+                } else {
+                    param("38;5");
+                    param(number(Color::rgb_to_ansi_color(style.R, style.G, style.B)));
+                }
+            }
+
+            std::string_view number(int value){
+                auto result = std::to_chars(m_Number, m_Number + sizeof(m_Number), value);
+                return std::string_view(m_Number, static_cast<std::size_t>(result.ptr - m_Number));
+            }
+            char m_Number[12] = {};
+    };
+} // namespace NCLI
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <conio.h>
+#include <io.h>
+#else
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace NCLI
+{
+    struct TerminalSize {
+        std::size_t Rows = 24;
+        std::size_t Cols = 80;
+    };
+
+    // Size of the terminal attached to stdout, or 24x80 if there is none
+    inline static TerminalSize terminal_size(){
+        TerminalSize size;
+#ifdef _WIN32
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if(GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)){
+            size.Rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+            size.Cols = info.srWindow.Right - info.srWindow.Left + 1;
+        }
+#else
+        struct winsize ws = {};
+        if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0){
+            size.Rows = ws.ws_row;
+            size.Cols = ws.ws_col;
+        }
+#endif
+        return size;
+    }
+
+    // True if stdin is an interactive terminal rather than a pipe or file
+    inline static bool stdin_is_terminal(){
+#ifdef _WIN32
+        return _isatty(0) != 0;
+#else
+        return isatty(STDIN_FILENO) != 0;
+#endif
+    }
+
+    // Notes SIGWINCH while in scope. The handler is installed without
+    // SA_RESTART, so a blocking read returns early and the widget can redraw.
+    class ResizeWatcher {
+        public:
+            ResizeWatcher(){
+#ifndef _WIN32
+                struct sigaction action = {};
+                action.sa_handler = &ResizeWatcher::on_resize;
+                sigemptyset(&action.sa_mask);
+                sigaction(SIGWINCH, &action, &m_Previous);
+#endif
+                s_Resized = 0;
+            }
+            ~ResizeWatcher(){
+#ifndef _WIN32
+                sigaction(SIGWINCH, &m_Previous, nullptr);
+#endif
+            }
+            ResizeWatcher(const ResizeWatcher&) = delete;
+            ResizeWatcher& operator=(const ResizeWatcher&) = delete;
+
+            // True once per resize
+            bool resized(){
+                if(s_Resized){
+                    s_Resized = 0;
+                    return true;
+                }
+                return false;
+            }
+
+        private:
+#ifndef _WIN32
+            struct sigaction m_Previous = {};
+#endif
+            inline static volatile std::sig_atomic_t s_Resized = 0;
+            static void on_resize(int){
+                s_Resized = 1;
+            }
+    };
+
+    // Window of Height rows over Count items that keeps Selected visible
+    struct Viewport {
+        std::size_t Count = 0;
+        std::size_t Height = 1;
+        std::size_t Top = 0;
+        std::size_t Selected = 0;
+
+        void up(){
+            Selected = Selected == 0 ? Count - 1 : Selected - 1;
+            follow();
+        }
+        void down(){
+            Selected = (Selected + 1) % Count;
+            follow();
+        }
+        void page_up(){
+            Selected = Selected > Height ? Selected - Height : 0;
+            follow();
+        }
+        void page_down(){
+            Selected = Selected + Height < Count ? Selected + Height : Count - 1;
+            follow();
+        }
+        void home(){
+            Selected = 0;
+            follow();
+        }
+        void end(){
+            Selected = Count - 1;
+            follow();
+        }
+
+        // Scroll so Selected is inside [Top, Top + Height)
+        void follow(){
+            if(Height > Count){
+                Height = Count;
+            }
+            if(Selected < Top){
+                Top = Selected;
+            } else if(Selected >= Top + Height){
+                Top = Selected - Height + 1;
+            }
+            if(Top + Height > Count){
+                Top = Count - Height;
+            }
+        }
+    };
+
+    // Keeps the terminal in raw mode (no line buffering, no echo) for the
+    // lifetime of the object, instead of toggling it around every key. The
+    // previous mode is restored on scope exit, during stack unwinding and
+    // from SIGINT/SIGTERM/SIGHUP/SIGQUIT. Input is read in batches into a
+    // buffer, so key repeat and pasted text are not lost or echoed.
+    // A session opened while another is active shares the outer one.
+    class RawTerminalSession {
+        public:
+            explicit RawTerminalSession(int fd = 0)
+                : m_Fd(fd), m_Outer(s_Current) {
+                s_Current = this;
+                if(m_Outer != nullptr){
+                    return;
+                }
+#ifndef _WIN32
+                if(!isatty(m_Fd) || tcgetattr(m_Fd, &s_Saved) < 0){
+                    return;
+                }
+                struct termios raw = s_Saved;
+                raw.c_lflag &= ~(ICANON | ECHO); // Disable canonical mode and echo
+                raw.c_cc[VMIN] = 1;
+                raw.c_cc[VTIME] = 0;
+                s_SavedFd = m_Fd;
+                s_Raw = 1;
+                struct sigaction action = {};
+                action.sa_handler = &RawTerminalSession::on_signal;
+                sigemptyset(&action.sa_mask);
+                for(int i = 0; i < SignalCount; ++i){
+                    sigaction(Signals[i], &action, &m_Previous[i]);
+                }
+                tcsetattr(m_Fd, TCSANOW, &raw);
+                m_Raw = true;
+#endif
+            }
+
+            ~RawTerminalSession(){
+                s_Current = m_Outer;
+#ifndef _WIN32
+                if(m_Raw){
+                    tcsetattr(m_Fd, TCSANOW, &s_Saved);
+                    s_Raw = 0;
+                    for(int i = 0; i < SignalCount; ++i){
+                        sigaction(Signals[i], &m_Previous[i], nullptr);
+                    }
+                }
+#endif
+            }
+
+            RawTerminalSession(const RawTerminalSession&) = delete;
+            RawTerminalSession& operator=(const RawTerminalSession&) = delete;
+
+            // Innermost open session, or nullptr
+            static RawTerminalSession* current(){ return s_Current; }
+
+            // Next input byte, or -1 on end of input or when interrupted by a signal
+            int read_byte(){
+                if(m_Outer != nullptr){
+                    return m_Outer->read_byte();
+                }
+                if(m_Begin == m_End && !fill()){
+                    return -1;
+                }
+                return static_cast<unsigned char>(m_Buffer[m_Begin++]);
+            }
+
+            // True once the input has ended (as opposed to a read cut short by a signal)
+            bool eof() const {
+                return m_Outer != nullptr ? m_Outer->eof() : m_Eof;
+            }
+
+            // Bytes already read from the terminal but not consumed yet
+            std::size_t buffered() const {
+                return m_Outer != nullptr ? m_Outer->buffered() : m_End - m_Begin;
+            }
+
+            // Wait up to timeout_ms for input; true if a byte can be read without blocking
+            bool wait(int timeout_ms){
+                if(m_Outer != nullptr){
+                    return m_Outer->wait(timeout_ms);
+                }
+                if(m_Begin != m_End){
+                    return true;
+                }
+#ifdef _WIN32
+                (void)timeout_ms;
+                return _kbhit() != 0;
+#else
+                struct pollfd pfd = {m_Fd, POLLIN, 0};
+                return ::poll(&pfd, 1, timeout_ms) > 0;
+#endif
+            }
+
+        private:
+            static constexpr std::size_t BufferSize = 4096;
+            int m_Fd;
+            RawTerminalSession* m_Outer;
+            bool m_Raw = false;
+            bool m_Eof = false;
+            char m_Buffer[BufferSize];
+            std::size_t m_Begin = 0;
+            std::size_t m_End = 0;
+
+            inline static RawTerminalSession* s_Current = nullptr;
+
+            bool fill(){
+                m_Begin = m_End = 0;
+#ifdef _WIN32
+                m_Buffer[m_End++] = static_cast<char>(_getch());
+                return true;
+#else
+                ssize_t count = ::read(m_Fd, m_Buffer, BufferSize);
+                if(count <= 0){
+                    // EOF, or EINTR (e.g. SIGWINCH) so the caller can react
+                    m_Eof = count == 0 || errno != EINTR;
+                    return false;
+                }
+                m_End = static_cast<std::size_t>(count);
+                return true;
+#endif
+            }
+
+#ifndef _WIN32
+            static constexpr int SignalCount = 4;
+            static constexpr int Signals[SignalCount] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT};
+            struct sigaction m_Previous[SignalCount] = {};
+
+            inline static struct termios s_Saved = {};
+            inline static int s_SavedFd = 0;
+            inline static volatile std::sig_atomic_t s_Raw = 0;
+
+            // Restore the terminal (cursor, paste mode), then let the signal take its default course
+            static void on_signal(int sig){
+                if(s_Raw){
+                    tcsetattr(s_SavedFd, TCSANOW, &s_Saved);
+                    static const char restore[] = "\033[?25h\033[?2004l";
+                    ssize_t ignored = ::write(1, restore, sizeof(restore) - 1);
+                    (void)ignored;
+                }
+                signal(sig, SIG_DFL);
+                raise(sig);
+            }
+#endif
+    };
+} // namespace NCLI
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NCLI
+{
+    // Fixed set of worker threads with a task queue each. Workers take their
+    // own newest tasks first and steal the oldest from the others when they
+    // run dry; tasks submitted from outside the pool go to a shared inbox.
+    // Threads waiting in parallel_for() run queued tasks meanwhile, so
+    // nested parallel_for() calls cannot starve the pool.
+    class ThreadPool {
+        public:
+            explicit ThreadPool(std::size_t threads = default_threads()){
+                // One queue per worker, then the inbox
+                for(std::size_t i = 0; i <= threads; ++i){
+                    m_Queues.push_back(std::make_unique<Queue>());
+                }
+                m_Workers.reserve(threads);
+                for(std::size_t i = 0; i < threads; ++i){
+                    m_Workers.emplace_back([this, i]{ work(i); });
+                }
+            }
+
+            ~ThreadPool(){
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    m_Stop = true;
+                }
+                m_Ready.notify_all();
+                for(std::thread& worker : m_Workers){
+                    worker.join();
+                }
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            std::size_t size() const { return m_Workers.size(); }
+
+            void submit(std::function<void()> task){
+                Queue& queue = *m_Queues[s_Pool == this ? s_Index : inbox()];
+                {
+                    std::lock_guard<std::mutex> lock(queue.Mutex);
+                    queue.Tasks.push_back(std::move(task));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    ++m_Pending;
+                }
+                m_Ready.notify_one();
+            }
+
+            // Run fn(i) for every i in [0, count) and wait. The calling thread
+            // takes part, so a pool without workers simply runs the loop.
+            template<typename Fn>
+            void parallel_for(std::size_t count, Fn&& fn){
+                std::atomic<std::size_t> next{0};
+                auto drain = [&next, &fn, count]{
+                    for(std::size_t i = next++; i < count; i = next++){
+                        fn(i);
+                    }
+                };
+                std::size_t helpers = count > 1 ? std::min(size(), count - 1) : 0;
+                std::atomic<std::size_t> running{helpers};
+                for(std::size_t h = 0; h < helpers; ++h){
+                    submit([&]{
+                        drain();
+                        if(--running == 0){
+                            std::lock_guard<std::mutex> lock(m_Mutex);
+                            m_Ready.notify_all();
+                        }
+                    });
+                }
+                drain();
+                // Help with whatever is queued until the helpers are done
+                std::size_t self = s_Pool == this ? s_Index : inbox();
+                while(running.load() != 0){
+                    if(run_one(self)){
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_Ready.wait(lock, [this, &running]{ return running.load() == 0 || m_Pending > 0; });
+                }
+            }
+
+            // Workers for the calling thread to share the machine with
+            static std::size_t default_threads(){
+                unsigned int cores = std::thread::hardware_concurrency();
+                return cores > 1 ? cores - 1 : 0;
+            }
+
+            // Process-wide pool, started on first use
+            static ThreadPool& shared(){
+                static ThreadPool pool;
+                return pool;
+            }
+
+        private:
+            struct Queue {
+                std::mutex Mutex;
+                std::deque<std::function<void()>> Tasks;
+            };
+
+            std::vector<std::thread> m_Workers;
+            std::vector<std::unique_ptr<Queue>> m_Queues;
+            std::mutex m_Mutex; // Guards sleeping and waking
+            std::condition_variable m_Ready;
+            std::size_t m_Pending = 0; // Tasks queued and not taken yet
+            bool m_Stop = false;
+
+            // Pool and queue of the worker running on this thread
+            inline static thread_local ThreadPool* s_Pool = nullptr;
+            inline static thread_local std::size_t s_Index = 0;
+
+            std::size_t inbox() const { return m_Queues.size() - 1; }
+
+            // Run one queued task, preferably from queue self; false if there was none
+            bool run_one(std::size_t self){
+                std::function<void()> task;
+                if(!take(*m_Queues[self], true, task)){
+                    std::size_t count = m_Queues.size();
+                    for(std::size_t k = 1; k < count && !task; ++k){
+                        take(*m_Queues[(self + k) % count], false, task);
+                    }
+                    if(!task){
+                        return false;
+                    }
+                }
+                task();
+                return true;
+            }
+
+            // Newest task of a queue for its owner, oldest for thieves
+            bool take(Queue& queue, bool own, std::function<void()>& task){
+                {
+                    std::lock_guard<std::mutex> lock(queue.Mutex);
+                    if(queue.Tasks.empty()){
+                        return false;
+                    }
+                    if(own){
+                        task = std::move(queue.Tasks.back());
+                        queue.Tasks.pop_back();
+                    } else {
+                        task = std::move(queue.Tasks.front());
+                        queue.Tasks.pop_front();
+                    }
+                }
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                --m_Pending;
+                return true;
+            }
+
+            void work(std::size_t index){
+                s_Pool = this;
+                s_Index = index;
+                while(true){
+                    if(run_one(index)){
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_Ready.wait(lock, [this]{ return m_Stop || m_Pending > 0; });
+                    if(m_Stop && m_Pending == 0){
+                        return;
+                    }
+                }
+            }
+    };
+} // namespace NCLI
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NCLI
+{
+    struct Token {
+        enum class Kind { Word, Flag, Option };
+        Kind Type = Kind::Word;
+        std::string_view Text; // Name without leading dashes, or the word itself
+        int Index = 0;         // Position in argv
+    };
+
+    // Splits argv into tokens without copying: every Text is a view into the
+    // original argv storage, so it stays valid for as long as argv does.
+    class Tokenizer {
+        public:
+            Tokenizer(int argc, char* const argv[], int start=1)
+                : m_Argc(argc), m_Argv(argv), m_Index(start) {}
+
+            bool next(Token& token){
+                if(m_Index >= m_Argc){
+                    return false;
+                }
+                std::string_view arg = m_Argv[m_Index];
+                token.Index = m_Index++;
+                if(arg.size() > 1 && arg[0] == '-' && arg[1] == '-'){
+                    token.Type = Token::Kind::Option;
+                    token.Text = arg.substr(2);
+                } else if(!arg.empty() && arg[0] == '-'){
+                    token.Type = Token::Kind::Flag;
+                    token.Text = arg.substr(1);
+                } else {
+                    token.Type = Token::Kind::Word;
+                    token.Text = arg;
+                }
+                return true;
+            }
+
+            // Consume the next argument if it is a value (does not start with
+            // '-'). With numeric set, a negative number such as -5 or -.5 is
+            // a value too, for options that take one.
+            bool next_value(std::string_view& value, bool numeric=false){
+                if(m_Index >= m_Argc){
+                    return false;
+                }
+                const char* arg = m_Argv[m_Index];
+                if(arg[0] == '-' && !(numeric && is_negative_number(arg))){
+                    return false;
+                }
+                value = arg;
+                ++m_Index;
+                return true;
+            }
+
+            int index() const { return m_Index; }
+
+        private:
+            int m_Argc;
+            char* const* m_Argv;
+            int m_Index;
+
+            // -<digit> or -.<digit>
+            static bool is_negative_number(const char* arg){
+                auto digit = [](char c){ return c >= '0' && c <= '9'; };
+                return arg[0] == '-' && (digit(arg[1]) || (arg[1] == '.' && digit(arg[2])));
+            }
+    };
+
+    // Split a command line into arguments with shell-style quoting: blanks
+    // separate words, '...' is literal, "..." honours \" \\ \$ and \`, and a
+    // backslash elsewhere escapes the next character. Words are written
+    // NUL-terminated into storage and argv points at them, after an empty
+    // program name and before a trailing nullptr, so argv.data() can go to
+    // Tokenizer or CLI::parse with argc = argv.size() - 1. Both buffers keep
+    // their capacity between calls. Returns false on an unterminated quote.
+    inline static bool split_line(std::string_view line, std::string& storage, std::vector<char*>& argv){
+        storage.clear();
+        argv.clear();
+        // Worst case is one NUL per input character, so pointers stay valid
+        storage.reserve(2 * line.size() + 1);
+        storage.push_back('\0');
+        argv.push_back(&storage[0]);
+        enum class Quote { None, Single, Double } quote = Quote::None;
+        bool in_word = false;
+        for(std::size_t i = 0; i < line.size(); ++i){
+            char c = line[i];
+            if(quote == Quote::Single){
+                if(c == '\''){
+                    quote = Quote::None;
+                } else {
+                    storage.push_back(c);
+                }
+                continue;
+            }
+            if(quote == Quote::Double){
+                if(c == '"'){
+                    quote = Quote::None;
+                } else if(c == '\\' && i + 1 < line.size() &&
+                          (line[i + 1] == '"' || line[i + 1] == '\\' || line[i + 1] == '$' || line[i + 1] == '`')){
+                    storage.push_back(line[++i]);
+                } else {
+                    storage.push_back(c);
+                }
+                continue;
+            }
+            if(c == ' ' || c == '\t' || c == '\n' || c == '\r'){
+                if(in_word){
+                    storage.push_back('\0');
+                    in_word = false;
+                }
+                continue;
+            }
+            if(!in_word){
+                argv.push_back(storage.data() + storage.size());
+                in_word = true;
+            }
+            if(c == '\''){
+                quote = Quote::Single;
+            } else if(c == '"'){
+                quote = Quote::Double;
+            } else if(c == '\\' && i + 1 < line.size()){
+                storage.push_back(line[++i]);
+            } else {
+                storage.push_back(c);
+            }
+        }
+        if(in_word){
+            storage.push_back('\0');
+        }
+        argv.push_back(nullptr);
+        return quote == Quote::None;
+    }
+} // namespace NCLI
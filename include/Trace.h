@@ -0,0 +1,305 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+// Instrumentation is compiled out unless NCLI_TRACE is defined before NCLI is
+// included (or the CMake option NCLI_TRACE is on). Define
+// NCLI_TRACE_ALLOCATIONS as well in exactly one translation unit to install
+// an operator new that counts heap allocations; a program with its own
+// operator new can call Trace::count_allocation() from it instead.
+#ifdef NCLI_TRACE
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <vector>
+#endif
+
+namespace NCLI
+{
+    // Where the time of an invocation goes
+    enum class TracePhase { Register, Parse, SetOption, Execute, Render };
+
+    inline constexpr std::size_t TracePhaseCount = 5;
+
+    inline static const char* trace_phase_name(TracePhase phase){
+        switch(phase){
+            case TracePhase::Register:  return "register";
+            case TracePhase::Parse:     return "parse";
+            case TracePhase::SetOption: return "set_option";
+            case TracePhase::Execute:   return "execute";
+            case TracePhase::Render:    return "render";
+        }
+        return "";
+    }
+
+    // Totals per phase since the start (or Trace::reset()). Nested phases
+    // count in both, e.g. help rendered by an action is in execute and render.
+    // Allocations are only counted when something calls count_allocation().
+    struct TraceStats {
+        struct Phase {
+            std::uint64_t Calls = 0;
+            std::uint64_t Nanos = 0;
+            std::uint64_t Allocations = 0;
+            std::uint64_t Bytes = 0;
+        };
+        std::array<Phase, TracePhaseCount> Phases{};
+        std::uint64_t Allocations = 0; // Whole process, any thread
+        std::uint64_t Bytes = 0;
+
+        const Phase& operator[](TracePhase phase) const { return Phases[static_cast<std::size_t>(phase)]; }
+
+        void print(std::ostream& out) const {
+            char line[96];
+            std::snprintf(line, sizeof(line), "%-12s %10s %14s %12s %14s\n", "Phase", "Calls", "Time (us)", "Allocs", "Bytes");
+            out << line;
+            for(std::size_t i = 0; i < TracePhaseCount; ++i){
+                const Phase& phase = Phases[i];
+                std::snprintf(line, sizeof(line), "%-12s %10llu %14.1f %12llu %14llu\n", trace_phase_name(static_cast<TracePhase>(i)),
+                              static_cast<unsigned long long>(phase.Calls), static_cast<double>(phase.Nanos) / 1e3,
+                              static_cast<unsigned long long>(phase.Allocations), static_cast<unsigned long long>(phase.Bytes));
+                out << line;
+            }
+            std::snprintf(line, sizeof(line), "%-12s %10s %14s %12llu %14llu\n", "total", "", "",
+                          static_cast<unsigned long long>(Allocations), static_cast<unsigned long long>(Bytes));
+            out << line;
+        }
+    };
+
+#ifdef NCLI_TRACE
+    // Process-wide counters fed by NCLI_TRACE_SCOPE, plus an optional
+    // recording of every scope as a Chrome trace (chrome://tracing, Perfetto)
+    class Trace {
+        public:
+            static constexpr bool Enabled = true;
+
+            // Times one phase from construction to destruction
+            class Scope {
+                public:
+                    Scope(TracePhase phase, const char* name)
+                        : m_Phase(phase), m_Name(name), m_Allocations(t_Allocations), m_Bytes(t_Bytes), m_Start(Clock::now()) {}
+
+                    ~Scope(){
+                        auto end = Clock::now();
+                        std::uint64_t nanos = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_Start).count());
+                        std::uint64_t allocations = t_Allocations - m_Allocations;
+                        std::uint64_t bytes = t_Bytes - m_Bytes;
+                        Counters& counters = s_Phases[static_cast<std::size_t>(m_Phase)];
+                        counters.Calls.fetch_add(1, std::memory_order_relaxed);
+                        counters.Nanos.fetch_add(nanos, std::memory_order_relaxed);
+                        counters.Allocations.fetch_add(allocations, std::memory_order_relaxed);
+                        counters.Bytes.fetch_add(bytes, std::memory_order_relaxed);
+                        if(s_Recording.load(std::memory_order_relaxed)){
+                            record({m_Name, m_Phase, m_Start, end, allocations, bytes, thread_id()});
+                        }
+                    }
+
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+
+                private:
+                    TracePhase m_Phase;
+                    const char* m_Name;
+                    std::uint64_t m_Allocations;
+                    std::uint64_t m_Bytes;
+                    std::chrono::steady_clock::time_point m_Start;
+            };
+
+            // Must not allocate: it runs inside operator new
+            static void count_allocation(std::size_t size){
+                ++t_Allocations;
+                t_Bytes += size;
+                s_Allocations.fetch_add(1, std::memory_order_relaxed);
+                s_Bytes.fetch_add(size, std::memory_order_relaxed);
+            }
+
+            static TraceStats stats(){
+                TraceStats stats;
+                for(std::size_t i = 0; i < TracePhaseCount; ++i){
+                    stats.Phases[i].Calls = s_Phases[i].Calls.load(std::memory_order_relaxed);
+                    stats.Phases[i].Nanos = s_Phases[i].Nanos.load(std::memory_order_relaxed);
+                    stats.Phases[i].Allocations = s_Phases[i].Allocations.load(std::memory_order_relaxed);
+                    stats.Phases[i].Bytes = s_Phases[i].Bytes.load(std::memory_order_relaxed);
+                }
+                stats.Allocations = s_Allocations.load(std::memory_order_relaxed);
+                stats.Bytes = s_Bytes.load(std::memory_order_relaxed);
+                return stats;
+            }
+
+            static void reset(){
+                for(Counters& counters : s_Phases){
+                    counters.Calls = 0;
+                    counters.Nanos = 0;
+                    counters.Allocations = 0;
+                    counters.Bytes = 0;
+                }
+                s_Allocations = 0;
+                s_Bytes = 0;
+            }
+
+            // Record scopes from now on and write them to path when the
+            // program exits (or at stop()); false if path cannot be written
+            static bool start(const std::string& path){
+                std::lock_guard<std::mutex> lock(s_Mutex);
+                s_File.close();
+                s_File.clear();
+                s_File.open(path, std::ios::out | std::ios::trunc);
+                if(!s_File){
+                    return false;
+                }
+                s_Events.clear();
+                s_Origin = Clock::now();
+                if(!s_AtExit){
+                    s_AtExit = true;
+                    std::atexit([]{ stop(); });
+                }
+                s_Recording = true;
+                return true;
+            }
+
+            // Write what was recorded as trace-event JSON and stop recording
+            static void stop(){
+                std::lock_guard<std::mutex> lock(s_Mutex);
+                if(!s_Recording.exchange(false)){
+                    return;
+                }
+                auto micros = [](Clock::duration d){ return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()) / 1e3; };
+                char line[256];
+                s_File << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+                for(std::size_t i = 0; i < s_Events.size(); ++i){
+                    const Event& event = s_Events[i];
+                    std::snprintf(line, sizeof(line),
+                                  "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                                  "\"args\":{\"allocations\":%llu,\"bytes\":%llu}}%s\n",
+                                  event.Name, trace_phase_name(event.Phase), event.Thread, micros(event.Start - s_Origin), micros(event.End - event.Start),
+                                  static_cast<unsigned long long>(event.Allocations), static_cast<unsigned long long>(event.Bytes),
+                                  i + 1 < s_Events.size() ? "," : "");
+                    s_File << line;
+                }
+                // Totals of the whole run, including registration before start()
+                s_File << "],\"otherData\":{";
+                TraceStats totals = stats();
+                for(std::size_t i = 0; i < TracePhaseCount; ++i){
+                    const TraceStats::Phase& phase = totals.Phases[i];
+                    std::snprintf(line, sizeof(line), "\"%s\":\"%llu calls, %.1f us, %llu allocations\",", trace_phase_name(static_cast<TracePhase>(i)),
+                                  static_cast<unsigned long long>(phase.Calls), static_cast<double>(phase.Nanos) / 1e3,
+                                  static_cast<unsigned long long>(phase.Allocations));
+                    s_File << line;
+                }
+                s_File << "\"allocations\":\"" << totals.Allocations << "\"}}\n";
+                s_File.close();
+                s_Events.clear();
+            }
+
+        private:
+            using Clock = std::chrono::steady_clock;
+
+            // Only used with static storage, which starts out zeroed
+            struct Counters {
+                std::atomic<std::uint64_t> Calls;
+                std::atomic<std::uint64_t> Nanos;
+                std::atomic<std::uint64_t> Allocations;
+                std::atomic<std::uint64_t> Bytes;
+            };
+
+            struct Event {
+                const char* Name;
+                TracePhase Phase;
+                Clock::time_point Start;
+                Clock::time_point End;
+                std::uint64_t Allocations;
+                std::uint64_t Bytes;
+                unsigned Thread;
+            };
+
+            inline static std::array<Counters, TracePhaseCount> s_Phases;
+            inline static std::atomic<std::uint64_t> s_Allocations{0};
+            inline static std::atomic<std::uint64_t> s_Bytes{0};
+            inline static thread_local std::uint64_t t_Allocations = 0;
+            inline static thread_local std::uint64_t t_Bytes = 0;
+
+            // Recording for start() and stop()
+            inline static std::atomic<bool> s_Recording{false};
+            inline static std::mutex s_Mutex;
+            inline static std::vector<Event> s_Events;
+            inline static std::ofstream s_File;
+            inline static Clock::time_point s_Origin;
+            inline static bool s_AtExit = false;
+
+            static void record(const Event& event){
+                std::lock_guard<std::mutex> lock(s_Mutex);
+                if(s_Recording.load(std::memory_order_relaxed)){
+                    s_Events.push_back(event);
+                }
+            }
+
+            // Small, stable thread numbers read better in a trace viewer than native ids
+            static unsigned thread_id(){
+                static std::atomic<unsigned> next{0};
+                thread_local unsigned id = next++;
+                return id;
+            }
+    };
+
+#define NCLI_TRACE_JOIN2(a, b) a##b
+#define NCLI_TRACE_JOIN(a, b) NCLI_TRACE_JOIN2(a, b)
+// Time the rest of the enclosing block as phase (a TracePhase name)
+#define NCLI_TRACE_SCOPE(phase, name) ::NCLI::Trace::Scope NCLI_TRACE_JOIN(ncli_trace_scope_, __LINE__)(::NCLI::TracePhase::phase, name)
+#else
+    // Stand-in when instrumentation is compiled out: no counters, no trace
+    class Trace {
+        public:
+            static constexpr bool Enabled = false;
+
+            static void count_allocation(std::size_t){}
+            static TraceStats stats(){ return {}; }
+            static void reset(){}
+            static bool start(const std::string&){ return false; }
+            static void stop(){}
+    };
+
+#define NCLI_TRACE_SCOPE(phase, name) ((void)0)
+#endif
+} // namespace NCLI
+
+#if defined(NCLI_TRACE) && defined(NCLI_TRACE_ALLOCATIONS)
+// Replaceable allocation functions that feed Trace::count_allocation()
+void* operator new(std::size_t size){
+    NCLI::Trace::count_allocation(size);
+    if(void* p = std::malloc(size != 0 ? size : 1)){
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size){
+    return ::operator new(size);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+// std::pmr::new_delete_resource() allocates through the aligned forms
+void* operator new(std::size_t size, std::align_val_t align){
+    NCLI::Trace::count_allocation(size);
+    std::size_t alignment = static_cast<std::size_t>(align);
+    if(void* p = std::aligned_alloc(alignment, (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment)){
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t align){
+    return ::operator new(size, align);
+}
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
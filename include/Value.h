@@ -0,0 +1,140 @@
+#pragma once
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace NCLI
+{
+    enum class ValueType { String, Int, UInt, Double, Bool, Enum, Duration, UIntList };
+
+    // Converted value of a typed option, stored inline in the Option. Only
+    // UIntList owns memory, and its capacity is kept between parses.
+    struct TypedValue {
+        TypedValue() = default;
+        explicit TypedValue(std::pmr::memory_resource* resource) : List(resource) {}
+
+        union {
+            std::int64_t Int = 0; // Int, Enum
+            std::uint64_t UInt;
+            double Double;
+            bool Bool;
+            std::int64_t Nanos;   // Duration
+        };
+        std::pmr::vector<std::uint64_t> List;
+    };
+
+    // Outcome of converting one option value. On failure Column is the
+    // offset of the first offending character and Expected names the type.
+    struct ConvertResult {
+        bool Ok = true;
+        std::size_t Column = 0;
+        const char* Expected = nullptr;
+    };
+
+    inline static ConvertResult convert_failed(std::string_view text, const char* end, const char* expected){
+        return {false, static_cast<std::size_t>(end - text.data()), expected};
+    }
+
+    inline static ConvertResult convert_int(std::string_view text, std::int64_t min, std::int64_t max, std::int64_t& out){
+        const char* end = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(text.data(), end, out);
+        if(ec == std::errc::invalid_argument || ptr != end){
+            return convert_failed(text, ptr, "an integer");
+        }
+        if(ec != std::errc() || out < min || out > max){
+            return convert_failed(text, text.data(), "an integer in range");
+        }
+        return {};
+    }
+
+    inline static ConvertResult convert_uint(std::string_view text, std::uint64_t max, std::uint64_t& out){
+        const char* end = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(text.data(), end, out);
+        if(ec == std::errc::invalid_argument || ptr != end){
+            return convert_failed(text, ptr, "a non-negative integer");
+        }
+        if(ec != std::errc() || out > max){
+            return convert_failed(text, text.data(), "a non-negative integer in range");
+        }
+        return {};
+    }
+
+    inline static ConvertResult convert_double(std::string_view text, double& out){
+        const char* end = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(text.data(), end, out);
+        if(ec != std::errc() || ptr != end){
+            return convert_failed(text, ptr, "a number");
+        }
+        return {};
+    }
+
+    inline static ConvertResult convert_bool(std::string_view text, bool& out){
+        if(text == "true" || text == "yes" || text == "on" || text == "1"){
+            out = true;
+        } else if(text == "false" || text == "no" || text == "off" || text == "0"){
+            out = false;
+        } else {
+            return convert_failed(text, text.data(), "true or false");
+        }
+        return {};
+    }
+
+    // Accepts a number followed by a unit: ns, us, ms, s, m or h (e.g. 250ms, 1.5s)
+    inline static ConvertResult convert_duration(std::string_view text, std::int64_t& nanos){
+        const char* end = text.data() + text.size();
+        double count = 0;
+        auto [ptr, ec] = std::from_chars(text.data(), end, count);
+        if(ec != std::errc() || ptr == end){
+            return convert_failed(text, ptr, "a duration such as 250ms or 2s");
+        }
+        std::string_view unit(ptr, static_cast<std::size_t>(end - ptr));
+        double scale = 0;
+        if(unit == "ns") scale = 1;
+        else if(unit == "us") scale = 1e3;
+        else if(unit == "ms") scale = 1e6;
+        else if(unit == "s") scale = 1e9;
+        else if(unit == "m") scale = 60e9;
+        else if(unit == "h") scale = 3600e9;
+        else return convert_failed(text, ptr, "a duration unit (ns, us, ms, s, m, h)");
+        // Must fit in int64 nanoseconds (about 292 years); NaN and infinity fail too
+        constexpr double limit = 9223372036854775808.0; // 2^63
+        double scaled = count * scale;
+        if(!(scaled >= -limit && scaled < limit)){
+            return convert_failed(text, text.data(), "a duration in range");
+        }
+        nanos = static_cast<std::int64_t>(scaled);
+        return {};
+    }
+
+    template<typename T>
+    struct is_duration : std::false_type {};
+    template<typename Rep, typename Period>
+    struct is_duration<std::chrono::duration<Rep, Period>> : std::true_type {};
+
+    template<typename T>
+    struct is_uint_list : std::false_type {};
+    template<typename T>
+    struct is_uint_list<std::vector<T>> : std::bool_constant<std::is_integral_v<T> && std::is_unsigned_v<T>> {};
+
+    // Maps an option<T> type to the storage it is converted into
+    template<typename T>
+    constexpr ValueType value_type_of(){
+        if constexpr (std::is_same_v<T, bool>) return ValueType::Bool;
+        else if constexpr (std::is_enum_v<T>) return ValueType::Enum;
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) return ValueType::Int;
+        else if constexpr (std::is_integral_v<T>) return ValueType::UInt;
+        else if constexpr (std::is_floating_point_v<T>) return ValueType::Double;
+        else if constexpr (is_duration<T>::value) return ValueType::Duration;
+        else if constexpr (is_uint_list<T>::value) return ValueType::UIntList;
+        else {
+            static_assert(std::is_convertible_v<T, std::string_view>, "NCLI: unsupported option type");
+            return ValueType::String;
+        }
+    }
+} // namespace NCLI
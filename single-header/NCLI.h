@@ -3,71 +3,394 @@
  * @author NoahGWood
  * @brief Single-header include for the NCLI library
  * @version 0.1
- * @date 2025-4-7
+ * @date 2026-10-17
  * 
- * @copyright Copyright (c) 2025
+ * @copyright Copyright (c) 2026
  * 
  */
 
 #ifndef NCLI_H
 #define NCLI_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <functional>
+#include <initializer_list>
 #include <iostream>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <ostream>
 #include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unistd.h>
 #include <unordered_map>
 #include <vector>
+// --- Trace.h --- //
+// Instrumentation is compiled out unless NCLI_TRACE is defined before NCLI is
+// included (or the CMake option NCLI_TRACE is on). Define
+// NCLI_TRACE_ALLOCATIONS as well in exactly one translation unit to install
+// an operator new that counts heap allocations; a program with its own
+// operator new can call Trace::count_allocation() from it instead.
+#ifdef NCLI_TRACE
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <vector>
+#endif
+namespace NCLI
+{
+    // Where the time of an invocation goes
+    enum class TracePhase { Register, Parse, SetOption, Execute, Render };
+    inline constexpr std::size_t TracePhaseCount = 5;
+    inline static const char* trace_phase_name(TracePhase phase){
+        switch(phase){
+            case TracePhase::Register:  return "register";
+            case TracePhase::Parse:     return "parse";
+            case TracePhase::SetOption: return "set_option";
+            case TracePhase::Execute:   return "execute";
+            case TracePhase::Render:    return "render";
+        }
+        return "";
+    }
+    // Totals per phase since the start (or Trace::reset()). Nested phases
+    // count in both, e.g. help rendered by an action is in execute and render.
+    // Allocations are only counted when something calls count_allocation().
+    struct TraceStats {
+        struct Phase {
+            std::uint64_t Calls = 0;
+            std::uint64_t Nanos = 0;
+            std::uint64_t Allocations = 0;
+            std::uint64_t Bytes = 0;
+        };
+        std::array<Phase, TracePhaseCount> Phases{};
+        std::uint64_t Allocations = 0; // Whole process, any thread
+        std::uint64_t Bytes = 0;
+        const Phase& operator[](TracePhase phase) const { return Phases[static_cast<std::size_t>(phase)]; }
+        void print(std::ostream& out) const {
+            char line[96];
+            std::snprintf(line, sizeof(line), "%-12s %10s %14s %12s %14s\n", "Phase", "Calls", "Time (us)", "Allocs", "Bytes");
+            out << line;
+            for(std::size_t i = 0; i < TracePhaseCount; ++i){
+                const Phase& phase = Phases[i];
+                std::snprintf(line, sizeof(line), "%-12s %10llu %14.1f %12llu %14llu\n", trace_phase_name(static_cast<TracePhase>(i)),
+                              static_cast<unsigned long long>(phase.Calls), static_cast<double>(phase.Nanos) / 1e3,
+                              static_cast<unsigned long long>(phase.Allocations), static_cast<unsigned long long>(phase.Bytes));
+                out << line;
+            }
+            std::snprintf(line, sizeof(line), "%-12s %10s %14s %12llu %14llu\n", "total", "", "",
+                          static_cast<unsigned long long>(Allocations), static_cast<unsigned long long>(Bytes));
+            out << line;
+        }
+    };
+#ifdef NCLI_TRACE
+    // Process-wide counters fed by NCLI_TRACE_SCOPE, plus an optional
+    // recording of every scope as a Chrome trace (chrome://tracing, Perfetto)
+    class Trace {
+        public:
+            static constexpr bool Enabled = true;
+            // Times one phase from construction to destruction
+            class Scope {
+                public:
+                    Scope(TracePhase phase, const char* name)
+                        : m_Phase(phase), m_Name(name), m_Allocations(t_Allocations), m_Bytes(t_Bytes), m_Start(Clock::now()) {}
+                    ~Scope(){
+                        auto end = Clock::now();
+                        std::uint64_t nanos = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_Start).count());
+                        std::uint64_t allocations = t_Allocations - m_Allocations;
+                        std::uint64_t bytes = t_Bytes - m_Bytes;
+                        Counters& counters = s_Phases[static_cast<std::size_t>(m_Phase)];
+                        counters.Calls.fetch_add(1, std::memory_order_relaxed);
+                        counters.Nanos.fetch_add(nanos, std::memory_order_relaxed);
+                        counters.Allocations.fetch_add(allocations, std::memory_order_relaxed);
+                        counters.Bytes.fetch_add(bytes, std::memory_order_relaxed);
+                        if(s_Recording.load(std::memory_order_relaxed)){
+                            record({m_Name, m_Phase, m_Start, end, allocations, bytes, thread_id()});
+                        }
+                    }
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+                private:
+                    TracePhase m_Phase;
+                    const char* m_Name;
+                    std::uint64_t m_Allocations;
+                    std::uint64_t m_Bytes;
+                    std::chrono::steady_clock::time_point m_Start;
+            };
+            // Must not allocate: it runs inside operator new
+            static void count_allocation(std::size_t size){
+                ++t_Allocations;
+                t_Bytes += size;
+                s_Allocations.fetch_add(1, std::memory_order_relaxed);
+                s_Bytes.fetch_add(size, std::memory_order_relaxed);
+            }
+            static TraceStats stats(){
+                TraceStats stats;
+                for(std::size_t i = 0; i < TracePhaseCount; ++i){
+                    stats.Phases[i].Calls = s_Phases[i].Calls.load(std::memory_order_relaxed);
+                    stats.Phases[i].Nanos = s_Phases[i].Nanos.load(std::memory_order_relaxed);
+                    stats.Phases[i].Allocations = s_Phases[i].Allocations.load(std::memory_order_relaxed);
+                    stats.Phases[i].Bytes = s_Phases[i].Bytes.load(std::memory_order_relaxed);
+                }
+                stats.Allocations = s_Allocations.load(std::memory_order_relaxed);
+                stats.Bytes = s_Bytes.load(std::memory_order_relaxed);
+                return stats;
+            }
+            static void reset(){
+                for(Counters& counters : s_Phases){
+                    counters.Calls = 0;
+                    counters.Nanos = 0;
+                    counters.Allocations = 0;
+                    counters.Bytes = 0;
+                }
+                s_Allocations = 0;
+                s_Bytes = 0;
+            }
+            // Record scopes from now on and write them to path when the
+            // program exits (or at stop()); false if path cannot be written
+            static bool start(const std::string& path){
+                std::lock_guard<std::mutex> lock(s_Mutex);
+                s_File.close();
+                s_File.clear();
+                s_File.open(path, std::ios::out | std::ios::trunc);
+                if(!s_File){
+                    return false;
+                }
+                s_Events.clear();
+                s_Origin = Clock::now();
+                if(!s_AtExit){
+                    s_AtExit = true;
+                    std::atexit([]{ stop(); });
+                }
+                s_Recording = true;
+                return true;
+            }
+            // Write what was recorded as trace-event JSON and stop recording
+            static void stop(){
+                std::lock_guard<std::mutex> lock(s_Mutex);
+                if(!s_Recording.exchange(false)){
+                    return;
+                }
+                auto micros = [](Clock::duration d){ return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()) / 1e3; };
+                char line[256];
+                s_File << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+                for(std::size_t i = 0; i < s_Events.size(); ++i){
+                    const Event& event = s_Events[i];
+                    std::snprintf(line, sizeof(line),
+                                  "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                                  "\"args\":{\"allocations\":%llu,\"bytes\":%llu}}%s\n",
+                                  event.Name, trace_phase_name(event.Phase), event.Thread, micros(event.Start - s_Origin), micros(event.End - event.Start),
+                                  static_cast<unsigned long long>(event.Allocations), static_cast<unsigned long long>(event.Bytes),
+                                  i + 1 < s_Events.size() ? "," : "");
+                    s_File << line;
+                }
+                // Totals of the whole run, including registration before start()
+                s_File << "],\"otherData\":{";
+                TraceStats totals = stats();
+                for(std::size_t i = 0; i < TracePhaseCount; ++i){
+                    const TraceStats::Phase& phase = totals.Phases[i];
+                    std::snprintf(line, sizeof(line), "\"%s\":\"%llu calls, %.1f us, %llu allocations\",", trace_phase_name(static_cast<TracePhase>(i)),
+                                  static_cast<unsigned long long>(phase.Calls), static_cast<double>(phase.Nanos) / 1e3,
+                                  static_cast<unsigned long long>(phase.Allocations));
+                    s_File << line;
+                }
+                s_File << "\"allocations\":\"" << totals.Allocations << "\"}}\n";
+                s_File.close();
+                s_Events.clear();
+            }
+        private:
+            using Clock = std::chrono::steady_clock;
+            // Only used with static storage, which starts out zeroed
+            struct Counters {
+                std::atomic<std::uint64_t> Calls;
+                std::atomic<std::uint64_t> Nanos;
+                std::atomic<std::uint64_t> Allocations;
+                std::atomic<std::uint64_t> Bytes;
+            };
+            struct Event {
+                const char* Name;
+                TracePhase Phase;
+                Clock::time_point Start;
+                Clock::time_point End;
+                std::uint64_t Allocations;
+                std::uint64_t Bytes;
+                unsigned Thread;
+            };
+            inline static std::array<Counters, TracePhaseCount> s_Phases;
+            inline static std::atomic<std::uint64_t> s_Allocations{0};
+            inline static std::atomic<std::uint64_t> s_Bytes{0};
+            inline static thread_local std::uint64_t t_Allocations = 0;
+            inline static thread_local std::uint64_t t_Bytes = 0;
+            // Recording for start() and stop()
+            inline static std::atomic<bool> s_Recording{false};
+            inline static std::mutex s_Mutex;
+            inline static std::vector<Event> s_Events;
+            inline static std::ofstream s_File;
+            inline static Clock::time_point s_Origin;
+            inline static bool s_AtExit = false;
+            static void record(const Event& event){
+                std::lock_guard<std::mutex> lock(s_Mutex);
+                if(s_Recording.load(std::memory_order_relaxed)){
+                    s_Events.push_back(event);
+                }
+            }
+            // Small, stable thread numbers read better in a trace viewer than native ids
+            static unsigned thread_id(){
+                static std::atomic<unsigned> next{0};
+                thread_local unsigned id = next++;
+                return id;
+            }
+    };
+#define NCLI_TRACE_JOIN2(a, b) a##b
+#define NCLI_TRACE_JOIN(a, b) NCLI_TRACE_JOIN2(a, b)
+// Time the rest of the enclosing block as phase (a TracePhase name)
+#define NCLI_TRACE_SCOPE(phase, name) ::NCLI::Trace::Scope NCLI_TRACE_JOIN(ncli_trace_scope_, __LINE__)(::NCLI::TracePhase::phase, name)
+#else
+    // Stand-in when instrumentation is compiled out: no counters, no trace
+    class Trace {
+        public:
+            static constexpr bool Enabled = false;
+            static void count_allocation(std::size_t){}
+            static TraceStats stats(){ return {}; }
+            static void reset(){}
+            static bool start(const std::string&){ return false; }
+            static void stop(){}
+    };
+#define NCLI_TRACE_SCOPE(phase, name) ((void)0)
+#endif
+} // namespace NCLI
+#if defined(NCLI_TRACE) && defined(NCLI_TRACE_ALLOCATIONS)
+// Replaceable allocation functions that feed Trace::count_allocation()
+void* operator new(std::size_t size){
+    NCLI::Trace::count_allocation(size);
+    if(void* p = std::malloc(size != 0 ? size : 1)){
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size){
+    return ::operator new(size);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+// std::pmr::new_delete_resource() allocates through the aligned forms
+void* operator new(std::size_t size, std::align_val_t align){
+    NCLI::Trace::count_allocation(size);
+    std::size_t alignment = static_cast<std::size_t>(align);
+    if(void* p = std::aligned_alloc(alignment, (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment)){
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t align){
+    return ::operator new(size, align);
+}
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
+// --- Trace.h --- //
+
 // --- Colors.h --- //
 namespace NCLI::Color
 {
-    inline static bool terminal_supports_colors() {
-        const char* term_type = std::getenv("TERM");
-        // Check if we're on a Unix-like system with a terminal and color support
-        if (term_type && (std::getenv("TERM") != nullptr)) {
-            // Check if the terminal supports color (e.g., "xterm", "xterm-256color", etc.)
-            return std::string(term_type) != "dumb" && isatty(fileno(stdout));
-        }
+    enum class Stream { Out, Err };
+    // Terminal capabilities, detected once per stream and cached. Detection
+    // reads TERM/COLORTERM and calls isatty(), so it is kept off the hot path
+    // of the color helpers; call refresh() if the environment changes.
+    struct TerminalCaps {
+        bool Colors = false;
+        bool Colors256 = false;
+        bool TrueColor = false;
+        bool Italic = false;
+        static TerminalCaps detect(Stream stream){
+            TerminalCaps caps;
+            const char* term_type = std::getenv("TERM");
+            const char* color_term = std::getenv("COLORTERM");
+            bool tty = isatty(fileno(stream == Stream::Err ? stderr : stdout));
+            // Check if we're on a Unix-like system with a terminal and color support
+            if (term_type) {
+                // Check if the terminal supports color (e.g., "xterm", "xterm-256color", etc.)
+                caps.Colors = std::string_view(term_type) != "dumb" && tty;
+                caps.Colors256 = caps.Colors;
+            } else {
 #ifdef _WIN32
-        // For Windows, check if virtual terminal processing is enabled
-        DWORD dwMode = 0;
-        if (GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &dwMode)) {
-            return (dwMode & ENABLE_VIRTUAL_TERMINAL_PROCESSING);
-        }
-        return false;
+                // For Windows, check if virtual terminal processing is enabled
+                DWORD dwMode = 0;
+                caps.Colors = GetConsoleMode(GetStdHandle(stream == Stream::Err ? STD_ERROR_HANDLE : STD_OUTPUT_HANDLE), &dwMode)
+                    && (dwMode & ENABLE_VIRTUAL_TERMINAL_PROCESSING);
 #else
-        return true;  // Assume color support for other systems
+                caps.Colors = true;  // Assume color support for other systems
 #endif
+            }
+            // Check for true color support
+            caps.TrueColor = color_term != nullptr && std::string_view(color_term) == "truecolor";
+            // Check if the terminal supports italic (not all terminals do)
+            // This is a simple check, some terminals use different values for italic support
+            caps.Italic = term_type && (std::string_view(term_type).find("xterm") != std::string_view::npos ||
+                                        std::string_view(term_type).find("screen") != std::string_view::npos);
+            return caps;
+        }
+        static const TerminalCaps& get(Stream stream = Stream::Out){
+            return cache()[stream == Stream::Err ? 1 : 0];
+        }
+        // Re-detect the capabilities of both streams
+        static void refresh(){
+            cache()[0] = detect(Stream::Out);
+            cache()[1] = detect(Stream::Err);
+        }
+    private:
+        static TerminalCaps* cache(){
+            static TerminalCaps caps[2] = { detect(Stream::Out), detect(Stream::Err) };
+            return caps;
+        }
+    };
+    inline static bool terminal_supports_colors(Stream stream = Stream::Out) {
+        return TerminalCaps::get(stream).Colors;
     }
     // Determine if we support 256 colors
-    inline static bool terminal_supports_256_colors(){
-        const char* term_type = std::getenv("TERM");
-        // Check for 256 color support
-        if (term_type && (std::getenv("TERM") != nullptr)) {
-            return std::string(term_type) != "dumb" && isatty(fileno(stdout));
-        }
-        return false;
+    inline static bool terminal_supports_256_colors(Stream stream = Stream::Out){
+        return TerminalCaps::get(stream).Colors256;
     }
     // Detect if the terminal supports true colors (24-bit)
-    inline static bool terminal_supports_true_color() {
-        const char* term_type = std::getenv("TERM");
-        // Check for true color support
-        return std::getenv("COLORTERM") != nullptr && std::string(std::getenv("COLORTERM")) == "truecolor";
+    inline static bool terminal_supports_true_color(Stream stream = Stream::Out) {
+        return TerminalCaps::get(stream).TrueColor;
     }
     // Determine if terminal supports styling
-    inline static bool terminal_supports_styles(){
-        return terminal_supports_colors(); 
+    inline static bool terminal_supports_styles(Stream stream = Stream::Out){
+        return terminal_supports_colors(stream);
     }
-    inline static bool terminal_supports_italic() {
-        const char* term_type = std::getenv("TERM");
-        // Check if the terminal supports italic (not all terminals do)
-        // This is a simple check, some terminals use different values for italic support
-        return term_type && (std::string(term_type).find("xterm") != std::string::npos || 
-                             std::string(term_type).find("screen") != std::string::npos);
+    inline static bool terminal_supports_italic(Stream stream = Stream::Out) {
+        return TerminalCaps::get(stream).Italic;
     }
     inline static int rgb_to_256_color(int r, int g, int b){
         // First handle basic grayscale
@@ -97,27 +420,29 @@ namespace NCLI::Color
     }
     inline static void set_terminal_background_color(int r, int g, int b)
     {
-        if(terminal_supports_true_color()){
+        const TerminalCaps& caps = TerminalCaps::get();
+        if(caps.TrueColor){
             std::cout << "\033[48;2;" << r << ";" << g << ";" << b << "m";  // True-color background
-        } else if(terminal_supports_256_colors()){
+        } else if(caps.Colors256){
             // Convert RGB to 256 color index            
             int color_code = rgb_to_256_color(r,g,b);
             std::cout << "\033[48;5;" << color_code << "m";  // 256-color background    
-        } else if(terminal_supports_colors()){
+        } else if(caps.Colors){
             std::cout << "\033[48;5;0m";  // Default to black background if no advanced support
         }
     }
     // Color application based on the terminal's capabilities
-    inline static std::string apply_color(int r, int g, int b, const std::string& text){
+    inline static std::string apply_color(int r, int g, int b, const std::string& text, Stream stream = Stream::Out){
+        const TerminalCaps& caps = TerminalCaps::get(stream);
         std::stringstream buffer;
-        if (terminal_supports_true_color()) {
+        if (caps.TrueColor) {
             buffer << "\033[38;2;" << r << ';' << g << ';' << b << "m" << text << "\033[0m";  // Applying true color (example orange)
         }
-        else if (terminal_supports_256_colors()) {
+        else if (caps.Colors256) {
             int color_code = rgb_to_256_color(r,g,b);
             buffer << "\033[38;5;" << color_code << "m" << text << "\033[0m";    
         }
-        else if (terminal_supports_colors()) {
+        else if (caps.Colors) {
             int color_code = rgb_to_ansi_color(r,g,b);
             buffer << "\033[38;5;" << color_code << "m" << text << "\033[0m";
         } else {
@@ -126,8 +451,8 @@ namespace NCLI::Color
         return buffer.str();
     }
     // Apply styles dynamically
-    inline static std::string apply_style(const std::string& style_code, const std::string& text) {
-        if (terminal_supports_styles()) {
+    inline static std::string apply_style(const std::string& style_code, const std::string& text, Stream stream = Stream::Out) {
+        if (terminal_supports_styles(stream)) {
             return style_code + text + "\033[0m";  // Apply style if terminal supports it
         }
         return text;  // Return plain text if no styles are supported
@@ -162,421 +487,3828 @@ namespace NCLI::Color
 } // namespace NCLI::Color
 // --- Colors.h --- //
 
-// --- Config.h --- //
+// --- Style.h --- //
 namespace NCLI
 {
-    namespace CFG
-    {
-        inline static std::string promptChar = "> ";
-    } // namespace CFG
+    // A combination of SGR attributes and a foreground color. Styles compose
+    // (Style::cyan().bold()) into a single escape sequence instead of nesting.
+    struct Style {
+        enum Attribute : std::uint8_t {
+            Bold = 1 << 0,
+            Italic = 1 << 1,
+            Underline = 1 << 2,
+            Blink = 1 << 3,
+            Reverse = 1 << 4,
+            Hidden = 1 << 5,
+        };
+        std::uint8_t Attributes = 0;
+        bool HasColor = false;
+        std::uint8_t R = 0, G = 0, B = 0;
+        constexpr Style with(std::uint8_t attributes) const {
+            Style style = *this;
+            style.Attributes |= attributes;
+            return style;
+        }
+        constexpr Style fg(int r, int g, int b) const {
+            Style style = *this;
+            style.HasColor = true;
+            style.R = static_cast<std::uint8_t>(r);
+            style.G = static_cast<std::uint8_t>(g);
+            style.B = static_cast<std::uint8_t>(b);
+            return style;
+        }
+        constexpr Style bold() const { return with(Bold); }
+        constexpr Style italic() const { return with(Italic); }
+        constexpr Style underline() const { return with(Underline); }
+        constexpr Style blink() const { return with(Blink); }
+        constexpr Style reverse() const { return with(Reverse); }
+        constexpr Style hidden() const { return with(Hidden); }
+        // Same colors as the Color:: helpers
+        static constexpr Style plain() { return Style{}; }
+        static constexpr Style red() { return Style{}.fg(255, 0, 0); }
+        static constexpr Style green() { return Style{}.fg(0, 255, 0); }
+        static constexpr Style yellow() { return Style{}.fg(255, 255, 0); }
+        static constexpr Style cyan() { return Style{}.fg(0, 255, 255); }
+        constexpr bool empty() const { return Attributes == 0 && !HasColor; }
+        constexpr bool operator==(const Style& other) const {
+            return Attributes == other.Attributes && HasColor == other.HasColor &&
+                   (!HasColor || (R == other.R && G == other.G && B == other.B));
+        }
+        constexpr bool operator!=(const Style& other) const { return !(*this == other); }
+    };
+    // Appends styled text into one reusable buffer. The writer remembers the
+    // style currently in effect, so consecutive fragments with the same style
+    // share one escape sequence and a reset is only written when an attribute
+    // has to be turned off or the line ends.
+    class StyledWriter {
+        public:
+            explicit StyledWriter(Color::Stream stream = Color::Stream::Out)
+                : m_Out(&m_Own), m_Caps(Color::TerminalCaps::get(stream)) {}
+            explicit StyledWriter(std::string& buffer, Color::Stream stream = Color::Stream::Out)
+                : m_Out(&buffer), m_Caps(Color::TerminalCaps::get(stream)) {}
+            StyledWriter(const StyledWriter&) = delete;
+            StyledWriter& operator=(const StyledWriter&) = delete;
+            StyledWriter& write(const Style& style, std::string_view text){
+                transition(effective(style));
+                m_Out->append(text);
+                return *this;
+            }
+            StyledWriter& write(std::string_view text){
+                return write(Style{}, text);
+            }
+            StyledWriter& operator<<(std::string_view text){
+                return write(text);
+            }
+            StyledWriter& operator<<(char c){
+                transition(Style{});
+                m_Out->push_back(c);
+                return *this;
+            }
+            // Reset any active style, then end the line
+            StyledWriter& end_line(){
+                transition(Style{});
+                m_Out->push_back('\n');
+                return *this;
+            }
+            // Reset any active style without writing text
+            StyledWriter& finish(){
+                transition(Style{});
+                return *this;
+            }
+            const std::string& str() const { return *m_Out; }
+            void clear(){
+                m_Out->clear();
+                m_Active = Style{};
+            }
+        private:
+            std::string m_Own;
+            std::string* m_Out;
+            const Color::TerminalCaps& m_Caps;
+            Style m_Active;
+            // Drop what the terminal cannot show
+            Style effective(Style style) const {
+                if(!m_Caps.Colors){
+                    return Style{};
+                }
+                if(!m_Caps.Italic){
+                    style.Attributes &= ~Style::Italic;
+                }
+                return style;
+            }
+            void transition(const Style& next){
+                if(next == m_Active){
+                    return;
+                }
+                bool removes = (m_Active.Attributes & ~next.Attributes) != 0 || (m_Active.HasColor && !next.HasColor);
+                if(next.empty()){
+                    m_Out->append("\033[0m");
+                    m_Active = next;
+                    return;
+                }
+                // One sequence: optional reset, then every attribute still needed
+                std::uint8_t attributes = removes ? next.Attributes : static_cast<std::uint8_t>(next.Attributes & ~m_Active.Attributes);
+                bool recolor = !m_Active.HasColor || m_Active.R != next.R || m_Active.G != next.G || m_Active.B != next.B;
+                bool color = next.HasColor && (removes || recolor);
+                m_Out->append("\033[");
+                bool first = true;
+                auto param = [this, &first](std::string_view code){
+                    if(!first){
+                        m_Out->push_back(';');
+                    }
+                    m_Out->append(code);
+                    first = false;
+                };
+                if(removes){
+                    param("0");
+                }
+                static constexpr const char* Codes[] = {"1", "3", "4", "5", "7", "8"};
+                for(int bit = 0; bit < 6; ++bit){
+                    if(attributes & (1 << bit)){
+                        param(Codes[bit]);
+                    }
+                }
+                if(color){
+                    append_color(param, next);
+                }
+                m_Out->push_back('m');
+                m_Active = next;
+            }
+            template<typename Param>
+            void append_color(Param& param, const Style& style){
+                if(m_Caps.TrueColor){
+                    param("38;2");
+                    param(number(style.R));
+                    param(number(style.G));
+                    param(number(style.B));
+                } else if(m_Caps.Colors256){
+                    param("38;5");
+                    param(number(Color::rgb_to_256_color(style.R, style.G, style.B)));
+                } else {
+                    param("38;5");
+                    param(number(Color::rgb_to_ansi_color(style.R, style.G, style.B)));
+                }
+            }
+            std::string_view number(int value){
+                auto result = std::to_chars(m_Number, m_Number + sizeof(m_Number), value);
+                return std::string_view(m_Number, static_cast<std::size_t>(result.ptr - m_Number));
+            }
+            char m_Number[12] = {};
+    };
 } // namespace NCLI
-// --- Config.h --- //
+// --- Style.h --- //
 
-// --- Prompt.h --- //
+// --- Output.h --- //
 #ifdef _WIN32
-#include <conio.h>
+#include <io.h>
 #else
-#include <termios.h>
 #include <unistd.h>
 #endif
 namespace NCLI
 {
-    inline static void cls()
-    {
-        std::cout << "\033[H\033[J"; // Clear the screen
-    }
-    inline static std::string prompt(const std::string &message)
-    {
-        std::cout << NCLI::Color::cyan(NCLI::CFG::promptChar) << NCLI::Color::bold(message) << ": ";
-        std::string input;
-        std::getline(std::cin, input);
-        return input;
-    }
-    // Platform independent function to capture a single key press
-    inline static char getch()
-    {
-        char ch;
+    // Destination for rendered output
+    class Sink {
+        public:
+            virtual ~Sink() = default;
+            virtual void write(const char* data, std::size_t size) = 0;
+    };
+    // Writes straight to a file descriptor. For stdout/stderr, anything still
+    // buffered in std::cout/stdio is flushed first so ordering is preserved.
+    class FdSink : public Sink {
+        public:
+            explicit FdSink(int fd) : m_Fd(fd) {}
+            void write(const char* data, std::size_t size) override {
+                if(m_Fd == 1 || m_Fd == 2){
+                    std::cout.flush();
+                    std::fflush(m_Fd == 1 ? stdout : stderr);
+                }
+                while(size > 0){
 #ifdef _WIN32
-        ch = _getch()
+                    int written = ::_write(m_Fd, data, static_cast<unsigned int>(size));
 #else
-        struct termios old = {0};
-        if (tcgetattr(STDIN_FILENO, &old) < 0)
-            perror("tcsetattr()");
-        old.c_lflag &= ~ICANON; // Disable canonical mode
-        old.c_lflag &= ~ECHO;   // Disable echo
-        old.c_cc[VMIN] = 1;
-        old.c_cc[VTIME] = 0;
-        tcsetattr(STDIN_FILENO, TCSANOW, &old);
-        ch = getchar();
-        old.c_lflag |= ICANON; // Enable canonical mode
-        old.c_lflag |= ECHO;   // Enable echo
-        tcsetattr(STDIN_FILENO, TCSANOW, &old);
+                    ssize_t written = ::write(m_Fd, data, size);
 #endif
-            return ch;
-    }
-    inline static void hide_cursor(){
-        std::cout << "\033[?25l";  // Hide the cursor
-    }
-    inline static void show_cursor(){
-        std::cout << "\033[?25h";  // Show the cursor
-    }
-    inline static std::string list(const std::string &message, const std::vector<std::string> &options)
-    {
-        int selected = 0;
-        char key = 0;
-        hide_cursor();
-        cls(); // Clear screen first to prevent ugly jumping
-        while (true)
-        {
-            std::cout << message << "\n";
-            // Display the options with the currently selected highlighted
-            for (int i = 0; i < options.size(); ++i)
-            {
-                if (i == selected)
-                {
-                    std::cout << "\033[1;32m> " << options[i] << " \033[0m\n"; // Green for the selected option
-                }
-                else
-                {
-                    std::cout << "  " << options[i] << "\n";
+                    if(written < 0){
+                        if(errno == EINTR){
+                            continue;
+                        }
+                        return;
+                    }
+                    data += written;
+                    size -= static_cast<std::size_t>(written);
                 }
             }
-            key = getch();
-            if (key == 27)
-            {            // Escape sequence (arrow key)
-                getch(); // Skip '['
-                key = getch();
-                if (key == 'A')
-                {
-                    // Up arrow
-                    selected = (selected == 0) ? options.size() - 1 : selected - 1;
-                }
-                else if (key == 'B')
-                {
-                    selected = (selected + 1) % options.size();
-                }
+        private:
+            int m_Fd;
+    };
+    class FileSink : public Sink {
+        public:
+            explicit FileSink(std::FILE* file) : m_File(file) {}
+            void write(const char* data, std::size_t size) override {
+                std::fwrite(data, 1, size, m_File);
+                std::fflush(m_File);
             }
-            else if (key == '\n')
-            {
-                show_cursor();
-                return options[selected];
+        private:
+            std::FILE* m_File;
+    };
+    // Collects output in memory, e.g. to test or benchmark rendering without a TTY
+    class MemorySink : public Sink {
+        public:
+            std::string Data;
+            std::size_t Writes = 0;
+            void write(const char* data, std::size_t size) override {
+                Data.append(data, size);
+                ++Writes;
             }
-            cls();
-        }
-    }
-    inline static std::set<std::string> checkbox(const std::string &message, const std::vector<std::string> &options)
-    {
-        hide_cursor();
-        std::set<std::string> selected;
-        int selected_index = 0;
-        char key = 0;
-        cls(); // Clear screen first to prevent ugly jumping
-        while (true)
-        {
-            std::cout << message << "\n";
-            // Display the options with checkboxes
-            for (int i = 0; i < options.size(); ++i)
-            {
-                if(i == selected_index){
-                    // Highlight selected region
-                    std::cout << "\033[1;32m> \033[0m";  // Green for the selected option
-                } else {
-                    std::cout << " "; // no highlighting for other options;
-                }
-                std::cout << (selected.count(options[i]) ? Color::green("[x] " + options[i]) : "[ ] " + options[i]) << "\n";
+    };
+    // Buffered output. Everything written between begin_frame() and the
+    // matching end_frame() reaches the sink in a single write; frames nest,
+    // and only the outermost one flushes.
+    class Output {
+        public:
+            explicit Output(Sink& sink, std::size_t capacity = 64 * 1024)
+                : m_Sink(sink) {
+                m_Buffer.reserve(capacity);
             }
-            key = getch();
-            if (key == 27)
-            {            // Escape sequence (arrow key)
-                getch(); // Skip '['
-                key = getch();
-                if (key == 'A')
-                { // Up arrow
-                    selected_index = (selected_index == 0) ? options.size() - 1 : selected_index - 1;
-                }
-                else if (key == 'B')
-                { // Down arrow
-                    selected_index = (selected_index + 1) % options.size();
-                }
+            Output(const Output&) = delete;
+            Output& operator=(const Output&) = delete;
+            ~Output(){
+                flush();
             }
-            else if (key == ' ')
-            { // Space to toggle checkbox
-                if (selected.count(options[selected_index]))
-                {
-                    selected.erase(options[selected_index]); // Deselect
+            // Buffer to render into, e.g. with a StyledWriter
+            std::string& buffer(){ return m_Buffer; }
+            Output& write(std::string_view text){
+                m_Buffer.append(text);
+                return *this;
+            }
+            Output& operator<<(std::string_view text){
+                return write(text);
+            }
+            void begin_frame(){
+                ++m_Depth;
+            }
+            void end_frame(){
+                if(m_Depth > 0 && --m_Depth == 0){
+                    flush();
                 }
-                else
-                {
-                    selected.insert(options[selected_index]); // Select
+            }
+            void flush(){
+                if(!m_Buffer.empty()){
+                    m_Sink.write(m_Buffer.data(), m_Buffer.size());
+                    m_Buffer.clear();
                 }
             }
-            else if (key == '\n')
-            { // Enter to finalize selection
-                break;
+            // Scoped begin_frame()/end_frame()
+            class Frame {
+                public:
+                    explicit Frame(Output& out) : m_Out(out) { m_Out.begin_frame(); }
+                    ~Frame(){ m_Out.end_frame(); }
+                    Frame(const Frame&) = delete;
+                    Frame& operator=(const Frame&) = delete;
+                private:
+                    Output& m_Out;
+            };
+            // Output for stdout. Each thread buffers on its own and every
+            // frame is one write, so threads never share a buffer and their
+            // frames do not interleave.
+            static Output& standard(){
+                if(s_Redirect != nullptr){
+                    return *s_Redirect;
+                }
+#ifdef _WIN32
+                static FileSink sink(stdout);
+#else
+                static FdSink sink(STDOUT_FILENO);
+#endif
+                thread_local Output out(sink);
+                return out;
             }
-            std::cout << "\033[H\033[J"; // Clear the screen (optional)
-        }
-        show_cursor();
-        return selected;
-    }
+            // Makes standard() on this thread return another Output while in
+            // scope, e.g. to collect what a command prints
+            class Redirect {
+                public:
+                    explicit Redirect(Output& out) : m_Previous(s_Redirect) { s_Redirect = &out; }
+                    ~Redirect(){ s_Redirect = m_Previous; }
+                    Redirect(const Redirect&) = delete;
+                    Redirect& operator=(const Redirect&) = delete;
+                private:
+                    Output* m_Previous;
+            };
+        private:
+            Sink& m_Sink;
+            std::string m_Buffer;
+            int m_Depth = 0;
+            inline static thread_local Output* s_Redirect = nullptr;
+    };
 } // namespace NCLI
-// --- Prompt.h --- //
+// --- Output.h --- //
 
-// --- Command.h --- //
+// --- Render.h --- //
 namespace NCLI
 {
-    struct Flag{
-        std::string Name;
-        std::string Help;
-        bool FlagSet=false;
-        Flag() = default;
-        Flag(const std::string& name)
-            : Name(name){}
-        Flag(const std::string& name, const std::string& help)
-            : Name(name), Help(help) {}
-        Flag(const std::string& name, const std::string& help, bool set)
-            : Name(name), Help(help), FlagSet(set){}
-    };
-    struct Option{
-        std::string Name;
-        std::string Help;
-        std::string Value;
-        std::vector<std::string> Values;
-        bool Set=false;
-        Option() = default;
-        Option(const std::string& name)
-            : Name(name){}
-        Option(const std::string& name, const std::string& help)
-            : Name(name), Help(help){}
-        Option(const std::string& name, const std::string& help, bool set)
-            : Name(name), Help(help), Set(set){}
-        Option(const std::string& name, const std::string& help, const std::string& default_value)
-            : Name(name), Help(help), Value(default_value){}
-        Option(const std::string& name, const std::string& help, const std::string& default_value, bool set)
-            : Name(name), Help(help), Value(default_value), Set(set) {}
-    };
-    using CommandFunc = std::function<bool(const std::vector<Flag> flags, const std::vector<Option> options)>;
-    struct Command {
-        std::string Name;
-        std::string Help;
-        CommandFunc Function;
-        std::vector<Flag> Flags;
-        std::vector<Option> Options;
-        Command() = default;
-        Command(const std::string& name)
-            : Name(name){}
-        Command(const std::string& name, const std::string& help)
-            : Name(name), Help(help) {}
-        Command(const std::string& name, const std::string& help, CommandFunc func)
-            : Name(name), Help(help), Function(func) {}
-        Command(const std::string& name, const std::string& help, CommandFunc func, std::vector<Flag> flags)
-            : Name(name), Help(help), Function(func), Flags(flags) {}
-        Command(const std::string& name, const std::string& help, CommandFunc func, std::vector<Flag> flags, std::vector<Option> options)
-            : Name(name), Help(help), Function(func), Flags(flags), Options(options) {}
-        
-        Command& add_flag(const std::string& flag_name, const std::string& help=""){
-            Flags.emplace_back(flag_name, help, false);
-            return *this;
-        }
-        Command& add_option(const std::string& option_name, const std::string& help=""){
-            Options.emplace_back(option_name, help, false);
-            return *this;
-        }
-        Command& option(const std::string& name, const std::string& help=""){
-            return add_option(name, help);
-        }
-        Command& flag(const std::string& name, const std::string& help=""){
-            return add_flag(name, help);
-        }
-        Command& action(CommandFunc action){
-            Function = action;
-            return *this;
-        }
-        bool set_flag(const std::string& name){
-            for(auto& flag : Flags){
-                if(flag.Name == name){
-                    flag.FlagSet = true;
-                    return true;
+    // Draws a block of lines in place, starting at the cursor's line, and
+    // keeps what is on screen. present() only rewrites the lines that changed
+    // since the last call, moving the cursor with relative escapes, so the
+    // rest of the screen and the scrollback are left alone. Lines should fit
+    // the terminal width and the block its height.
+    class FrameRenderer {
+        public:
+            explicit FrameRenderer(Output& out) : m_Out(out) {}
+            std::size_t size() const { return m_Lines.size(); }
+            void resize(std::size_t count){
+                if(count < m_Lines.size()){
+                    m_Lines.resize(count);
+                    m_Dirty.resize(count);
+                    return;
+                }
+                while(m_Lines.size() < count){
+                    m_Lines.emplace_back();
+                    m_Dirty.push_back(0);
+                    mark(m_Lines.size() - 1);
                 }
             }
-            return false;
-        }
-        bool set_option(const std::string& name, const std::string& value){
-            for(auto& option : Options){
-                if(option.Name == name){
-                    option.Value = value;
-                    option.Set = true;
-                    return true;
+            // Replace a line; nothing is redrawn if the text is unchanged
+            void set(std::size_t row, std::string line){
+                if(m_Lines[row] == line){
+                    return;
                 }
+                m_Lines[row] = std::move(line);
+                mark(row);
             }
-            return false;
-        }
-        bool set_option_vector(const std::string& name, const std::vector<std::string> values)
-        {
-            for(auto& option : Options) {
-                if(option.Name == name) {
-                    if(!option.Value.empty()){
-                        if (std::find(option.Values.begin(), option.Values.end(), option.Value) != option.Values.end())
-                        {
-                            option.Values.insert(option.Values.begin(), option.Value);
-                        }
-                    } else if(!values.empty()) {
-                        option.Value = values.front();
+            const std::string& line(std::size_t row) const { return m_Lines[row]; }
+            // Write the pending changes as one frame
+            void present(){
+                NCLI_TRACE_SCOPE(Render, "present");
+                Output::Frame frame(m_Out);
+                std::size_t rows = m_Lines.size();
+                std::sort(m_DirtyRows.begin(), m_DirtyRows.end());
+                for(std::size_t row : m_DirtyRows){
+                    if(row >= rows || row >= m_OnScreen){
+                        break;
                     }
-                    for(const auto& value : values)
-                    {
-                        option.Values.push_back(value);
+                    move_to(row);
+                    m_Out << "\r" << m_Lines[row] << "\033[K";
+                }
+                if(rows > m_OnScreen){
+                    // Grow the block below what is already drawn
+                    move_to(m_OnScreen);
+                    for(std::size_t row = m_OnScreen; row < rows; ++row){
+                        m_Out << "\r" << m_Lines[row] << "\033[K\n";
                     }
-                    option.Set = true;
-                    return true;
+                    m_Cursor = rows;
+                } else if(rows < m_OnScreen){
+                    move_to(rows);
+                    m_Out << "\r\033[J";
                 }
-            }
-            return false;
-        }
-        bool execute(){
-            // Collect flags that are set
-            std::vector<Flag> flags;
-            if(!Flags.empty()){
-                for(auto& flag : Flags){
-                    if(flag.FlagSet){
-                        std::cout << "Flag: " << flag.Name << "\n"; 
-                        flags.push_back(flag);
+                move_to(rows);
+                m_Out << "\r";
+                m_OnScreen = rows;
+                for(std::size_t row : m_DirtyRows){
+                    if(row < m_Dirty.size()){
+                        m_Dirty[row] = 0;
                     }
                 }
+                m_DirtyRows.clear();
             }
-            // Collect options that are set
-            std::vector<Option> options = { Option{} };
-            if(!Options.empty()){
-                for(auto& opt : Options){
-                    if(opt.Set){
-                        std::cout << "Option: " << opt.Name << "\n";
-                        options.push_back(opt);
-                    }
+            // Erase the block and leave the cursor where it started
+            void clear(){
+                Output::Frame frame(m_Out);
+                move_to(0);
+                m_Out << "\r\033[J";
+                m_OnScreen = 0;
+                m_Lines.clear();
+                m_Dirty.clear();
+                m_DirtyRows.clear();
+            }
+        private:
+            Output& m_Out;
+            std::vector<std::string> m_Lines;
+            std::vector<std::uint8_t> m_Dirty;
+            std::vector<std::size_t> m_DirtyRows;
+            std::size_t m_OnScreen = 0; // Rows drawn by the last present()
+            std::size_t m_Cursor = 0;   // Row the cursor is on, relative to the block
+            void mark(std::size_t row){
+                if(!m_Dirty[row]){
+                    m_Dirty[row] = 1;
+                    m_DirtyRows.push_back(row);
                 }
             }
-            return Function(flags, options);
-        }
-        
-        void display_help(){
-            std::cout << Color::cyan(Color::bold("Command: ")) << Color::green(Name) << "\n";
-            std::cout << Color::cyan(Color::bold("  Usage: ")) << Color::italic(Help) << "\n";
-            std::cout << Color::cyan(Color::bold("  Options:\n"));
-            for(const auto& option : Options){
-                if(option.Set){
-                    std::cout << Color::green("    [x] --" + option.Name) << ": " << Color::italic(option.Help) << "\n";
-                    std::cout << Color::green("            Current Value: ") << Color::bold(option.Value) << "\n";
-                } else {
-                    std::cout << Color::yellow("    [ ] --" + option.Name) << ": " << Color::italic(option.Help) << "\n";
+            void move_to(std::size_t row){
+                if(row == m_Cursor){
+                    return;
                 }
+                char number[24];
+                std::size_t distance = row < m_Cursor ? m_Cursor - row : row - m_Cursor;
+                auto result = std::to_chars(number, number + sizeof(number), distance);
+                m_Out << "\033[" << std::string_view(number, static_cast<std::size_t>(result.ptr - number)) << (row < m_Cursor ? "A" : "B");
+                m_Cursor = row;
             }
-            std::cout << Color::cyan(Color::bold("  Flags:\n"));
-            for(const auto& flag : Flags){
-                if(flag.FlagSet){
-                    std::cout << Color::green("    [x] -" + flag.Name) << ": " << Color::italic(flag.Help) << "\n";
+    };
+} // namespace NCLI
+// --- Render.h --- //
+
+// --- Terminal.h --- //
+#ifdef _WIN32
+#include <windows.h>
+#include <conio.h>
+#include <io.h>
+#else
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+namespace NCLI
+{
+    struct TerminalSize {
+        std::size_t Rows = 24;
+        std::size_t Cols = 80;
+    };
+    // Size of the terminal attached to stdout, or 24x80 if there is none
+    inline static TerminalSize terminal_size(){
+        TerminalSize size;
+#ifdef _WIN32
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if(GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)){
+            size.Rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+            size.Cols = info.srWindow.Right - info.srWindow.Left + 1;
+        }
+#else
+        struct winsize ws = {};
+        if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0){
+            size.Rows = ws.ws_row;
+            size.Cols = ws.ws_col;
+        }
+#endif
+        return size;
+    }
+    // True if stdin is an interactive terminal rather than a pipe or file
+    inline static bool stdin_is_terminal(){
+#ifdef _WIN32
+        return _isatty(0) != 0;
+#else
+        return isatty(STDIN_FILENO) != 0;
+#endif
+    }
+    // Notes SIGWINCH while in scope. The handler is installed without
+    // SA_RESTART, so a blocking read returns early and the widget can redraw.
+    class ResizeWatcher {
+        public:
+            ResizeWatcher(){
+#ifndef _WIN32
+                struct sigaction action = {};
+                action.sa_handler = &ResizeWatcher::on_resize;
+                sigemptyset(&action.sa_mask);
+                sigaction(SIGWINCH, &action, &m_Previous);
+#endif
+                s_Resized = 0;
+            }
+            ~ResizeWatcher(){
+#ifndef _WIN32
+                sigaction(SIGWINCH, &m_Previous, nullptr);
+#endif
+            }
+            ResizeWatcher(const ResizeWatcher&) = delete;
+            ResizeWatcher& operator=(const ResizeWatcher&) = delete;
+            // True once per resize
+            bool resized(){
+                if(s_Resized){
+                    s_Resized = 0;
+                    return true;
+                }
+                return false;
+            }
+        private:
+#ifndef _WIN32
+            struct sigaction m_Previous = {};
+#endif
+            inline static volatile std::sig_atomic_t s_Resized = 0;
+            static void on_resize(int){
+                s_Resized = 1;
+            }
+    };
+    // Window of Height rows over Count items that keeps Selected visible
+    struct Viewport {
+        std::size_t Count = 0;
+        std::size_t Height = 1;
+        std::size_t Top = 0;
+        std::size_t Selected = 0;
+        void up(){
+            Selected = Selected == 0 ? Count - 1 : Selected - 1;
+            follow();
+        }
+        void down(){
+            Selected = (Selected + 1) % Count;
+            follow();
+        }
+        void page_up(){
+            Selected = Selected > Height ? Selected - Height : 0;
+            follow();
+        }
+        void page_down(){
+            Selected = Selected + Height < Count ? Selected + Height : Count - 1;
+            follow();
+        }
+        void home(){
+            Selected = 0;
+            follow();
+        }
+        void end(){
+            Selected = Count - 1;
+            follow();
+        }
+        // Scroll so Selected is inside [Top, Top + Height)
+        void follow(){
+            if(Height > Count){
+                Height = Count;
+            }
+            if(Selected < Top){
+                Top = Selected;
+            } else if(Selected >= Top + Height){
+                Top = Selected - Height + 1;
+            }
+            if(Top + Height > Count){
+                Top = Count - Height;
+            }
+        }
+    };
+    // Keeps the terminal in raw mode (no line buffering, no echo) for the
+    // lifetime of the object, instead of toggling it around every key. The
+    // previous mode is restored on scope exit, during stack unwinding and
+    // from SIGINT/SIGTERM/SIGHUP/SIGQUIT. Input is read in batches into a
+    // buffer, so key repeat and pasted text are not lost or echoed.
+    // A session opened while another is active shares the outer one.
+    class RawTerminalSession {
+        public:
+            explicit RawTerminalSession(int fd = 0)
+                : m_Fd(fd), m_Outer(s_Current) {
+                s_Current = this;
+                if(m_Outer != nullptr){
+                    return;
+                }
+#ifndef _WIN32
+                if(!isatty(m_Fd) || tcgetattr(m_Fd, &s_Saved) < 0){
+                    return;
+                }
+                struct termios raw = s_Saved;
+                raw.c_lflag &= ~(ICANON | ECHO); // Disable canonical mode and echo
+                raw.c_cc[VMIN] = 1;
+                raw.c_cc[VTIME] = 0;
+                s_SavedFd = m_Fd;
+                s_Raw = 1;
+                struct sigaction action = {};
+                action.sa_handler = &RawTerminalSession::on_signal;
+                sigemptyset(&action.sa_mask);
+                for(int i = 0; i < SignalCount; ++i){
+                    sigaction(Signals[i], &action, &m_Previous[i]);
+                }
+                tcsetattr(m_Fd, TCSANOW, &raw);
+                m_Raw = true;
+#endif
+            }
+            ~RawTerminalSession(){
+                s_Current = m_Outer;
+#ifndef _WIN32
+                if(m_Raw){
+                    tcsetattr(m_Fd, TCSANOW, &s_Saved);
+                    s_Raw = 0;
+                    for(int i = 0; i < SignalCount; ++i){
+                        sigaction(Signals[i], &m_Previous[i], nullptr);
+                    }
+                }
+#endif
+            }
+            RawTerminalSession(const RawTerminalSession&) = delete;
+            RawTerminalSession& operator=(const RawTerminalSession&) = delete;
+            // Innermost open session, or nullptr
+            static RawTerminalSession* current(){ return s_Current; }
+            // Next input byte, or -1 on end of input or when interrupted by a signal
+            int read_byte(){
+                if(m_Outer != nullptr){
+                    return m_Outer->read_byte();
+                }
+                if(m_Begin == m_End && !fill()){
+                    return -1;
+                }
+                return static_cast<unsigned char>(m_Buffer[m_Begin++]);
+            }
+            // True once the input has ended (as opposed to a read cut short by a signal)
+            bool eof() const {
+                return m_Outer != nullptr ? m_Outer->eof() : m_Eof;
+            }
+            // Bytes already read from the terminal but not consumed yet
+            std::size_t buffered() const {
+                return m_Outer != nullptr ? m_Outer->buffered() : m_End - m_Begin;
+            }
+            // Wait up to timeout_ms for input; true if a byte can be read without blocking
+            bool wait(int timeout_ms){
+                if(m_Outer != nullptr){
+                    return m_Outer->wait(timeout_ms);
+                }
+                if(m_Begin != m_End){
+                    return true;
+                }
+#ifdef _WIN32
+                (void)timeout_ms;
+                return _kbhit() != 0;
+#else
+                struct pollfd pfd = {m_Fd, POLLIN, 0};
+                return ::poll(&pfd, 1, timeout_ms) > 0;
+#endif
+            }
+        private:
+            static constexpr std::size_t BufferSize = 4096;
+            int m_Fd;
+            RawTerminalSession* m_Outer;
+            bool m_Raw = false;
+            bool m_Eof = false;
+            char m_Buffer[BufferSize];
+            std::size_t m_Begin = 0;
+            std::size_t m_End = 0;
+            inline static RawTerminalSession* s_Current = nullptr;
+            bool fill(){
+                m_Begin = m_End = 0;
+#ifdef _WIN32
+                m_Buffer[m_End++] = static_cast<char>(_getch());
+                return true;
+#else
+                ssize_t count = ::read(m_Fd, m_Buffer, BufferSize);
+                if(count <= 0){
+                    // EOF, or EINTR (e.g. SIGWINCH) so the caller can react
+                    m_Eof = count == 0 || errno != EINTR;
+                    return false;
+                }
+                m_End = static_cast<std::size_t>(count);
+                return true;
+#endif
+            }
+#ifndef _WIN32
+            static constexpr int SignalCount = 4;
+            static constexpr int Signals[SignalCount] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT};
+            struct sigaction m_Previous[SignalCount] = {};
+            inline static struct termios s_Saved = {};
+            inline static int s_SavedFd = 0;
+            inline static volatile std::sig_atomic_t s_Raw = 0;
+            // Restore the terminal (cursor, paste mode), then let the signal take its default course
+            static void on_signal(int sig){
+                if(s_Raw){
+                    tcsetattr(s_SavedFd, TCSANOW, &s_Saved);
+                    static const char restore[] = "\033[?25h\033[?2004l";
+                    ssize_t ignored = ::write(1, restore, sizeof(restore) - 1);
+                    (void)ignored;
+                }
+                signal(sig, SIG_DFL);
+                raise(sig);
+            }
+#endif
+    };
+} // namespace NCLI
+// --- Terminal.h --- //
+
+// --- Input.h --- //
+namespace NCLI
+{
+    struct KeyEvent {
+        enum class Key {
+            None, Char, Enter, Tab, Backspace, Escape,
+            Up, Down, Left, Right, Home, End, PageUp, PageDown, Insert, Delete,
+            Ctrl, Paste, Unknown
+        };
+        Key Type = Key::None;
+        char32_t Codepoint = 0; // Char: the character; Ctrl: the letter, e.g. 'c' for Ctrl-C
+        std::string Text;       // Char: its UTF-8 bytes; Paste: the pasted text
+    };
+    // Incremental decoder from raw terminal bytes to KeyEvents. Bytes can be
+    // fed in any split (one at a time or a whole pasted buffer); each byte is
+    // looked at once. A sequence still open when input pauses (a bare Escape,
+    // say) is completed by timeout().
+    class InputDecoder {
+        public:
+            void feed(unsigned char byte){
+                switch(m_State){
+                    case State::Ground: ground(byte); break;
+                    case State::Escape: escape(byte); break;
+                    case State::Csi: csi(byte); break;
+                    case State::Ss3: ss3(byte); break;
+                    case State::Utf8: utf8(byte); break;
+                    case State::Paste: paste(byte); break;
+                }
+            }
+            void feed(std::string_view bytes){
+                for(char c : bytes){
+                    feed(static_cast<unsigned char>(c));
+                }
+            }
+            // Next decoded event, if any
+            bool next(KeyEvent& event){
+                if(m_Read == m_Events.size()){
+                    return false;
+                }
+                event = std::move(m_Events[m_Read++]);
+                if(m_Read == m_Events.size()){
+                    m_Events.clear();
+                    m_Read = 0;
+                }
+                return true;
+            }
+            // True if next() has an event
+            bool queued() const { return m_Read < m_Events.size(); }
+            // True while in the middle of a sequence that a pause should complete
+            bool pending() const {
+                return m_State == State::Escape || m_State == State::Csi || m_State == State::Ss3 || m_State == State::Utf8;
+            }
+            // Input paused mid-sequence: a lone ESC is the Escape key, anything else is dropped
+            void timeout(){
+                if(m_State == State::Escape){
+                    emit(KeyEvent::Key::Escape);
+                } else if(pending()){
+                    emit(KeyEvent::Key::Unknown);
+                }
+                m_State = State::Ground;
+            }
+        private:
+            enum class State { Ground, Escape, Csi, Ss3, Utf8, Paste };
+            State m_State = State::Ground;
+            std::vector<KeyEvent> m_Events;
+            std::size_t m_Read = 0;
+            std::string m_Params;   // CSI parameter bytes
+            std::string m_Pending;  // UTF-8 bytes of the character being decoded
+            char32_t m_Codepoint = 0;
+            int m_Remaining = 0;
+            std::string m_Paste;
+            KeyEvent& emit(KeyEvent::Key type, char32_t codepoint=0){
+                m_Events.emplace_back();
+                KeyEvent& event = m_Events.back();
+                event.Type = type;
+                event.Codepoint = codepoint;
+                return event;
+            }
+            void ground(unsigned char byte){
+                if(byte == 0x1b){
+                    m_State = State::Escape;
+                } else if(byte == '\r' || byte == '\n'){
+                    emit(KeyEvent::Key::Enter);
+                } else if(byte == '\t'){
+                    emit(KeyEvent::Key::Tab);
+                } else if(byte == 0x7f || byte == 0x08){
+                    emit(KeyEvent::Key::Backspace);
+                } else if(byte < 0x20){
+                    emit(KeyEvent::Key::Ctrl, U'a' + byte - 1);
+                } else if(byte < 0x80){
+                    emit(KeyEvent::Key::Char, byte).Text.assign(1, static_cast<char>(byte));
+                } else if(byte >= 0xc2 && byte <= 0xf4){
+                    // UTF-8 lead byte
+                    m_Remaining = byte >= 0xf0 ? 3 : byte >= 0xe0 ? 2 : 1;
+                    m_Codepoint = byte & (0x3f >> m_Remaining);
+                    m_Pending.assign(1, static_cast<char>(byte));
+                    m_State = State::Utf8;
+                } else {
+                    emit(KeyEvent::Key::Unknown);
+                }
+            }
+            void escape(unsigned char byte){
+                if(byte == '['){
+                    m_Params.clear();
+                    m_State = State::Csi;
+                } else if(byte == 'O'){
+                    m_State = State::Ss3;
+                } else {
+                    // ESC followed by something else: the Escape key, then that byte
+                    emit(KeyEvent::Key::Escape);
+                    m_State = State::Ground;
+                    ground(byte);
+                }
+            }
+            void csi(unsigned char byte){
+                if(byte >= 0x20 && byte <= 0x3f){
+                    m_Params.push_back(static_cast<char>(byte));
+                    return;
+                }
+                m_State = State::Ground;
+                // Only the first parameter matters here; modifiers (e.g. 1;5A) are ignored
+                int param = 0;
+                for(char c : m_Params){
+                    if(c < '0' || c > '9'){
+                        break;
+                    }
+                    param = param * 10 + (c - '0');
+                }
+                switch(byte){
+                    case 'A': emit(KeyEvent::Key::Up); break;
+                    case 'B': emit(KeyEvent::Key::Down); break;
+                    case 'C': emit(KeyEvent::Key::Right); break;
+                    case 'D': emit(KeyEvent::Key::Left); break;
+                    case 'H': emit(KeyEvent::Key::Home); break;
+                    case 'F': emit(KeyEvent::Key::End); break;
+                    case '~':
+                        switch(param){
+                            case 1: case 7: emit(KeyEvent::Key::Home); break;
+                            case 4: case 8: emit(KeyEvent::Key::End); break;
+                            case 2: emit(KeyEvent::Key::Insert); break;
+                            case 3: emit(KeyEvent::Key::Delete); break;
+                            case 5: emit(KeyEvent::Key::PageUp); break;
+                            case 6: emit(KeyEvent::Key::PageDown); break;
+                            case 200:
+                                m_Paste.clear();
+                                m_State = State::Paste;
+                                break;
+                            default: emit(KeyEvent::Key::Unknown); break;
+                        }
+                        break;
+                    default: emit(KeyEvent::Key::Unknown); break;
+                }
+            }
+            void ss3(unsigned char byte){
+                m_State = State::Ground;
+                switch(byte){
+                    case 'A': emit(KeyEvent::Key::Up); break;
+                    case 'B': emit(KeyEvent::Key::Down); break;
+                    case 'C': emit(KeyEvent::Key::Right); break;
+                    case 'D': emit(KeyEvent::Key::Left); break;
+                    case 'H': emit(KeyEvent::Key::Home); break;
+                    case 'F': emit(KeyEvent::Key::End); break;
+                    default: emit(KeyEvent::Key::Unknown); break;
+                }
+            }
+            void utf8(unsigned char byte){
+                if((byte & 0xc0) != 0x80){
+                    // Truncated character; decode the byte on its own
+                    emit(KeyEvent::Key::Unknown);
+                    m_State = State::Ground;
+                    ground(byte);
+                    return;
+                }
+                m_Codepoint = (m_Codepoint << 6) | (byte & 0x3f);
+                m_Pending.push_back(static_cast<char>(byte));
+                if(--m_Remaining == 0){
+                    emit(KeyEvent::Key::Char, m_Codepoint).Text = m_Pending;
+                    m_State = State::Ground;
+                }
+            }
+            // Bracketed paste: everything up to ESC[201~ is one Paste event
+            void paste(unsigned char byte){
+                static constexpr std::string_view End = "\033[201~";
+                m_Paste.push_back(static_cast<char>(byte));
+                if(byte == '~' && m_Paste.size() >= End.size() &&
+                   std::string_view(m_Paste).substr(m_Paste.size() - End.size()) == End){
+                    m_Paste.resize(m_Paste.size() - End.size());
+                    emit(KeyEvent::Key::Paste).Text = std::move(m_Paste);
+                    m_Paste.clear();
+                    m_State = State::Ground;
+                }
+            }
+    };
+    // Reads KeyEvents from a RawTerminalSession through an InputDecoder.
+    // A sequence left open for escape_timeout_ms is completed, so a bare
+    // Escape never blocks. With paste enabled, bracketed paste mode is on
+    // while the reader exists and a paste arrives as one event.
+    class KeyReader {
+        public:
+            explicit KeyReader(RawTerminalSession& session, bool paste=false, int escape_timeout_ms=25)
+                : m_Session(session), m_Paste(paste), m_Timeout(escape_timeout_ms) {
+                if(m_Paste){
+                    Output::standard().write("\033[?2004h").flush();
+                }
+            }
+            ~KeyReader(){
+                if(m_Paste){
+                    Output::standard().write("\033[?2004l").flush();
+                }
+            }
+            KeyReader(const KeyReader&) = delete;
+            KeyReader& operator=(const KeyReader&) = delete;
+            // Blocks for the next event. Returns false if input ended or a
+            // signal (e.g. SIGWINCH) interrupted the read.
+            bool next(KeyEvent& event){
+                while(!m_Decoder.next(event)){
+                    if(m_Decoder.pending() && !m_Session.wait(m_Timeout)){
+                        m_Decoder.timeout();
+                        continue;
+                    }
+                    int byte = m_Session.read_byte();
+                    if(byte < 0){
+                        return false;
+                    }
+                    m_Decoder.feed(static_cast<unsigned char>(byte));
+                }
+                return true;
+            }
+            // True if next() can return without waiting for the terminal, e.g.
+            // while working through a paste; callers may skip redrawing
+            bool ready() const {
+                return m_Decoder.queued() || m_Session.buffered() > 0;
+            }
+            bool eof() const { return m_Session.eof(); }
+        private:
+            RawTerminalSession& m_Session;
+            InputDecoder m_Decoder;
+            bool m_Paste;
+            int m_Timeout;
+    };
+} // namespace NCLI
+// --- Input.h --- //
+
+// --- ThreadPool.h --- //
+namespace NCLI
+{
+    // Fixed set of worker threads with a task queue each. Workers take their
+    // own newest tasks first and steal the oldest from the others when they
+    // run dry; tasks submitted from outside the pool go to a shared inbox.
+    // Threads waiting in parallel_for() run queued tasks meanwhile, so
+    // nested parallel_for() calls cannot starve the pool.
+    class ThreadPool {
+        public:
+            explicit ThreadPool(std::size_t threads = default_threads()){
+                // One queue per worker, then the inbox
+                for(std::size_t i = 0; i <= threads; ++i){
+                    m_Queues.push_back(std::make_unique<Queue>());
+                }
+                m_Workers.reserve(threads);
+                for(std::size_t i = 0; i < threads; ++i){
+                    m_Workers.emplace_back([this, i]{ work(i); });
+                }
+            }
+            ~ThreadPool(){
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    m_Stop = true;
+                }
+                m_Ready.notify_all();
+                for(std::thread& worker : m_Workers){
+                    worker.join();
+                }
+            }
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+            std::size_t size() const { return m_Workers.size(); }
+            void submit(std::function<void()> task){
+                Queue& queue = *m_Queues[s_Pool == this ? s_Index : inbox()];
+                {
+                    std::lock_guard<std::mutex> lock(queue.Mutex);
+                    queue.Tasks.push_back(std::move(task));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    ++m_Pending;
+                }
+                m_Ready.notify_one();
+            }
+            // Run fn(i) for every i in [0, count) and wait. The calling thread
+            // takes part, so a pool without workers simply runs the loop.
+            template<typename Fn>
+            void parallel_for(std::size_t count, Fn&& fn){
+                std::atomic<std::size_t> next{0};
+                auto drain = [&next, &fn, count]{
+                    for(std::size_t i = next++; i < count; i = next++){
+                        fn(i);
+                    }
+                };
+                std::size_t helpers = count > 1 ? std::min(size(), count - 1) : 0;
+                std::atomic<std::size_t> running{helpers};
+                for(std::size_t h = 0; h < helpers; ++h){
+                    submit([&]{
+                        drain();
+                        if(--running == 0){
+                            std::lock_guard<std::mutex> lock(m_Mutex);
+                            m_Ready.notify_all();
+                        }
+                    });
+                }
+                drain();
+                // Help with whatever is queued until the helpers are done
+                std::size_t self = s_Pool == this ? s_Index : inbox();
+                while(running.load() != 0){
+                    if(run_one(self)){
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_Ready.wait(lock, [this, &running]{ return running.load() == 0 || m_Pending > 0; });
+                }
+            }
+            // Workers for the calling thread to share the machine with
+            static std::size_t default_threads(){
+                unsigned int cores = std::thread::hardware_concurrency();
+                return cores > 1 ? cores - 1 : 0;
+            }
+            // Process-wide pool, started on first use
+            static ThreadPool& shared(){
+                static ThreadPool pool;
+                return pool;
+            }
+        private:
+            struct Queue {
+                std::mutex Mutex;
+                std::deque<std::function<void()>> Tasks;
+            };
+            std::vector<std::thread> m_Workers;
+            std::vector<std::unique_ptr<Queue>> m_Queues;
+            std::mutex m_Mutex; // Guards sleeping and waking
+            std::condition_variable m_Ready;
+            std::size_t m_Pending = 0; // Tasks queued and not taken yet
+            bool m_Stop = false;
+            // Pool and queue of the worker running on this thread
+            inline static thread_local ThreadPool* s_Pool = nullptr;
+            inline static thread_local std::size_t s_Index = 0;
+            std::size_t inbox() const { return m_Queues.size() - 1; }
+            // Run one queued task, preferably from queue self; false if there was none
+            bool run_one(std::size_t self){
+                std::function<void()> task;
+                if(!take(*m_Queues[self], true, task)){
+                    std::size_t count = m_Queues.size();
+                    for(std::size_t k = 1; k < count && !task; ++k){
+                        take(*m_Queues[(self + k) % count], false, task);
+                    }
+                    if(!task){
+                        return false;
+                    }
+                }
+                task();
+                return true;
+            }
+            // Newest task of a queue for its owner, oldest for thieves
+            bool take(Queue& queue, bool own, std::function<void()>& task){
+                {
+                    std::lock_guard<std::mutex> lock(queue.Mutex);
+                    if(queue.Tasks.empty()){
+                        return false;
+                    }
+                    if(own){
+                        task = std::move(queue.Tasks.back());
+                        queue.Tasks.pop_back();
+                    } else {
+                        task = std::move(queue.Tasks.front());
+                        queue.Tasks.pop_front();
+                    }
+                }
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                --m_Pending;
+                return true;
+            }
+            void work(std::size_t index){
+                s_Pool = this;
+                s_Index = index;
+                while(true){
+                    if(run_one(index)){
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_Ready.wait(lock, [this]{ return m_Stop || m_Pending > 0; });
+                    if(m_Stop && m_Pending == 0){
+                        return;
+                    }
+                }
+            }
+    };
+} // namespace NCLI
+// --- ThreadPool.h --- //
+
+// --- Fuzzy.h --- //
+namespace NCLI
+{
+    struct FuzzyMatch {
+        std::uint32_t Index;
+        std::int32_t Score;
+        std::uint32_t End; // Just past the last matched character
+    };
+    // Better score first, then original order
+    inline static bool fuzzy_better(const FuzzyMatch& a, const FuzzyMatch& b){
+        return a.Score != b.Score ? a.Score > b.Score : a.Index < b.Index;
+    }
+    // Case-insensitive subsequence matcher over a fixed candidate set.
+    //
+    // Candidates are folded to lower case once and stored back to back, each
+    // with a 64-bit mask of the characters it contains, so most non-matches
+    // are rejected by one AND before any text is touched, and the scan for
+    // each query character is a memchr over contiguous bytes.
+    //
+    // update() is incremental: extending the query only rescores the
+    // survivors of the previous query, and only for the new characters, since
+    // the leftmost match of a query starts with the leftmost match of its
+    // prefix. Shortening the query (backspace) goes back to the survivors
+    // already computed for the shorter query. Results are ordered lazily;
+    // at(pos) only sorts as far as pos. Large sets are scored in parallel,
+    // and a search made stale by new input can be cut short.
+    class FuzzyMatcher {
+        public:
+            static constexpr std::int32_t NoMatch = INT32_MIN;
+            // Large candidate sets are scored on pool, or on ThreadPool::shared()
+            // if none is given
+            explicit FuzzyMatcher(const std::vector<std::string>& candidates, ThreadPool* pool = nullptr)
+                : m_Pool(pool) {
+                std::size_t total = 0;
+                for(const std::string& candidate : candidates){
+                    total += candidate.size();
+                }
+                m_Text.reserve(total);
+                m_Bonus.reserve(total);
+                m_Offsets.reserve(candidates.size() + 1);
+                m_Masks.reserve(candidates.size());
+                for(const std::string& candidate : candidates){
+                    add(candidate);
+                }
+                m_Offsets.push_back(static_cast<std::uint32_t>(m_Text.size()));
+            }
+            std::size_t candidates() const { return m_Masks.size(); }
+            const std::string& query() const { return m_Query; }
+            // Number of candidates matching the current query
+            std::size_t size() const {
+                return m_Levels.empty() ? candidates() : m_Levels.back().Matches.size();
+            }
+            // Candidate index of the pos-th best match. With an empty query
+            // every candidate matches, in its original order.
+            std::uint32_t at(std::size_t pos){
+                if(m_Levels.empty()){
+                    return static_cast<std::uint32_t>(pos);
+                }
+                sort_to(m_Levels.back(), pos + 1);
+                return m_Levels.back().Matches[pos].Index;
+            }
+            // The best k matches, best first (fewer if fewer match)
+            const FuzzyMatch* top(std::size_t k){
+                if(m_Levels.empty()){
+                    return nullptr;
+                }
+                sort_to(m_Levels.back(), k);
+                return m_Levels.back().Matches.data();
+            }
+            // Match against query. interrupted, if given, is polled between
+            // chunks of work (possibly from pool threads); when it returns true
+            // the search stops and update() returns false, leaving the matches
+            // of the longest prefix of query already computed. Calling update()
+            // again resumes from there.
+            bool update(std::string_view query, const std::function<bool()>& interrupted = nullptr){
+                std::string folded(query);
+                for(char& c : folded){
+                    c = fold(c);
+                }
+                std::size_t common = 0;
+                while(common < folded.size() && common < m_Query.size() && folded[common] == m_Query[common]){
+                    ++common;
+                }
+                // Survivors of any query that is still a prefix remain valid
+                while(!m_Levels.empty() && m_Levels.back().Length > common){
+                    m_Levels.pop_back();
+                }
+                m_Query = std::move(folded);
+                if(m_Query.size() > (m_Levels.empty() ? 0 : m_Levels.back().Length)){
+                    return narrow(interrupted);
+                }
+                return true;
+            }
+            // Score of candidate i against a folded query, or NoMatch
+            std::int32_t score(std::uint32_t i, std::string_view query) const {
+                FuzzyMatch match{i, length_penalty(i), 0};
+                return extend(match, query, true) ? match.Score : NoMatch;
+            }
+        private:
+            static constexpr std::int32_t MatchScore = 16;
+            static constexpr std::int32_t ConsecutiveBonus = 8;
+            static constexpr std::size_t MaxGapPenalty = 8;
+            static constexpr std::uint8_t WordBonus = 8;  // First character or after a separator
+            static constexpr std::uint8_t CamelBonus = 6; // Upper case after lower case
+            static constexpr std::size_t ChunkSize = 16384;
+            static constexpr std::size_t ParallelThreshold = 4 * ChunkSize;
+            static constexpr std::size_t TopK = 64; // Matches ranked while filtering
+            struct Level {
+                std::size_t Length = 0; // Query length this level was computed for
+                std::vector<FuzzyMatch> Matches;
+                std::size_t Sorted = 0; // Matches[0, Sorted) are the best, in order
+            };
+            std::string m_Text; // All candidates, folded, back to back
+            std::vector<std::uint8_t> m_Bonus;
+            std::vector<std::uint32_t> m_Offsets;
+            std::vector<std::uint64_t> m_Masks;
+            std::string m_Query;
+            std::vector<Level> m_Levels;
+            ThreadPool* m_Pool;
+            std::vector<std::vector<FuzzyMatch>> m_Parts; // Per-chunk results, reused
+            std::vector<std::size_t> m_Taken;
+            static char fold(char c){
+                return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+            }
+            static bool separator(char c){
+                return c == ' ' || c == '-' || c == '_' || c == '/' || c == '.' || c == ':' || c == ',';
+            }
+            // Which of the 64 mask bits a folded character sets
+            static std::uint64_t bit(char c){
+                unsigned char u = static_cast<unsigned char>(c);
+                if(u >= 'a' && u <= 'z'){
+                    return 1ull << (u - 'a');
+                }
+                if(u >= '0' && u <= '9'){
+                    return 1ull << (26 + u - '0');
+                }
+                if(u < 0x80){
+                    return 1ull << (36 + u % 27);
+                }
+                return 1ull << 63;
+            }
+            static std::uint64_t mask(std::string_view folded){
+                std::uint64_t m = 0;
+                for(char c : folded){
+                    m |= bit(c);
+                }
+                return m;
+            }
+            // Prefer shorter candidates among otherwise equal matches
+            std::int32_t length_penalty(std::uint32_t i) const {
+                return -static_cast<std::int32_t>(std::min<std::size_t>((m_Offsets[i + 1] - m_Offsets[i]) / 8, MaxGapPenalty));
+            }
+            // Match more query characters after match.End, updating its score
+            bool extend(FuzzyMatch& match, std::string_view more, bool first) const {
+                const char* text = m_Text.data() + m_Offsets[match.Index];
+                const std::uint8_t* bonus = m_Bonus.data() + m_Offsets[match.Index];
+                std::size_t length = m_Offsets[match.Index + 1] - m_Offsets[match.Index];
+                std::size_t from = match.End;
+                for(char c : more){
+                    const void* hit = std::memchr(text + from, c, length - from);
+                    if(hit == nullptr){
+                        return false;
+                    }
+                    std::size_t at = static_cast<std::size_t>(static_cast<const char*>(hit) - text);
+                    std::size_t gap = at - from;
+                    match.Score += MatchScore + bonus[at];
+                    match.Score += (!first && gap == 0) ? ConsecutiveBonus : -static_cast<std::int32_t>(std::min<std::size_t>(gap, MaxGapPenalty));
+                    from = at + 1;
+                    first = false;
+                }
+                match.End = static_cast<std::uint32_t>(from);
+                return true;
+            }
+            void add(const std::string& candidate){
+                m_Offsets.push_back(static_cast<std::uint32_t>(m_Text.size()));
+                std::uint64_t m = 0;
+                char previous = ' ';
+                for(char c : candidate){
+                    char folded = fold(c);
+                    std::uint8_t bonus = 0;
+                    if(separator(previous)){
+                        bonus = WordBonus;
+                    } else if(c != folded && previous == fold(previous) && !separator(c)){
+                        bonus = CamelBonus;
+                    }
+                    m_Text.push_back(folded);
+                    m_Bonus.push_back(bonus);
+                    m |= bit(folded);
+                    previous = c;
+                }
+                m_Masks.push_back(m);
+            }
+            // Push a level for m_Query, rescoring only the previous survivors.
+            // The work is cut into chunks, spread over the pool when there is
+            // enough of it; each chunk keeps its own best TopK in front, and
+            // those are merged at the end. Returns false, pushing nothing, if
+            // interrupted() reports newer input between chunks.
+            bool narrow(const std::function<bool()>& interrupted){
+                const Level* previous = m_Levels.empty() ? nullptr : &m_Levels.back();
+                std::size_t total = previous != nullptr ? previous->Matches.size() : m_Masks.size();
+                std::string_view query = m_Query;
+                std::string_view more = previous != nullptr ? query.substr(previous->Length) : query;
+                std::uint64_t needed = mask(query);
+                std::size_t chunks = (total + ChunkSize - 1) / ChunkSize;
+                m_Parts.resize(chunks);
+                std::atomic<bool> cancelled{false};
+                auto run = [&](std::size_t chunk){
+                    if(cancelled.load(std::memory_order_relaxed)){
+                        return;
+                    }
+                    if(interrupted && interrupted()){
+                        cancelled.store(true, std::memory_order_relaxed);
+                        return;
+                    }
+                    std::size_t begin = chunk * ChunkSize;
+                    std::size_t end = std::min(total, begin + ChunkSize);
+                    std::vector<FuzzyMatch>& out = m_Parts[chunk];
+                    out.clear();
+                    if(previous != nullptr){
+                        for(std::size_t i = begin; i < end; ++i){
+                            FuzzyMatch match = previous->Matches[i];
+                            if((m_Masks[match.Index] & needed) == needed && extend(match, more, false)){
+                                out.push_back(match);
+                            }
+                        }
+                    } else {
+                        const std::uint64_t* masks = m_Masks.data();
+                        for(std::size_t i = begin; i < end; ++i){
+                            if((masks[i] & needed) != needed){
+                                continue;
+                            }
+                            FuzzyMatch match{static_cast<std::uint32_t>(i), length_penalty(static_cast<std::uint32_t>(i)), 0};
+                            if(extend(match, query, true)){
+                                out.push_back(match);
+                            }
+                        }
+                    }
+                    std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(std::min(TopK, out.size())), out.end(), fuzzy_better);
+                };
+                if(chunks > 1 && total >= ParallelThreshold){
+                    ThreadPool& pool = m_Pool != nullptr ? *m_Pool : ThreadPool::shared();
+                    pool.parallel_for(chunks, run);
+                } else {
+                    for(std::size_t chunk = 0; chunk < chunks; ++chunk){
+                        run(chunk);
+                    }
+                }
+                if(cancelled.load()){
+                    return false;
+                }
+                Level level;
+                level.Length = m_Query.size();
+                merge(level);
+                m_Levels.push_back(std::move(level));
+                return true;
+            }
+            // Best TopK of all chunks first (a merge of their sorted fronts), then the rest
+            void merge(Level& level){
+                std::size_t total = 0;
+                for(const std::vector<FuzzyMatch>& part : m_Parts){
+                    total += part.size();
+                }
+                level.Matches.reserve(total);
+                m_Taken.assign(m_Parts.size(), 0);
+                std::size_t best_count = std::min(TopK, total);
+                for(std::size_t n = 0; n < best_count; ++n){
+                    std::size_t best = m_Parts.size();
+                    for(std::size_t c = 0; c < m_Parts.size(); ++c){
+                        if(m_Taken[c] < std::min(TopK, m_Parts[c].size()) &&
+                           (best == m_Parts.size() || fuzzy_better(m_Parts[c][m_Taken[c]], m_Parts[best][m_Taken[best]]))){
+                            best = c;
+                        }
+                    }
+                    level.Matches.push_back(m_Parts[best][m_Taken[best]++]);
+                }
+                for(std::size_t c = 0; c < m_Parts.size(); ++c){
+                    level.Matches.insert(level.Matches.end(), m_Parts[c].begin() + static_cast<std::ptrdiff_t>(m_Taken[c]), m_Parts[c].end());
+                }
+                level.Sorted = best_count;
+            }
+            // Partial sort so the first count matches are final. Grows
+            // geometrically, so scrolling down a long result stays cheap.
+            static void sort_to(Level& level, std::size_t count){
+                std::vector<FuzzyMatch>& matches = level.Matches;
+                if(count <= level.Sorted || level.Sorted == matches.size()){
+                    return;
+                }
+                std::size_t target = std::min(matches.size(), std::max({count, level.Sorted * 2, TopK}));
+                std::partial_sort(matches.begin() + static_cast<std::ptrdiff_t>(level.Sorted),
+                                  matches.begin() + static_cast<std::ptrdiff_t>(target),
+                                  matches.end(), fuzzy_better);
+                level.Sorted = target;
+            }
+    };
+} // namespace NCLI
+// --- Fuzzy.h --- //
+
+// --- LineEditor.h --- //
+namespace NCLI
+{
+    // Columns text takes on screen: UTF-8 characters count one each and
+    // escape sequences (e.g. colors) count nothing
+    inline static std::size_t display_width(std::string_view text){
+        std::size_t width = 0;
+        for(std::size_t i = 0; i < text.size(); ++i){
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if(c == 0x1b && i + 1 < text.size() && text[i + 1] == '['){
+                i += 2;
+                while(i < text.size() && !(text[i] >= 0x40 && text[i] <= 0x7e)){
+                    ++i;
+                }
+            } else if((c & 0xc0) != 0x80){
+                ++width;
+            }
+        }
+        return width;
+    }
+    // Single-line editor with history, driven by KeyEvents. Supports
+    // Left/Right, Home/End (Ctrl-A/Ctrl-E), Backspace/Delete, Ctrl-U/Ctrl-K
+    // (delete to start/end), Ctrl-W (delete word), Ctrl-L (clear screen),
+    // Up/Down through history and bracketed paste. Lines longer than the
+    // terminal scroll sideways. When stdin is not a terminal, lines are
+    // read as they are, without echo or editing.
+    class LineEditor {
+        public:
+            explicit LineEditor(Output& out = Output::standard(), std::size_t history_limit = 1000)
+                : m_Out(out), m_Limit(history_limit) {}
+            // Show prompt and read a line into line; false at end of input
+            // (or Ctrl-D on an empty line)
+            bool read(std::string_view prompt, std::string& line){
+                if(!stdin_is_terminal()){
+                    return static_cast<bool>(std::getline(std::cin, line));
+                }
+                RawTerminalSession session;
+                KeyReader keys(session, true);
+                KeyEvent key;
+                m_Line.clear();
+                m_Cursor = 0;
+                std::size_t browsing = m_History.size();
+                std::string draft; // The line being typed, while browsing history
+                while(true){
+                    if(!keys.ready()){
+                        render(prompt);
+                    }
+                    if(!keys.next(key)){
+                        if(keys.eof()){
+                            m_Out << "\n";
+                            m_Out.flush();
+                            return false;
+                        }
+                        continue; // Interrupted, e.g. by a resize: redraw
+                    }
+                    switch(key.Type){
+                        case KeyEvent::Key::Char:
+                            insert(key.Text);
+                            break;
+                        case KeyEvent::Key::Paste:
+                            // Pasted line breaks become spaces; the line is entered with Enter
+                            for(char& c : key.Text){
+                                if(c == '\n' || c == '\r' || c == '\t'){
+                                    c = ' ';
+                                }
+                            }
+                            insert(key.Text);
+                            break;
+                        case KeyEvent::Key::Backspace:
+                            erase(previous(m_Cursor), m_Cursor);
+                            break;
+                        case KeyEvent::Key::Delete:
+                            erase(m_Cursor, next(m_Cursor));
+                            break;
+                        case KeyEvent::Key::Left:
+                            m_Cursor = previous(m_Cursor);
+                            break;
+                        case KeyEvent::Key::Right:
+                            m_Cursor = next(m_Cursor);
+                            break;
+                        case KeyEvent::Key::Home:
+                            m_Cursor = 0;
+                            break;
+                        case KeyEvent::Key::End:
+                            m_Cursor = m_Line.size();
+                            break;
+                        case KeyEvent::Key::Up:
+                            if(browsing > 0){
+                                if(browsing == m_History.size()){
+                                    draft = m_Line;
+                                }
+                                m_Line = m_History[--browsing];
+                                m_Cursor = m_Line.size();
+                            }
+                            break;
+                        case KeyEvent::Key::Down:
+                            if(browsing < m_History.size()){
+                                ++browsing;
+                                m_Line = browsing == m_History.size() ? draft : m_History[browsing];
+                                m_Cursor = m_Line.size();
+                            }
+                            break;
+                        case KeyEvent::Key::Enter:
+                            // Leave the whole line on screen, even if typed ahead of redraws
+                            m_Cursor = m_Line.size();
+                            render(prompt);
+                            m_Out << "\n";
+                            m_Out.flush();
+                            line = m_Line;
+                            return true;
+                        case KeyEvent::Key::Ctrl:
+                            if(!control(key.Codepoint)){
+                                m_Out << "\n";
+                                m_Out.flush();
+                                return false;
+                            }
+                            break;
+                        default:
+                            break;
+                    }
+                }
+            }
+            // Remember a line for Up/Down; blank lines and repeats are skipped
+            void add_history(std::string_view line){
+                if(line.find_first_not_of(" \t") == std::string_view::npos ||
+                   (!m_History.empty() && m_History.back() == line)){
+                    return;
+                }
+                if(m_History.size() >= m_Limit && !m_History.empty()){
+                    m_History.erase(m_History.begin());
+                }
+                m_History.emplace_back(line);
+            }
+            const std::vector<std::string>& history() const { return m_History; }
+        private:
+            Output& m_Out;
+            std::size_t m_Limit;
+            std::vector<std::string> m_History;
+            std::string m_Line;
+            std::size_t m_Cursor = 0; // Byte offset into m_Line
+            // Ctrl-key commands; false for end of input
+            bool control(char32_t key){
+                switch(key){
+                    case 'a': m_Cursor = 0; break;
+                    case 'e': m_Cursor = m_Line.size(); break;
+                    case 'b': m_Cursor = previous(m_Cursor); break;
+                    case 'f': m_Cursor = next(m_Cursor); break;
+                    case 'u': erase(0, m_Cursor); break;
+                    case 'k': erase(m_Cursor, m_Line.size()); break;
+                    case 'd':
+                        if(m_Line.empty()){
+                            return false;
+                        }
+                        erase(m_Cursor, next(m_Cursor));
+                        break;
+                    case 'w': {
+                        std::size_t from = m_Cursor;
+                        while(from > 0 && m_Line[from - 1] == ' '){
+                            --from;
+                        }
+                        while(from > 0 && m_Line[from - 1] != ' '){
+                            --from;
+                        }
+                        erase(from, m_Cursor);
+                        break;
+                    }
+                    case 'l':
+                        m_Out << "\033[H\033[J";
+                        break;
+                    default:
+                        break;
+                }
+                return true;
+            }
+            void insert(std::string_view text){
+                m_Line.insert(m_Cursor, text);
+                m_Cursor += text.size();
+            }
+            void erase(std::size_t from, std::size_t to){
+                m_Line.erase(from, to - from);
+                m_Cursor = from;
+            }
+            // Start of the character before/after a byte offset
+            std::size_t previous(std::size_t at) const {
+                while(at > 0 && (static_cast<unsigned char>(m_Line[--at]) & 0xc0) == 0x80){}
+                return at;
+            }
+            std::size_t next(std::size_t at) const {
+                if(at < m_Line.size()){
+                    ++at;
+                }
+                while(at < m_Line.size() && (static_cast<unsigned char>(m_Line[at]) & 0xc0) == 0x80){
+                    ++at;
+                }
+                return at;
+            }
+            // Redraw the prompt and the visible part of the line in one write
+            void render(std::string_view prompt){
+                std::size_t prompt_width = display_width(prompt);
+                std::size_t columns = terminal_size().Cols;
+                std::size_t room = columns > prompt_width + 1 ? columns - prompt_width - 1 : 1;
+                std::size_t cursor = display_width(std::string_view(m_Line).substr(0, m_Cursor));
+                // Scroll so the cursor stays on screen
+                std::size_t skip = cursor >= room ? cursor - room + 1 : 0;
+                std::size_t begin = 0;
+                for(std::size_t n = 0; n < skip; ++n){
+                    begin = next(begin);
+                }
+                std::size_t end = begin;
+                for(std::size_t n = 0; n < room && end < m_Line.size(); ++n){
+                    end = next(end);
+                }
+                Output::Frame frame(m_Out);
+                m_Out << "\r" << prompt << std::string_view(m_Line).substr(begin, end - begin) << "\033[K\r";
+                std::size_t column = prompt_width + cursor - skip;
+                if(column > 0){
+                    char number[24];
+                    auto result = std::to_chars(number, number + sizeof(number), column);
+                    m_Out << "\033[" << std::string_view(number, static_cast<std::size_t>(result.ptr - number)) << "C";
+                }
+            }
+    };
+} // namespace NCLI
+// --- LineEditor.h --- //
+
+// --- Config.h --- //
+namespace NCLI
+{
+    namespace CFG
+    {
+        inline static std::string promptChar = "> ";
+    } // namespace CFG
+} // namespace NCLI
+// --- Config.h --- //
+
+// --- Prompt.h --- //
+#ifdef _WIN32
+#include <conio.h>
+#else
+#include <termios.h>
+#include <unistd.h>
+#endif
+namespace NCLI
+{
+    inline static void cls()
+    {
+        std::cout << "\033[H\033[J"; // Clear the screen
+    }
+    inline static std::string prompt(const std::string &message)
+    {
+        std::string text = NCLI::Color::cyan(NCLI::CFG::promptChar) + NCLI::Color::bold(message) + ": ";
+        std::string input;
+        if (stdin_is_terminal())
+        {
+            LineEditor editor;
+            editor.read(text, input);
+        }
+        else
+        {
+            std::cout << text;
+            std::getline(std::cin, input);
+        }
+        return input;
+    }
+    // Platform independent function to capture a single key press. Inside a
+    // RawTerminalSession the key comes from the session's buffer; otherwise
+    // the terminal is switched to raw mode just for this key.
+    inline static char getch()
+    {
+        if (RawTerminalSession* session = RawTerminalSession::current())
+        {
+            return static_cast<char>(session->read_byte());
+        }
+        char ch;
+#ifdef _WIN32
+        ch = _getch();
+#else
+        struct termios old = {0};
+        if (tcgetattr(STDIN_FILENO, &old) < 0)
+            perror("tcsetattr()");
+        old.c_lflag &= ~ICANON; // Disable canonical mode
+        old.c_lflag &= ~ECHO;   // Disable echo
+        old.c_cc[VMIN] = 1;
+        old.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &old);
+        int c = getchar();
+        if (c == EOF)
+            clearerr(stdin); // Interrupted, e.g. by SIGWINCH
+        ch = static_cast<char>(c);
+        old.c_lflag |= ICANON; // Enable canonical mode
+        old.c_lflag |= ECHO;   // Enable echo
+        tcsetattr(STDIN_FILENO, TCSANOW, &old);
+#endif
+            return ch;
+    }
+    inline static void hide_cursor(){
+        std::cout << "\033[?25l";  // Hide the cursor
+    }
+    inline static void show_cursor(){
+        std::cout << "\033[?25h";  // Show the cursor
+    }
+    // Scrolling window over a list of rows, shared by the selection widgets.
+    // Only the rows in view are produced and drawn, and the window follows
+    // the terminal size.
+    class ListView {
+        public:
+            Viewport View;
+            ListView(Output& out, const std::string& message, std::size_t count)
+                : m_Screen(out), m_Message(message) {
+                View.Count = count;
+                layout();
+            }
+            // Fit the window to the terminal; everything is redrawn
+            void layout(){
+                TerminalSize size = terminal_size();
+                m_Width = size.Cols;
+                m_Height = size.Rows > 2 ? size.Rows - 2 : 1;
+                View.Height = m_Height;
+                View.follow();
+                m_Screen.clear();
+                m_Screen.resize(View.Height + 1);
+            }
+            // Show a different number of rows (e.g. after filtering), from the top
+            void reset(std::size_t count){
+                View.Count = count;
+                View.Height = m_Height;
+                View.Top = 0;
+                View.Selected = 0;
+                View.follow();
+                m_Screen.resize(View.Height + 1);
+            }
+            // Header line above the rows
+            void set_message(std::string message){
+                m_Message = std::move(message);
+            }
+            // Draw the rows in view; row(i, width) returns the text of item i
+            template<typename Row>
+            void present(Row&& row){
+                m_Screen.set(0, m_Message);
+                for(std::size_t r = 0; r < View.Height; ++r){
+                    m_Screen.set(r + 1, row(View.Top + r, m_Width));
+                }
+                m_Screen.present();
+            }
+        private:
+            FrameRenderer m_Screen;
+            std::string m_Message;
+            std::size_t m_Width = 80;
+            std::size_t m_Height = 1;
+    };
+    // Move the selection for the navigation keys shared by the list widgets;
+    // false if the key is not one of them
+    inline static bool navigate(Viewport& view, const KeyEvent& key){
+        if(view.Count == 0){
+            return key.Type == KeyEvent::Key::Up || key.Type == KeyEvent::Key::Down ||
+                   key.Type == KeyEvent::Key::PageUp || key.Type == KeyEvent::Key::PageDown ||
+                   key.Type == KeyEvent::Key::Home || key.Type == KeyEvent::Key::End;
+        }
+        switch(key.Type){
+            case KeyEvent::Key::Up: view.up(); return true;
+            case KeyEvent::Key::Down: view.down(); return true;
+            case KeyEvent::Key::PageUp: view.page_up(); return true;
+            case KeyEvent::Key::PageDown: view.page_down(); return true;
+            case KeyEvent::Key::Home: view.home(); return true;
+            case KeyEvent::Key::End: view.end(); return true;
+            default: return false;
+        }
+    }
+    // Type-to-filter for the selection widgets. Printable keys and pastes
+    // extend the query, Backspace shortens it and Escape clears it; the rows
+    // shown are the fuzzy matches, best first. A search is dropped as soon
+    // as interrupted() reports more input, so typing ahead never waits on a
+    // stale query.
+    class ListFilter {
+        public:
+            ListFilter(const std::vector<std::string>& options, std::function<bool()> interrupted = nullptr)
+                : m_Matcher(options), m_Interrupted(std::move(interrupted)) {}
+            // Apply a key to the query; true if it changed. The matches are
+            // brought up to date by search().
+            bool edit(const KeyEvent& key){
+                switch(key.Type){
+                    case KeyEvent::Key::Char:
+                        if(key.Codepoint == ' '){
+                            return false;
+                        }
+                        m_Query += key.Text;
+                        break;
+                    case KeyEvent::Key::Paste:
+                        for(char c : key.Text){
+                            if(static_cast<unsigned char>(c) > ' '){
+                                m_Query.push_back(c);
+                            }
+                        }
+                        break;
+                    case KeyEvent::Key::Backspace:
+                        if(m_Query.empty()){
+                            return false;
+                        }
+                        // Drop a whole UTF-8 character
+                        while(!m_Query.empty() && (static_cast<unsigned char>(m_Query.back()) & 0xc0) == 0x80){
+                            m_Query.pop_back();
+                        }
+                        if(!m_Query.empty()){
+                            m_Query.pop_back();
+                        }
+                        break;
+                    case KeyEvent::Key::Escape:
+                        if(m_Query.empty()){
+                            return false;
+                        }
+                        m_Query.clear();
+                        break;
+                    default:
+                        return false;
+                }
+                m_Pending = true;
+                return true;
+            }
+            // True if the matches lag behind the query
+            bool pending() const { return m_Pending; }
+            // Match the query; false if cut short by new input. With
+            // interruptible false, always runs to completion.
+            bool search(bool interruptible = true){
+                static const std::function<bool()> none;
+                m_Pending = !m_Matcher.update(m_Query, interruptible ? m_Interrupted : none);
+                return !m_Pending;
+            }
+            const std::string& query() const { return m_Query; }
+            std::size_t size() const { return m_Matcher.size(); }
+            // Option index shown at row pos
+            std::size_t at(std::size_t pos){ return m_Matcher.at(pos); }
+            // Header with the query appended
+            std::string message(const std::string& message) const {
+                return m_Query.empty() ? message : message + " " + NCLI::Color::cyan(m_Query);
+            }
+        private:
+            FuzzyMatcher m_Matcher;
+            std::function<bool()> m_Interrupted;
+            std::string m_Query;
+            bool m_Pending = false;
+    };
+    // Cut text to fit in width columns (counted in bytes)
+    inline static std::string fit(std::string text, std::size_t width){
+        if(text.size() > width){
+            text.resize(width);
+        }
+        return text;
+    }
+    // Single choice over count items fetched on demand with item(i). Memory and
+    // work per keypress depend on the terminal height, not on count.
+    // Returns the chosen index, or count if there is nothing to choose.
+    inline static std::size_t virtual_list(const std::string &message, std::size_t count, const std::function<std::string(std::size_t)> &item, Output& out = Output::standard())
+    {
+        if (count == 0)
+        {
+            return count;
+        }
+        RawTerminalSession session;
+        ResizeWatcher resize;
+        KeyReader keys(session);
+        KeyEvent key;
+        ListView list(out, message, count);
+        auto row = [&](std::size_t i, std::size_t width){
+            std::string text = fit(item(i), width > 3 ? width - 3 : 0);
+            return i == list.View.Selected ? "\033[1;32m> " + text + " \033[0m" // Green for the selected option
+                                           : "  " + text;
+        };
+        out.write("\033[?25l"); // Hide the cursor
+        while (true)
+        {
+            if (!keys.ready())
+            {
+                list.present(row);
+            }
+            bool got = keys.next(key);
+            if (resize.resized())
+            {
+                list.layout();
+            }
+            if (!got)
+            {
+                if (keys.eof())
+                {
+                    break; // Input closed; keep the current choice
+                }
+                continue;
+            }
+            if (navigate(list.View, key))
+            {
+                continue;
+            }
+            if (key.Type == KeyEvent::Key::Enter)
+            {
+                break;
+            }
+        }
+        out.write("\033[?25h"); // Show the cursor
+        out.flush();
+        return list.View.Selected;
+    }
+    // Single choice; typing filters the options
+    inline static std::string list(const std::string &message, const std::vector<std::string> &options, Output& out = Output::standard())
+    {
+        if (options.empty())
+        {
+            return std::string();
+        }
+        RawTerminalSession session;
+        ResizeWatcher resize;
+        KeyReader keys(session, true);
+        KeyEvent key;
+        ListFilter filter(options, [&session]{ return session.wait(0); });
+        ListView list(out, message, options.size());
+        auto row = [&](std::size_t pos, std::size_t width){
+            std::string text = fit(options[filter.at(pos)], width > 3 ? width - 3 : 0);
+            return pos == list.View.Selected ? "\033[1;32m> " + text + " \033[0m" // Green for the selected option
+                                             : "  " + text;
+        };
+        out.write("\033[?25l"); // Hide the cursor
+        while (true)
+        {
+            if (filter.pending())
+            {
+                filter.search();
+                list.set_message(filter.message(message));
+                list.reset(filter.size());
+            }
+            if (!keys.ready())
+            {
+                list.present(row);
+            }
+            bool got = keys.next(key);
+            if (resize.resized())
+            {
+                list.layout();
+            }
+            if (!got)
+            {
+                if (keys.eof())
+                {
+                    break; // Input closed; keep the current choice
+                }
+                continue;
+            }
+            if (navigate(list.View, key))
+            {
+                continue;
+            }
+            if (key.Type == KeyEvent::Key::Enter)
+            {
+                if (filter.pending())
+                {
+                    filter.search(false); // Choose from what the final query matches
+                    list.reset(filter.size());
+                }
+                if (list.View.Count > 0)
+                {
+                    break;
+                }
+            }
+            filter.edit(key);
+        }
+        out.write("\033[?25h"); // Show the cursor
+        out.flush();
+        return list.View.Count > 0 ? options[filter.at(list.View.Selected)] : std::string();
+    }
+    inline static std::set<std::string> checkbox(const std::string &message, const std::vector<std::string> &options, Output& out = Output::standard())
+    {
+        std::set<std::string> selected;
+        if (options.empty())
+        {
+            return selected;
+        }
+        std::string line;
+        RawTerminalSession session;
+        ResizeWatcher resize;
+        KeyReader keys(session, true);
+        KeyEvent key;
+        ListFilter filter(options, [&session]{ return session.wait(0); });
+        ListView list(out, message, options.size());
+        auto row = [&](std::size_t pos, std::size_t width){
+            std::size_t i = filter.at(pos);
+            line.clear();
+            StyledWriter styled(line);
+            std::string text = fit(options[i], width > 5 ? width - 5 : 0);
+            // Highlight selected region, green for the selected option
+            styled.write(pos == list.View.Selected ? "\033[1;32m> \033[0m" : " ");
+            if(selected.count(options[i])){
+                styled.write(Style::green(), "[x] ").write(Style::green(), text).finish();
+            } else {
+                styled.write("[ ] ").write(text);
+            }
+            return line;
+        };
+        out.write("\033[?25l"); // Hide the cursor
+        while (true)
+        {
+            if (filter.pending())
+            {
+                filter.search();
+                list.set_message(filter.message(message));
+                list.reset(filter.size());
+            }
+            if (!keys.ready())
+            {
+                list.present(row);
+            }
+            bool got = keys.next(key);
+            if (resize.resized())
+            {
+                list.layout();
+            }
+            if (!got)
+            {
+                if (keys.eof())
+                {
+                    break;
+                }
+                continue;
+            }
+            if (navigate(list.View, key))
+            {
+                continue;
+            }
+            if (key.Type == KeyEvent::Key::Char && key.Codepoint == ' ')
+            { // Space to toggle checkbox
+                if (list.View.Count == 0)
+                {
+                    continue;
+                }
+                const std::string& option = options[filter.at(list.View.Selected)];
+                if (selected.count(option))
+                {
+                    selected.erase(option); // Deselect
+                }
+                else
+                {
+                    selected.insert(option); // Select
+                }
+            }
+            else if (key.Type == KeyEvent::Key::Enter)
+            { // Enter to finalize selection
+                break;
+            }
+            filter.edit(key);
+        }
+        out.write("\033[?25h"); // Show the cursor
+        out.flush();
+        return selected;
+    }
+} // namespace NCLI
+// --- Prompt.h --- //
+
+// --- Index.h --- //
+namespace NCLI
+{
+    // FNV-1a, used to key the name indexes below
+    inline static constexpr std::uint32_t hash_name(std::string_view name){
+        std::uint32_t hash = 2166136261u;
+        for(char c : name){
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+    // Open-addressing (linear probing) index from a name to its position in a
+    // container. Names are interned back to back in one string table and each
+    // slot keeps the hash, position and place of its name, so a lookup reads
+    // the slot array and the table only, never the (much larger) items.
+    // Positions stay valid when the container reallocates.
+    class NameIndex {
+        public:
+            static constexpr std::uint32_t npos = UINT32_MAX;
+            bool insert(std::string_view name, std::uint32_t index){
+                if((m_Size + 1) * 4 > m_Slots.size() * 3){
+                    grow();
+                }
+                std::uint32_t hash = hash_name(name);
+                std::size_t mask = m_Slots.size() - 1;
+                for(std::size_t i = hash & mask;; i = (i + 1) & mask){
+                    Slot& slot = m_Slots[i];
+                    if(slot.Index == npos){
+                        slot = {hash, index, static_cast<std::uint32_t>(m_Names.size()), static_cast<std::uint32_t>(name.size())};
+                        m_Order.push_back({slot.Offset, index});
+                        m_Names.append(name);
+                        ++m_Size;
+                        return true;
+                    }
+                    // Keep the first registration, like the old linear scan did
+                    if(matches(slot, hash, name)){
+                        return false;
+                    }
+                }
+            }
+            std::uint32_t find(std::string_view name) const {
+                if(m_Size == 0){
+                    return npos;
+                }
+                std::uint32_t hash = hash_name(name);
+                std::size_t mask = m_Slots.size() - 1;
+                for(std::size_t i = hash & mask;; i = (i + 1) & mask){
+                    const Slot& slot = m_Slots[i];
+                    if(slot.Index == npos){
+                        return npos;
+                    }
+                    if(matches(slot, hash, name)){
+                        return slot.Index;
+                    }
+                }
+            }
+            // Call fn(name, position) for every name starting with prefix, in
+            // insertion order. One pass over the packed names, for completion.
+            template<typename Fn>
+            void each_prefixed(std::string_view prefix, Fn&& fn) const {
+                for(std::size_t i = 0; i < m_Order.size(); ++i){
+                    std::size_t begin = m_Order[i].Offset;
+                    std::size_t end = i + 1 < m_Order.size() ? m_Order[i + 1].Offset : m_Names.size();
+                    if(end - begin >= prefix.size() && std::char_traits<char>::compare(m_Names.data() + begin, prefix.data(), prefix.size()) == 0){
+                        fn(std::string_view(m_Names.data() + begin, end - begin), m_Order[i].Index);
+                    }
+                }
+            }
+            void clear(){
+                m_Slots.clear();
+                m_Order.clear();
+                m_Names.clear();
+                m_Size = 0;
+            }
+            std::size_t size() const { return m_Size; }
+        private:
+            struct Slot {
+                std::uint32_t Hash = 0;
+                std::uint32_t Index = npos;
+                std::uint32_t Offset = 0; // Name in m_Names
+                std::uint32_t Length = 0;
+            };
+            // Where each name starts in m_Names, in insertion order
+            struct Entry {
+                std::uint32_t Offset;
+                std::uint32_t Index;
+            };
+            std::vector<Slot> m_Slots;
+            std::vector<Entry> m_Order;
+            std::string m_Names;
+            std::size_t m_Size = 0;
+            bool matches(const Slot& slot, std::uint32_t hash, std::string_view name) const {
+                return slot.Hash == hash && slot.Length == name.size()
+                    && std::char_traits<char>::compare(m_Names.data() + slot.Offset, name.data(), name.size()) == 0;
+            }
+            void grow(){
+                std::vector<Slot> old;
+                old.swap(m_Slots);
+                m_Slots.resize(old.empty() ? 8 : old.size() * 2);
+                std::size_t mask = m_Slots.size() - 1;
+                for(const Slot& slot : old){
+                    if(slot.Index == npos){
+                        continue;
+                    }
+                    std::size_t i = slot.Hash & mask;
+                    while(m_Slots[i].Index != npos){
+                        i = (i + 1) & mask;
+                    }
+                    m_Slots[i] = slot;
+                }
+            }
+    };
+    // Build (or rebuild) an index over a vector of named items
+    template<typename T>
+    inline static void build_name_index(NameIndex& index, const std::vector<T>& items){
+        index.clear();
+        for(std::uint32_t i = 0; i < items.size(); ++i){
+            index.insert(items[i].Name, i);
+        }
+    }
+} // namespace NCLI
+// --- Index.h --- //
+
+// --- Tokenizer.h --- //
+namespace NCLI
+{
+    struct Token {
+        enum class Kind { Word, Flag, Option };
+        Kind Type = Kind::Word;
+        std::string_view Text; // Name without leading dashes, or the word itself
+        int Index = 0;         // Position in argv
+    };
+    // Splits argv into tokens without copying: every Text is a view into the
+    // original argv storage, so it stays valid for as long as argv does.
+    class Tokenizer {
+        public:
+            Tokenizer(int argc, char* const argv[], int start=1)
+                : m_Argc(argc), m_Argv(argv), m_Index(start) {}
+            bool next(Token& token){
+                if(m_Index >= m_Argc){
+                    return false;
+                }
+                std::string_view arg = m_Argv[m_Index];
+                token.Index = m_Index++;
+                if(arg.size() > 1 && arg[0] == '-' && arg[1] == '-'){
+                    token.Type = Token::Kind::Option;
+                    token.Text = arg.substr(2);
+                } else if(!arg.empty() && arg[0] == '-'){
+                    token.Type = Token::Kind::Flag;
+                    token.Text = arg.substr(1);
+                } else {
+                    token.Type = Token::Kind::Word;
+                    token.Text = arg;
+                }
+                return true;
+            }
+            // Consume the next argument if it is a value (does not start with
+            // '-'). With numeric set, a negative number such as -5 or -.5 is
+            // a value too, for options that take one.
+            bool next_value(std::string_view& value, bool numeric=false){
+                if(m_Index >= m_Argc){
+                    return false;
+                }
+                const char* arg = m_Argv[m_Index];
+                if(arg[0] == '-' && !(numeric && is_negative_number(arg))){
+                    return false;
+                }
+                value = arg;
+                ++m_Index;
+                return true;
+            }
+            int index() const { return m_Index; }
+        private:
+            int m_Argc;
+            char* const* m_Argv;
+            int m_Index;
+            // -<digit> or -.<digit>
+            static bool is_negative_number(const char* arg){
+                auto digit = [](char c){ return c >= '0' && c <= '9'; };
+                return arg[0] == '-' && (digit(arg[1]) || (arg[1] == '.' && digit(arg[2])));
+            }
+    };
+    // Split a command line into arguments with shell-style quoting: blanks
+    // separate words, '...' is literal, "..." honours \" \\ \$ and \`, and a
+    // backslash elsewhere escapes the next character. Words are written
+    // NUL-terminated into storage and argv points at them, after an empty
+    // program name and before a trailing nullptr, so argv.data() can go to
+    // Tokenizer or CLI::parse with argc = argv.size() - 1. Both buffers keep
+    // their capacity between calls. Returns false on an unterminated quote.
+    inline static bool split_line(std::string_view line, std::string& storage, std::vector<char*>& argv){
+        storage.clear();
+        argv.clear();
+        // Worst case is one NUL per input character, so pointers stay valid
+        storage.reserve(2 * line.size() + 1);
+        storage.push_back('\0');
+        argv.push_back(&storage[0]);
+        enum class Quote { None, Single, Double } quote = Quote::None;
+        bool in_word = false;
+        for(std::size_t i = 0; i < line.size(); ++i){
+            char c = line[i];
+            if(quote == Quote::Single){
+                if(c == '\''){
+                    quote = Quote::None;
+                } else {
+                    storage.push_back(c);
+                }
+                continue;
+            }
+            if(quote == Quote::Double){
+                if(c == '"'){
+                    quote = Quote::None;
+                } else if(c == '\\' && i + 1 < line.size() &&
+                          (line[i + 1] == '"' || line[i + 1] == '\\' || line[i + 1] == '$' || line[i + 1] == '`')){
+                    storage.push_back(line[++i]);
+                } else {
+                    storage.push_back(c);
+                }
+                continue;
+            }
+            if(c == ' ' || c == '\t' || c == '\n' || c == '\r'){
+                if(in_word){
+                    storage.push_back('\0');
+                    in_word = false;
+                }
+                continue;
+            }
+            if(!in_word){
+                argv.push_back(storage.data() + storage.size());
+                in_word = true;
+            }
+            if(c == '\''){
+                quote = Quote::Single;
+            } else if(c == '"'){
+                quote = Quote::Double;
+            } else if(c == '\\' && i + 1 < line.size()){
+                storage.push_back(line[++i]);
+            } else {
+                storage.push_back(c);
+            }
+        }
+        if(in_word){
+            storage.push_back('\0');
+        }
+        argv.push_back(nullptr);
+        return quote == Quote::None;
+    }
+} // namespace NCLI
+// --- Tokenizer.h --- //
+
+// --- Value.h --- //
+namespace NCLI
+{
+    enum class ValueType { String, Int, UInt, Double, Bool, Enum, Duration, UIntList };
+    // Converted value of a typed option, stored inline in the Option. Only
+    // UIntList owns memory, and its capacity is kept between parses.
+    struct TypedValue {
+        TypedValue() = default;
+        explicit TypedValue(std::pmr::memory_resource* resource) : List(resource) {}
+        union {
+            std::int64_t Int = 0; // Int, Enum
+            std::uint64_t UInt;
+            double Double;
+            bool Bool;
+            std::int64_t Nanos;   // Duration
+        };
+        std::pmr::vector<std::uint64_t> List;
+    };
+    // Outcome of converting one option value. On failure Column is the
+    // offset of the first offending character and Expected names the type.
+    struct ConvertResult {
+        bool Ok = true;
+        std::size_t Column = 0;
+        const char* Expected = nullptr;
+    };
+    inline static ConvertResult convert_failed(std::string_view text, const char* end, const char* expected){
+        return {false, static_cast<std::size_t>(end - text.data()), expected};
+    }
+    inline static ConvertResult convert_int(std::string_view text, std::int64_t min, std::int64_t max, std::int64_t& out){
+        const char* end = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(text.data(), end, out);
+        if(ec == std::errc::invalid_argument || ptr != end){
+            return convert_failed(text, ptr, "an integer");
+        }
+        if(ec != std::errc() || out < min || out > max){
+            return convert_failed(text, text.data(), "an integer in range");
+        }
+        return {};
+    }
+    inline static ConvertResult convert_uint(std::string_view text, std::uint64_t max, std::uint64_t& out){
+        const char* end = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(text.data(), end, out);
+        if(ec == std::errc::invalid_argument || ptr != end){
+            return convert_failed(text, ptr, "a non-negative integer");
+        }
+        if(ec != std::errc() || out > max){
+            return convert_failed(text, text.data(), "a non-negative integer in range");
+        }
+        return {};
+    }
+    inline static ConvertResult convert_double(std::string_view text, double& out){
+        const char* end = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(text.data(), end, out);
+        if(ec != std::errc() || ptr != end){
+            return convert_failed(text, ptr, "a number");
+        }
+        return {};
+    }
+    inline static ConvertResult convert_bool(std::string_view text, bool& out){
+        if(text == "true" || text == "yes" || text == "on" || text == "1"){
+            out = true;
+        } else if(text == "false" || text == "no" || text == "off" || text == "0"){
+            out = false;
+        } else {
+            return convert_failed(text, text.data(), "true or false");
+        }
+        return {};
+    }
+    // Accepts a number followed by a unit: ns, us, ms, s, m or h (e.g. 250ms, 1.5s)
+    inline static ConvertResult convert_duration(std::string_view text, std::int64_t& nanos){
+        const char* end = text.data() + text.size();
+        double count = 0;
+        auto [ptr, ec] = std::from_chars(text.data(), end, count);
+        if(ec != std::errc() || ptr == end){
+            return convert_failed(text, ptr, "a duration such as 250ms or 2s");
+        }
+        std::string_view unit(ptr, static_cast<std::size_t>(end - ptr));
+        double scale = 0;
+        if(unit == "ns") scale = 1;
+        else if(unit == "us") scale = 1e3;
+        else if(unit == "ms") scale = 1e6;
+        else if(unit == "s") scale = 1e9;
+        else if(unit == "m") scale = 60e9;
+        else if(unit == "h") scale = 3600e9;
+        else return convert_failed(text, ptr, "a duration unit (ns, us, ms, s, m, h)");
+        // Must fit in int64 nanoseconds (about 292 years); NaN and infinity fail too
+        constexpr double limit = 9223372036854775808.0; // 2^63
+        double scaled = count * scale;
+        if(!(scaled >= -limit && scaled < limit)){
+            return convert_failed(text, text.data(), "a duration in range");
+        }
+        nanos = static_cast<std::int64_t>(scaled);
+        return {};
+    }
+    template<typename T>
+    struct is_duration : std::false_type {};
+    template<typename Rep, typename Period>
+    struct is_duration<std::chrono::duration<Rep, Period>> : std::true_type {};
+    template<typename T>
+    struct is_uint_list : std::false_type {};
+    template<typename T>
+    struct is_uint_list<std::vector<T>> : std::bool_constant<std::is_integral_v<T> && std::is_unsigned_v<T>> {};
+    // Maps an option<T> type to the storage it is converted into
+    template<typename T>
+    constexpr ValueType value_type_of(){
+        if constexpr (std::is_same_v<T, bool>) return ValueType::Bool;
+        else if constexpr (std::is_enum_v<T>) return ValueType::Enum;
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) return ValueType::Int;
+        else if constexpr (std::is_integral_v<T>) return ValueType::UInt;
+        else if constexpr (std::is_floating_point_v<T>) return ValueType::Double;
+        else if constexpr (is_duration<T>::value) return ValueType::Duration;
+        else if constexpr (is_uint_list<T>::value) return ValueType::UIntList;
+        else {
+            static_assert(std::is_convertible_v<T, std::string_view>, "NCLI: unsupported option type");
+            return ValueType::String;
+        }
+    }
+} // namespace NCLI
+// --- Value.h --- //
+
+// --- Async.h --- //
+// Coroutine actions need C++20 and a POSIX poll()
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32)
+#define NCLI_ASYNC 1
+#endif
+#ifdef NCLI_ASYNC
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <coroutine>
+#include <csignal>
+#include <exception>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+namespace NCLI
+{
+    // Thrown from a co_await once the event loop is cancelled (e.g. by Ctrl-C)
+    class CancelledError : public std::runtime_error {
+        public:
+            CancelledError() : std::runtime_error("Cancelled") {}
+    };
+#ifdef NCLI_ASYNC
+    class EventLoop;
+    template<typename T>
+    struct TaskResult {
+        std::optional<T> Value;
+        template<typename U>
+        void return_value(U&& value){ Value.emplace(std::forward<U>(value)); }
+        T take(){ return std::move(*Value); }
+    };
+    template<>
+    struct TaskResult<void> {
+        void return_void(){}
+        void take(){}
+    };
+    // Lazily started coroutine producing a T. co_await it from another task,
+    // or hand it to EventLoop::run() or EventLoop::spawn().
+    template<typename T = void>
+    class Task {
+        public:
+            struct promise_type : TaskResult<T> {
+                std::coroutine_handle<> Continuation;
+                std::exception_ptr Error;
+                Task get_return_object(){ return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+                std::suspend_always initial_suspend() noexcept { return {}; }
+                // Resume whoever awaited this task, or return to the event loop
+                auto final_suspend() noexcept {
+                    struct Resume {
+                        bool await_ready() noexcept { return false; }
+                        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> done) noexcept {
+                            std::coroutine_handle<> next = done.promise().Continuation;
+                            return next ? next : std::noop_coroutine();
+                        }
+                        void await_resume() noexcept {}
+                    };
+                    return Resume{};
+                }
+                void unhandled_exception(){ Error = std::current_exception(); }
+            };
+            Task(Task&& other) noexcept : m_Handle(std::exchange(other.m_Handle, nullptr)) {}
+            Task& operator=(Task&& other) noexcept {
+                if(this != &other){
+                    if(m_Handle){
+                        m_Handle.destroy();
+                    }
+                    m_Handle = std::exchange(other.m_Handle, nullptr);
+                }
+                return *this;
+            }
+            Task(const Task&) = delete;
+            Task& operator=(const Task&) = delete;
+            ~Task(){
+                if(m_Handle){
+                    m_Handle.destroy();
+                }
+            }
+            bool done() const { return !m_Handle || m_Handle.done(); }
+            // Value of a finished task; rethrows what it threw
+            T result(){
+                if(m_Handle.promise().Error){
+                    std::rethrow_exception(m_Handle.promise().Error);
+                }
+                return m_Handle.promise().take();
+            }
+            // Awaiting a task starts it and resumes the awaiter once it is done
+            bool await_ready() const { return done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter){
+                m_Handle.promise().Continuation = awaiter;
+                return m_Handle;
+            }
+            T await_resume(){ return result(); }
+        private:
+            friend class EventLoop;
+            std::coroutine_handle<promise_type> m_Handle;
+            explicit Task(std::coroutine_handle<promise_type> handle) : m_Handle(handle) {}
+            void start(){ m_Handle.resume(); }
+    };
+    // Single-threaded event loop for coroutine actions: tasks wait on timers
+    // and file descriptors and everything runs on the calling thread, so a
+    // progress display can animate while an action waits. While run() is
+    // active, Ctrl-C cancels the loop: every pending co_await throws
+    // CancelledError. A second Ctrl-C interrupts the process as usual.
+    class EventLoop {
+        public:
+            EventLoop(){
+                if(::pipe(m_Wake) != 0){
+                    throw std::system_error(errno, std::generic_category(), "NCLI: pipe");
+                }
+                for(int fd : m_Wake){
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    fcntl(fd, F_SETFD, FD_CLOEXEC);
+                }
+            }
+            ~EventLoop(){
+                ::close(m_Wake[0]);
+                ::close(m_Wake[1]);
+            }
+            EventLoop(const EventLoop&) = delete;
+            EventLoop& operator=(const EventLoop&) = delete;
+            // Loop running on this thread, or nullptr
+            static EventLoop* current(){ return s_Current; }
+            // Run task to completion and return its result. Tasks spawned
+            // meanwhile are dropped once it is done.
+            template<typename T>
+            T run(Task<T> task){
+                Scope scope(*this);
+                task.start();
+                while(!task.done()){
+                    step();
+                }
+                return task.result();
+            }
+            // Run task alongside the others, e.g. a progress display. Its
+            // result is dropped; exceptions other than CancelledError come
+            // out of run().
+            void spawn(Task<void> task){
+                m_Spawned.push_back(std::move(task));
+                m_Spawned.back().start();
+                reap();
+            }
+            // Wake every waiting task with CancelledError
+            void cancel(){
+                m_Cancelled = true;
+                for(const Timer& timer : m_Timers){
+                    m_Ready.push_back(timer.Handle);
+                }
+                for(const Waiter& waiter : m_Waiters){
+                    m_Ready.push_back(waiter.Handle);
+                }
+                m_Timers.clear();
+                m_Waiters.clear();
+            }
+            bool cancelled() const { return m_Cancelled; }
+            // co_await loop.sleep(250ms)
+            auto sleep(std::chrono::steady_clock::duration duration){
+                return TimerAwait{*this, std::chrono::steady_clock::now() + duration};
+            }
+            // co_await loop.readable(fd): until fd can be read without blocking
+            auto readable(int fd){ return IoAwait{*this, fd, POLLIN}; }
+            auto writable(int fd){ return IoAwait{*this, fd, POLLOUT}; }
+        private:
+            struct Timer {
+                std::chrono::steady_clock::time_point Deadline;
+                std::uint64_t Sequence; // Keeps timers with the same deadline in order
+                std::coroutine_handle<> Handle;
+            };
+            struct Waiter {
+                int Fd;
+                short Events;
+                std::coroutine_handle<> Handle;
+            };
+            int m_Wake[2] = {-1, -1}; // Self-pipe the signal handler writes to
+            bool m_Cancelled = false;
+            std::uint64_t m_Sequence = 0;
+            std::vector<Timer> m_Timers; // Min-heap on Deadline
+            std::vector<Waiter> m_Waiters;
+            std::vector<std::coroutine_handle<>> m_Ready;
+            std::vector<std::coroutine_handle<>> m_Due;
+            std::vector<pollfd> m_Polls;
+            std::vector<Task<void>> m_Spawned;
+            inline static thread_local EventLoop* s_Current = nullptr;
+            inline static std::atomic<int> s_WakeFd{-1}; // Write end of the loop owning SIGINT
+            inline static volatile std::sig_atomic_t s_Interrupted = 0;
+            struct TimerAwait {
+                EventLoop& Loop;
+                std::chrono::steady_clock::time_point Deadline;
+                bool await_ready() const { return Loop.m_Cancelled; }
+                void await_suspend(std::coroutine_handle<> handle){
+                    Loop.m_Timers.push_back(Timer{Deadline, Loop.m_Sequence++, handle});
+                    std::push_heap(Loop.m_Timers.begin(), Loop.m_Timers.end(), later);
+                }
+                void await_resume() const {
+                    if(Loop.m_Cancelled){
+                        throw CancelledError();
+                    }
+                }
+            };
+            struct IoAwait {
+                EventLoop& Loop;
+                int Fd;
+                short Events;
+                bool await_ready() const { return Loop.m_Cancelled; }
+                void await_suspend(std::coroutine_handle<> handle){
+                    Loop.m_Waiters.push_back(Waiter{Fd, Events, handle});
+                }
+                void await_resume() const {
+                    if(Loop.m_Cancelled){
+                        throw CancelledError();
+                    }
+                }
+            };
+            // Makes the loop current and takes SIGINT (unless another loop
+            // has it) for the duration of run()
+            class Scope {
+                public:
+                    explicit Scope(EventLoop& loop) : m_Loop(loop), m_Outer(s_Current) {
+                        s_Current = &loop;
+                        int free = -1;
+                        m_Signal = s_WakeFd.compare_exchange_strong(free, loop.m_Wake[1]);
+                        if(m_Signal){
+                            s_Interrupted = 0;
+                            struct sigaction action = {};
+                            action.sa_handler = &EventLoop::on_interrupt;
+                            sigemptyset(&action.sa_mask);
+                            sigaction(SIGINT, &action, &m_Previous);
+                        }
+                    }
+                    ~Scope(){
+                        if(m_Signal){
+                            sigaction(SIGINT, &m_Previous, nullptr);
+                            s_WakeFd = -1;
+                        }
+                        // Whatever still waits belongs to dropped tasks
+                        m_Loop.m_Spawned.clear();
+                        m_Loop.m_Timers.clear();
+                        m_Loop.m_Waiters.clear();
+                        m_Loop.m_Ready.clear();
+                        s_Current = m_Outer;
+                    }
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+                private:
+                    EventLoop& m_Loop;
+                    EventLoop* m_Outer;
+                    bool m_Signal = false;
+                    struct sigaction m_Previous = {};
+            };
+            static bool later(const Timer& a, const Timer& b){
+                return a.Deadline != b.Deadline ? a.Deadline > b.Deadline : a.Sequence > b.Sequence;
+            }
+            static void on_interrupt(int sig){
+                if(s_Interrupted){
+                    signal(sig, SIG_DFL);
+                    raise(sig);
+                    return;
+                }
+                s_Interrupted = 1;
+                char byte = 1;
+                ssize_t ignored = ::write(s_WakeFd.load(), &byte, 1);
+                (void)ignored;
+            }
+            // Wait for the next timer, descriptor or signal and resume what it woke
+            void step(){
+                if(m_Ready.empty()){
+                    if(m_Timers.empty() && m_Waiters.empty()){
+                        throw std::logic_error("NCLI: task is waiting on something outside the event loop");
+                    }
+                    int timeout = -1;
+                    if(!m_Timers.empty()){
+                        auto wait = std::chrono::ceil<std::chrono::milliseconds>(m_Timers.front().Deadline - std::chrono::steady_clock::now()).count();
+                        timeout = static_cast<int>(std::clamp<decltype(wait)>(wait, 0, INT_MAX));
+                    }
+                    m_Polls.clear();
+                    m_Polls.push_back(pollfd{m_Wake[0], POLLIN, 0});
+                    for(const Waiter& waiter : m_Waiters){
+                        m_Polls.push_back(pollfd{waiter.Fd, waiter.Events, 0});
+                    }
+                    if(::poll(m_Polls.data(), static_cast<nfds_t>(m_Polls.size()), timeout) < 0 && errno != EINTR){
+                        throw std::system_error(errno, std::generic_category(), "NCLI: poll");
+                    }
+                    if(m_Polls[0].revents != 0){
+                        char buffer[64];
+                        while(::read(m_Wake[0], buffer, sizeof(buffer)) > 0){}
+                        if(s_Interrupted){
+                            cancel();
+                        }
+                    }
+                    // Descriptors are matched by position, so collect before resuming anything
+                    std::size_t kept = 0;
+                    for(std::size_t i = 0; i < m_Waiters.size(); ++i){
+                        if(m_Polls.size() > i + 1 && m_Polls[i + 1].revents != 0){
+                            m_Ready.push_back(m_Waiters[i].Handle);
+                        } else {
+                            m_Waiters[kept++] = m_Waiters[i];
+                        }
+                    }
+                    m_Waiters.resize(kept);
+                    auto now = std::chrono::steady_clock::now();
+                    while(!m_Timers.empty() && m_Timers.front().Deadline <= now){
+                        std::pop_heap(m_Timers.begin(), m_Timers.end(), later);
+                        m_Ready.push_back(m_Timers.back().Handle);
+                        m_Timers.pop_back();
+                    }
+                }
+                m_Due.swap(m_Ready);
+                m_Ready.clear();
+                for(std::coroutine_handle<> handle : m_Due){
+                    handle.resume();
+                }
+                m_Due.clear();
+                reap();
+            }
+            // Drop finished spawned tasks
+            void reap(){
+                for(std::size_t i = 0; i < m_Spawned.size();){
+                    if(!m_Spawned[i].done()){
+                        ++i;
+                        continue;
+                    }
+                    Task<void> task = std::move(m_Spawned[i]);
+                    m_Spawned.erase(m_Spawned.begin() + static_cast<std::ptrdiff_t>(i));
+                    try {
+                        task.result();
+                    } catch(const CancelledError&){
+                    }
+                }
+            }
+    };
+    inline static EventLoop& current_loop(){
+        EventLoop* loop = EventLoop::current();
+        if(loop == nullptr){
+            throw std::logic_error("NCLI: no event loop is running on this thread");
+        }
+        return *loop;
+    }
+    // Awaitables on the loop running the current action
+    inline static auto sleep_for(std::chrono::steady_clock::duration duration){ return current_loop().sleep(duration); }
+    inline static auto readable(int fd){ return current_loop().readable(fd); }
+    inline static auto writable(int fd){ return current_loop().writable(fd); }
+    inline static Task<void> spin(std::string label, std::shared_ptr<bool> done){
+        static constexpr const char* Frames[] = {"|", "/", "-", "\\"};
+        for(std::size_t frame = 0; !*done; ++frame){
+            Output& out = Output::standard();
+            out << "\r" << Frames[frame % 4] << " " << label << "\033[K";
+            out.flush();
+            co_await sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    // Await task with a spinner and label animating on stdout meanwhile
+    template<typename T>
+    Task<T> with_spinner(std::string label, Task<T> task){
+        if(!isatty(STDOUT_FILENO)){
+            co_return co_await std::move(task);
+        }
+        auto done = std::make_shared<bool>(false);
+        current_loop().spawn(spin(std::move(label), done));
+        // Clear the line however the task ends
+        struct Stop {
+            std::shared_ptr<bool> Done;
+            ~Stop(){
+                *Done = true;
+                Output& out = Output::standard();
+                out << "\r\033[K";
+                out.flush();
+            }
+        } stop{done};
+        co_return co_await std::move(task);
+    }
+#endif
+} // namespace NCLI
+// --- Async.h --- //
+
+// --- Command.h --- //
+namespace NCLI
+{
+    struct Flag{
+        std::string Name;
+        std::string Help;
+        bool FlagSet=false;
+        Flag() = default;
+        Flag(const std::string& name)
+            : Name(name){}
+        Flag(const std::string& name, const std::string& help)
+            : Name(name), Help(help) {}
+        Flag(const std::string& name, const std::string& help, bool set)
+            : Name(name), Help(help), FlagSet(set){}
+    };
+    // Values given to an option. The first few are stored inline, so a typical
+    // command line never allocates; longer lists spill into a vector.
+    class ValueList {
+        public:
+            static constexpr std::size_t InlineCapacity = 4;
+            ValueList() = default;
+            explicit ValueList(std::pmr::memory_resource* resource) : m_Spill(resource) {}
+            void push_back(std::string_view value){
+                if(m_Size < InlineCapacity){
+                    m_Inline[m_Size] = value;
+                } else {
+                    if(m_Size == InlineCapacity){
+                        m_Spill.assign(m_Inline.begin(), m_Inline.end());
+                    }
+                    m_Spill.push_back(value);
+                }
+                ++m_Size;
+            }
+            // Keeps any spilled capacity for reuse
+            void clear(){
+                m_Spill.clear();
+                m_Size = 0;
+            }
+            const std::string_view* begin() const { return m_Size > InlineCapacity ? m_Spill.data() : m_Inline.data(); }
+            const std::string_view* end() const { return begin() + m_Size; }
+            std::size_t size() const { return m_Size; }
+            bool empty() const { return m_Size == 0; }
+            std::string_view front() const { return *begin(); }
+            std::string_view operator[](std::size_t i) const { return begin()[i]; }
+        private:
+            std::array<std::string_view, InlineCapacity> m_Inline{};
+            std::pmr::vector<std::string_view> m_Spill;
+            std::size_t m_Size = 0;
+    };
+    // What one parse gave an option, kept outside the Option itself (see
+    // ParseResult). Clearing keeps the allocated capacity. Allocator-aware,
+    // so the value lists share the memory resource of the ParseResult.
+    struct OptionValue {
+        using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+        std::string_view Value;
+        ValueList Values;
+        bool Set=false;
+        TypedValue Typed;
+        OptionValue() = default;
+        explicit OptionValue(const allocator_type& alloc)
+            : Values(alloc.resource()), Typed(alloc.resource()) {}
+        OptionValue(const OptionValue& other, const allocator_type& alloc)
+            : OptionValue(alloc) { *this = other; }
+        OptionValue(OptionValue&& other, const allocator_type& alloc)
+            : OptionValue(alloc) { *this = std::move(other); }
+        OptionValue(const OptionValue&) = default;
+        OptionValue(OptionValue&&) = default;
+        OptionValue& operator=(const OptionValue&) = default;
+        OptionValue& operator=(OptionValue&&) = default;
+        void clear(){
+            Value = {};
+            Values.clear();
+            Set = false;
+            Typed.Int = 0;
+            Typed.List.clear();
+        }
+    };
+    // Values to offer for an option in shell completion, given the word typed
+    // so far; candidates that do not start with it are dropped afterwards
+    using OptionCompleter = std::function<std::vector<std::string>(std::string_view prefix)>;
+    // Value and Values are views into argv (or the CLI's owned copy of it, see
+    // CLI::own_arguments) or into Default. The default given at registration
+    // is copied and owned by the option.
+    struct Option{
+        std::string Name;
+        std::string Help;
+        std::string_view Value;
+        std::string_view Default; // Value before anything is parsed
+        ValueList Values;
+        bool Set=false;
+        // Typed options (Command::option<T>) are converted once while parsing
+        ValueType Type = ValueType::String;
+        TypedValue Typed;
+        std::int64_t Min = std::numeric_limits<std::int64_t>::min(); // Accepted range for Int/UInt
+        std::uint64_t Max = std::numeric_limits<std::uint64_t>::max();
+        std::vector<std::pair<std::string, std::int64_t>> Choices; // Names accepted by Enum options
+        OptionCompleter Complete; // Values offered in shell completion, besides Choices
+        Option() = default;
+        Option(const std::string& name)
+            : Name(name){}
+        Option(const std::string& name, const std::string& help)
+            : Name(name), Help(help){}
+        Option(const std::string& name, const std::string& help, bool set)
+            : Name(name), Help(help), Set(set){}
+        Option(const std::string& name, const std::string& help, std::string_view default_value)
+            : Name(name), Help(help) { own_default(default_value); }
+        Option(const std::string& name, const std::string& help, std::string_view default_value, bool set)
+            : Name(name), Help(help), Set(set) { own_default(default_value); }
+        // Back to the unparsed state; allocated capacity is kept
+        void reset(){
+            Value = Default;
+            Values.clear();
+            Set = false;
+            Typed.Int = 0;
+            Typed.List.clear();
+        }
+        // Int, Double and Duration values may be negative, so -5 is a value
+        // of this option rather than a flag
+        bool takes_negative() const {
+            return Type == ValueType::Int || Type == ValueType::Double || Type == ValueType::Duration;
+        }
+        // Convert text into Typed according to Type
+        ConvertResult convert(std::string_view text){
+            return convert(text, Typed);
+        }
+        // Convert text into out according to Type
+        ConvertResult convert(std::string_view text, TypedValue& out) const {
+            switch(Type){
+                case ValueType::String:
+                    return {};
+                case ValueType::Int:
+                    return convert_int(text, Min, static_cast<std::int64_t>(Max), out.Int);
+                case ValueType::UInt:
+                    return convert_uint(text, Max, out.UInt);
+                case ValueType::Double:
+                    return convert_double(text, out.Double);
+                case ValueType::Bool:
+                    return convert_bool(text, out.Bool);
+                case ValueType::Duration:
+                    return convert_duration(text, out.Nanos);
+                case ValueType::Enum:
+                    for(const auto& choice : Choices){
+                        if(choice.first == text){
+                            out.Int = choice.second;
+                            return {};
+                        }
+                    }
+                    return convert_failed(text, text.data(), "one of the listed choices");
+                case ValueType::UIntList: {
+                    // Accepts both --ids 1 2 3 and --ids 1,2,3
+                    std::size_t begin = 0;
+                    while(true){
+                        std::size_t end = text.find(',', begin);
+                        std::string_view item = text.substr(begin, end == std::string_view::npos ? end : end - begin);
+                        std::uint64_t id = 0;
+                        ConvertResult result = convert_uint(item, Max, id);
+                        if(!result.Ok){
+                            result.Column += begin;
+                            return result;
+                        }
+                        out.List.push_back(id);
+                        if(end == std::string_view::npos){
+                            return {};
+                        }
+                        begin = end + 1;
+                    }
+                }
+            }
+            return {};
+        }
+        // Converted value; T must match the type the option was declared with
+        template<typename T>
+        T get() const {
+            return get<T>(Value, Typed);
+        }
+        // Same for a value parsed into an OptionValue
+        template<typename T>
+        T get(std::string_view value, const TypedValue& typed) const {
+            constexpr ValueType type = value_type_of<T>();
+            if(type != Type){
+                throw std::logic_error("NCLI: option --" + Name + " was declared with a different type");
+            }
+            if constexpr (type == ValueType::String) return T(value);
+            else if constexpr (type == ValueType::Int || type == ValueType::Enum) return static_cast<T>(typed.Int);
+            else if constexpr (type == ValueType::UInt) return static_cast<T>(typed.UInt);
+            else if constexpr (type == ValueType::Double) return static_cast<T>(typed.Double);
+            else if constexpr (type == ValueType::Bool) return typed.Bool;
+            else if constexpr (type == ValueType::Duration) return std::chrono::duration_cast<T>(std::chrono::nanoseconds(typed.Nanos));
+            else return T(typed.List.begin(), typed.List.end());
+        }
+        // Record a value from the command line in state: the first replaces
+        // the default, later ones are appended. Typed options convert the
+        // first value (every value for lists).
+        ConvertResult add_value(OptionValue& state, std::string_view value) const {
+            bool first = !state.Set;
+            if(first){
+                state.Value = value;
+                state.Set = true;
+            }
+            state.Values.push_back(value);
+            if(first || Type == ValueType::UIntList){
+                return convert(value, state.Typed);
+            }
+            return {};
+        }
+    private:
+        // Storage behind Default, shared by copies so views into it stay valid
+        std::shared_ptr<const std::string> m_DefaultText;
+        void own_default(std::string_view text){
+            m_DefaultText = std::make_shared<const std::string>(text);
+            Default = *m_DefaultText;
+            Value = Default;
+        }
+    };
+    struct Command;
+    class ParseResult;
+    // Read-only view of a parsed command handed to actions. Nothing is copied;
+    // lookups go through the command's (and the CLI's global) name indexes,
+    // or into a ParseResult when the command line was parsed into one.
+    class ParsedArgs {
+        public:
+            ParsedArgs(const Command& command, const Command* global=nullptr)
+                : m_Command(command), m_Global(global) {}
+            explicit ParsedArgs(const ParseResult& result);
+            const Command& command() const { return m_Command; }
+            // True if the flag was given on the command line
+            bool flag(std::string_view name) const;
+            // The option if it was given on the command line, otherwise nullptr.
+            // For a ParseResult this is the definition only: read what was given
+            // through value(), values(), get() and list().
+            const Option* option(std::string_view name) const;
+            // First value of the option, its default, or fallback
+            std::string_view value(std::string_view name, std::string_view fallback="") const;
+            // Every value given to the option (empty if it was not given)
+            const ValueList& values(std::string_view name) const;
+            // Converted value of a typed option, or fallback if it was not given
+            template<typename T>
+            T get(std::string_view name, T fallback=T()) const;
+            // Converted values of an option<std::vector<...>>, without copying
+            const std::pmr::vector<std::uint64_t>& list(std::string_view name) const;
+        private:
+            const Command& m_Command;
+            const Command* m_Global;
+            const ParseResult* m_Result = nullptr;
+            const Flag* find_flag(std::string_view name) const;
+            const Option* find_option(std::string_view name) const;
+    };
+    using ActionFunc = std::function<bool(const ParsedArgs& args)>;
+    // Original action signature, still accepted by Command::action
+    using CommandFunc = std::function<bool(const std::vector<Flag> flags, const std::vector<Option> options)>;
+    struct Command {
+        std::string Name;
+        std::string Help;
+        ActionFunc Function;
+        std::vector<Flag> Flags;
+        std::vector<Option> Options;
+        bool ParallelSafe = false; // See parallel_safe()
+        Command() = default;
+        Command(const std::string& name)
+            : Name(name){}
+        Command(const std::string& name, const std::string& help)
+            : Name(name), Help(help) {}
+        Command(const std::string& name, const std::string& help, CommandFunc func)
+            : Name(name), Help(help), Function(adapt(func)) {}
+        Command(const std::string& name, const std::string& help, CommandFunc func, std::vector<Flag> flags)
+            : Name(name), Help(help), Function(adapt(func)), Flags(flags) { reindex(); }
+        Command(const std::string& name, const std::string& help, CommandFunc func, std::vector<Flag> flags, std::vector<Option> options)
+            : Name(name), Help(help), Function(adapt(func)), Flags(flags), Options(options) { reindex(); }
+        
+        Command& add_flag(const std::string& flag_name, const std::string& help=""){
+            NCLI_TRACE_SCOPE(Register, "add_flag");
+            Flags.emplace_back(flag_name, help, false);
+            m_FlagIndex.insert(Flags.back().Name, Flags.size() - 1);
+            return *this;
+        }
+        Command& add_option(const std::string& option_name, const std::string& help=""){
+            NCLI_TRACE_SCOPE(Register, "add_option");
+            Options.emplace_back(option_name, help, false);
+            m_OptionIndex.insert(Options.back().Name, Options.size() - 1);
+            return *this;
+        }
+        Command& option(const std::string& name, const std::string& help=""){
+            return add_option(name, help);
+        }
+        Command& flag(const std::string& name, const std::string& help=""){
+            return add_flag(name, help);
+        }
+        // Typed option: values are converted to T while parsing, and errors
+        // are reported with their position (e.g. option<int>, option<double>,
+        // option<std::chrono::milliseconds>, option<std::vector<uint64_t>>)
+        template<typename T>
+        Command& option(const std::string& name, const std::string& help=""){
+            add_option(name, help);
+            Option& option = Options.back();
+            option.Type = value_type_of<T>();
+            if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>){
+                option.Min = static_cast<std::int64_t>(std::numeric_limits<T>::min());
+                option.Max = static_cast<std::uint64_t>(std::numeric_limits<T>::max());
+            } else if constexpr (is_uint_list<T>::value){
+                option.Max = static_cast<std::uint64_t>(std::numeric_limits<typename T::value_type>::max());
+            }
+            return *this;
+        }
+        // Enum option accepting the given names
+        template<typename T>
+        Command& option(const std::string& name, const std::string& help, std::initializer_list<std::pair<std::string_view, T>> choices){
+            static_assert(std::is_enum_v<T>, "NCLI: choices are only supported for enum options");
+            option<T>(name, help);
+            for(const auto& choice : choices){
+                Options.back().Choices.emplace_back(std::string(choice.first), static_cast<std::int64_t>(choice.second));
+            }
+            return *this;
+        }
+        // Values offered for an option in shell completion (see
+        // CLI::complete); only called when that option's value is completed
+        Command& completer(const std::string& name, OptionCompleter complete){
+            if(Option* option = find_option(name)){
+                option->Complete = std::move(complete);
+            }
+            return *this;
+        }
+        // Accepts bool(const ParsedArgs&), or the original bool(flags, options)
+        template<typename Func>
+        Command& action(Func&& action){
+            if constexpr (std::is_invocable_r_v<bool, Func&, const ParsedArgs&>){
+                Function = std::forward<Func>(action);
+            } else {
+                Function = adapt(CommandFunc(std::forward<Func>(action)));
+            }
+            return *this;
+        }
+#ifdef NCLI_ASYNC
+        // Coroutine action, Task<bool>(const ParsedArgs&), run to completion
+        // on an EventLoop of its own: it can co_await sleep_for(), readable(),
+        // writable() and other tasks, and Ctrl-C cancels it (CancelledError)
+        template<typename Func>
+        Command& action_async(Func&& action){
+            Function = [action = std::forward<Func>(action)](const ParsedArgs& args){
+                EventLoop loop;
+                return loop.run(Task<bool>(action(args)));
+            };
+            return *this;
+        }
+#endif
+        // The action may run alongside other lines of a parallel batch
+        // (CLI::run_script_parallel): it only touches thread-safe state and
+        // prints through Output::standard(), which is collected per line
+        Command& parallel_safe(bool safe=true){
+            ParallelSafe = safe;
+            return *this;
+        }
+        // Wraps an original-style action, copying the set flags and options
+        // into the vectors it expects
+        static ActionFunc adapt(CommandFunc func){
+            if(!func){
+                return nullptr;
+            }
+            return [func](const ParsedArgs& args){
+                std::vector<Flag> flags;
+                for(const auto& flag : args.command().Flags){
+                    if(args.flag(flag.Name)){
+                        flags.push_back(flag);
+                        flags.back().FlagSet = true;
+                    }
+                }
+                // Starts with an empty Option, as the original signature always did
+                std::vector<Option> options = { Option{} };
+                for(const auto& opt : args.command().Options){
+                    if(args.option(opt.Name) != nullptr){
+                        options.push_back(opt);
+                        Option& copy = options.back();
+                        copy.reset();
+                        for(std::string_view value : args.values(opt.Name)){
+                            add_value(copy, value);
+                        }
+                    }
+                }
+                return func(flags, options);
+            };
+        }
+        Flag* find_flag(std::string_view name){
+            std::uint32_t at = m_FlagIndex.find(name);
+            return at != NameIndex::npos ? &Flags[at] : nullptr;
+        }
+        const Flag* find_flag(std::string_view name) const {
+            std::uint32_t at = m_FlagIndex.find(name);
+            return at != NameIndex::npos ? &Flags[at] : nullptr;
+        }
+        Option* find_option(std::string_view name){
+            std::uint32_t at = m_OptionIndex.find(name);
+            return at != NameIndex::npos ? &Options[at] : nullptr;
+        }
+        const Option* find_option(std::string_view name) const {
+            std::uint32_t at = m_OptionIndex.find(name);
+            return at != NameIndex::npos ? &Options[at] : nullptr;
+        }
+        // Rebuild the lookup indexes, needed only if Flags/Options were edited directly
+        void reindex(){
+            build_name_index(m_FlagIndex, Flags);
+            build_name_index(m_OptionIndex, Options);
+            m_SetFlags.clear();
+            for(std::size_t i = 0; i < Flags.size(); ++i){
+                if(Flags[i].FlagSet){
+                    m_SetFlags.push_back(static_cast<std::uint32_t>(i));
+                }
+            }
+            m_SetOptions.clear();
+            for(std::size_t i = 0; i < Options.size(); ++i){
+                if(Options[i].Set){
+                    m_SetOptions.push_back(static_cast<std::uint32_t>(i));
+                }
+            }
+        }
+        // Clear what parsing and the set_* calls stored on this command, so it
+        // can be parsed again. Only the flags and options that were set are
+        // visited, however many the command has.
+        void reset(){
+            for(std::uint32_t at : m_SetFlags){
+                if(at < Flags.size()){
+                    Flags[at].FlagSet = false;
+                }
+            }
+            for(std::uint32_t at : m_SetOptions){
+                if(at < Options.size()){
+                    Options[at].reset();
+                }
+            }
+            m_SetFlags.clear();
+            m_SetOptions.clear();
+        }
+        bool set_flag(std::string_view name){
+            NCLI_TRACE_SCOPE(SetOption, "set_flag");
+            Flag* flag = find_flag(name);
+            if(flag == nullptr){
+                return false;
+            }
+            mark_flag(*flag);
+            return true;
+        }
+        // The option keeps a view of value; the caller owns the storage
+        bool set_option(std::string_view name, std::string_view value){
+            NCLI_TRACE_SCOPE(SetOption, "set_option");
+            Option* option = find_option(name);
+            if(option == nullptr){
+                return false;
+            }
+            add_value(mark_option(*option), value);
+            return true;
+        }
+        // Replaces whatever the option held before
+        bool set_option_vector(std::string_view name, const std::vector<std::string_view>& values)
+        {
+            NCLI_TRACE_SCOPE(SetOption, "set_option_vector");
+            Option* option = find_option(name);
+            if(option == nullptr){
+                return false;
+            }
+            mark_option(*option).reset();
+            for(const auto& value : values)
+            {
+                add_value(*option, value);
+            }
+            return true;
+        }
+        // The first value given replaces the default, later ones are appended.
+        // Typed options convert the first value (every value for lists).
+        static ConvertResult add_value(Option& option, std::string_view value){
+            bool first = !option.Set;
+            if(first){
+                option.Value = value;
+                option.Set = true;
+            }
+            option.Values.push_back(value);
+            if(first || option.Type == ValueType::UIntList){
+                return option.convert(value);
+            }
+            return {};
+        }
+        bool execute(const Command* global=nullptr) const {
+            NCLI_TRACE_SCOPE(Execute, "execute");
+            if(!Function){
+                return false;
+            }
+            return Function(ParsedArgs(*this, global));
+        }
+        // Run the action on a command line parsed into result
+        bool execute(const ParseResult& result) const {
+            NCLI_TRACE_SCOPE(Execute, "execute");
+            if(!Function){
+                return false;
+            }
+            return Function(ParsedArgs(result));
+        }
+        
+        void display_help(Output& output = Output::standard()) const {
+            NCLI_TRACE_SCOPE(Render, "display_help");
+            Output::Frame frame(output);
+            StyledWriter out(output.buffer());
+            const Style heading = Style::cyan().bold();
+            out.write(heading, "Command: ").write(Style::green(), Name).end_line();
+            out.write(heading, "  Usage: ").write(Style{}.italic(), Help).end_line();
+            out.write(heading, "  Options:").end_line();
+            for(const auto& option : Options){
+                if(option.Set){
+                    out.write(Style::green(), "    [x] --").write(Style::green(), option.Name).write(": ").write(Style{}.italic(), option.Help).end_line();
+                    out.write(Style::green(), "            Current Value: ").write(Style{}.bold(), option.Value).end_line();
                 } else {
-                    std::cout << Color::yellow("    [ ] -" + flag.Name) << ": " << Color::italic(flag.Help) << "\n";
+                    out.write(Style::yellow(), "    [ ] --").write(Style::yellow(), option.Name).write(": ").write(Style{}.italic(), option.Help).end_line();
                 }
             }
+            out.write(heading, "  Flags:").end_line();
+            for(const auto& flag : Flags){
+                const Style mark = flag.FlagSet ? Style::green() : Style::yellow();
+                out.write(mark, flag.FlagSet ? "    [x] -" : "    [ ] -").write(mark, flag.Name).write(": ").write(Style{}.italic(), flag.Help).end_line();
+            }
+        }
+    private:
+        friend class CLI;
+        NameIndex m_FlagIndex;
+        NameIndex m_OptionIndex;
+        // Positions of the flags and options set since the last reset()
+        std::vector<std::uint32_t> m_SetFlags;
+        std::vector<std::uint32_t> m_SetOptions;
+        void mark_flag(Flag& flag){
+            if(!flag.FlagSet){
+                flag.FlagSet = true;
+                m_SetFlags.push_back(static_cast<std::uint32_t>(&flag - Flags.data()));
+            }
+        }
+        // Call before the option is given a value
+        Option& mark_option(Option& option){
+            if(!option.Set){
+                m_SetOptions.push_back(static_cast<std::uint32_t>(&option - Options.data()));
+            }
+            return option;
         }
     };
+    // Everything one parse produced, kept apart from the commands so the same
+    // CLI can parse any number of command lines (see CLI::parse_into). Flags
+    // and options live in slots: the CLI's global ones first, then those of
+    // the command given. A ParseResult that is reused keeps its capacity, so
+    // once warm, parsing into it does not allocate.
+    class ParseResult {
+        public:
+            enum class Error { None, MissingValue, InvalidValue, UnknownOption, UnknownFlag };
+            ParseResult() = default;
+            // Everything the result stores (slots, value lists, converted
+            // lists) comes from resource, e.g. a monotonic_buffer_resource per
+            // request that is released in one step once the request is done
+            explicit ParseResult(std::pmr::memory_resource* resource)
+                : m_Flags(resource), m_Options(resource), m_SetFlags(resource), m_SetOptions(resource) {}
+            bool ok() const { return m_Error == Error::None; }
+            Error error() const { return m_Error; }
+            std::string_view error_name() const { return m_ErrorName; }   // Option or flag at fault
+            std::string_view error_value() const { return m_ErrorValue; } // Value that failed to convert
+            int error_index() const { return m_ErrorIndex; }              // Position in argv
+            const ConvertResult& conversion() const { return m_Conversion; }
+            // Description of the error, as printed by CLI::parse
+            std::string message() const {
+                switch(m_Error){
+                    case Error::None:
+                        return {};
+                    case Error::MissingValue:
+                        return "Missing value for option " + std::string(m_ErrorName);
+                    case Error::InvalidValue:
+                        return "Invalid value '" + std::string(m_ErrorValue) + "' for option " + std::string(m_ErrorName) +
+                               " (argument " + std::to_string(m_ErrorIndex) + ", column " + std::to_string(m_Conversion.Column + 1) +
+                               "): expected " + m_Conversion.Expected;
+                    case Error::UnknownOption:
+                        return "Unknown option: " + std::string(m_ErrorName);
+                    case Error::UnknownFlag:
+                        return "Unknown flag: " + std::string(m_ErrorName);
+                }
+                return {};
+            }
+            // No arguments, --help or -h
+            bool help() const { return m_Help; }
+            // Command word as given (the last one, if several)
+            std::string_view command_name() const { return m_CommandName; }
+            // The command, or nullptr if none was given or the name is unknown
+            const Command* command() const { return m_Command; }
+            bool flag(std::string_view name) const {
+                std::size_t slot = flag_slot(name);
+                return slot != npos && m_Flags[slot];
+            }
+            // Parsed state of the option if it was given, otherwise nullptr
+            const OptionValue* option(std::string_view name) const {
+                std::size_t slot = option_slot(name);
+                return slot != npos && m_Options[slot].Set ? &m_Options[slot] : nullptr;
+            }
+            // Definition of an option of the global set or the command
+            const Option* definition(std::string_view name) const {
+                std::size_t slot = option_slot(name);
+                return slot != npos ? &option_at(slot) : nullptr;
+            }
+            // First value of the option, its default, or fallback
+            std::string_view value(std::string_view name, std::string_view fallback="") const {
+                std::size_t slot = option_slot(name);
+                if(slot == npos){
+                    return fallback;
+                }
+                std::string_view value = m_Options[slot].Set ? m_Options[slot].Value : option_at(slot).Default;
+                return value.empty() ? fallback : value;
+            }
+            const ValueList& values(std::string_view name) const {
+                static const ValueList none;
+                const OptionValue* state = option(name);
+                return state != nullptr ? state->Values : none;
+            }
+            template<typename T>
+            T get(std::string_view name, T fallback=T()) const {
+                std::size_t slot = option_slot(name);
+                if(slot == npos || !m_Options[slot].Set){
+                    return fallback;
+                }
+                return option_at(slot).template get<T>(m_Options[slot].Value, m_Options[slot].Typed);
+            }
+            const std::pmr::vector<std::uint64_t>& list(std::string_view name) const {
+                static const std::pmr::vector<std::uint64_t> none;
+                const OptionValue* state = option(name);
+                return state != nullptr ? state->Typed.List : none;
+            }
+        private:
+            friend class CLI;
+            static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+            const Command* m_Global = nullptr;
+            const Command* m_Command = nullptr;
+            std::string_view m_CommandName;
+            bool m_Help = false;
+            // Slots, sized for the widest command seen so far. Only the slots
+            // listed in m_SetFlags/m_SetOptions hold anything, so starting over
+            // costs what the last parse set rather than the width of the schema.
+            std::pmr::vector<std::uint8_t> m_Flags;
+            std::pmr::vector<OptionValue> m_Options;
+            std::pmr::vector<std::uint32_t> m_SetFlags;
+            std::pmr::vector<std::uint32_t> m_SetOptions;
+            Error m_Error = Error::None;
+            std::string_view m_ErrorName;
+            std::string_view m_ErrorValue;
+            int m_ErrorIndex = 0;
+            ConvertResult m_Conversion;
+            // Start over for a new parse against global
+            void clear(const Command& global){
+                m_Global = &global;
+                m_Command = nullptr;
+                m_CommandName = {};
+                m_Help = false;
+                m_Error = Error::None;
+                m_ErrorName = {};
+                m_ErrorValue = {};
+                m_ErrorIndex = 0;
+                m_Conversion = ConvertResult{};
+                use(0, global.Flags.size(), 0, global.Options.size());
+            }
+            // Switch to a command (or none); the global slots are kept
+            void select(const Command* command, std::string_view name){
+                m_Command = command;
+                m_CommandName = name;
+                std::size_t flags = m_Global->Flags.size();
+                std::size_t options = m_Global->Options.size();
+                use(flags, flags + (command != nullptr ? command->Flags.size() : 0),
+                    options, options + (command != nullptr ? command->Options.size() : 0));
+            }
+            // Make room for flags/options slots, and clear those set from first_flag/first_option on
+            void use(std::size_t first_flag, std::size_t flags, std::size_t first_option, std::size_t options){
+                if(m_Flags.size() < flags){
+                    m_Flags.resize(flags);
+                }
+                if(m_Options.size() < options){
+                    m_Options.resize(options);
+                }
+                auto flag_end = std::remove_if(m_SetFlags.begin(), m_SetFlags.end(), [&](std::uint32_t slot){
+                    if(slot < first_flag){
+                        return false;
+                    }
+                    m_Flags[slot] = 0;
+                    return true;
+                });
+                m_SetFlags.erase(flag_end, m_SetFlags.end());
+                auto option_end = std::remove_if(m_SetOptions.begin(), m_SetOptions.end(), [&](std::uint32_t slot){
+                    if(slot < first_option){
+                        return false;
+                    }
+                    m_Options[slot].clear();
+                    return true;
+                });
+                m_SetOptions.erase(option_end, m_SetOptions.end());
+            }
+            void set_flag(std::size_t slot){
+                if(!m_Flags[slot]){
+                    m_Flags[slot] = 1;
+                    m_SetFlags.push_back(static_cast<std::uint32_t>(slot));
+                }
+            }
+            // State of an option slot, about to be given a value
+            OptionValue& set_option(std::size_t slot){
+                if(!m_Options[slot].Set){
+                    m_SetOptions.push_back(static_cast<std::uint32_t>(slot));
+                }
+                return m_Options[slot];
+            }
+            std::size_t flag_slot(std::string_view name) const {
+                if(m_Global == nullptr){
+                    return npos;
+                }
+                if(const Flag* flag = m_Global->find_flag(name)){
+                    return static_cast<std::size_t>(flag - m_Global->Flags.data());
+                }
+                if(m_Command != nullptr){
+                    if(const Flag* flag = m_Command->find_flag(name)){
+                        return m_Global->Flags.size() + static_cast<std::size_t>(flag - m_Command->Flags.data());
+                    }
+                }
+                return npos;
+            }
+            std::size_t option_slot(std::string_view name) const {
+                if(m_Global == nullptr){
+                    return npos;
+                }
+                if(const Option* option = m_Global->find_option(name)){
+                    return static_cast<std::size_t>(option - m_Global->Options.data());
+                }
+                if(m_Command != nullptr){
+                    if(const Option* option = m_Command->find_option(name)){
+                        return m_Global->Options.size() + static_cast<std::size_t>(option - m_Command->Options.data());
+                    }
+                }
+                return npos;
+            }
+            const Option& option_at(std::size_t slot) const {
+                std::size_t globals = m_Global->Options.size();
+                return slot < globals ? m_Global->Options[slot] : m_Command->Options[slot - globals];
+            }
+            bool fail(Error error, std::string_view name, int index){
+                m_Error = error;
+                m_ErrorName = name;
+                m_ErrorIndex = index;
+                return false;
+            }
+    };
+    inline ParsedArgs::ParsedArgs(const ParseResult& result)
+        : m_Command(*result.command()), m_Global(nullptr), m_Result(&result) {}
+    inline const Flag* ParsedArgs::find_flag(std::string_view name) const {
+        const Flag* flag = m_Command.find_flag(name);
+        if(flag == nullptr && m_Global != nullptr){
+            flag = m_Global->find_flag(name);
+        }
+        return flag;
+    }
+    inline const Option* ParsedArgs::find_option(std::string_view name) const {
+        const Option* option = m_Command.find_option(name);
+        if(option == nullptr && m_Global != nullptr){
+            option = m_Global->find_option(name);
+        }
+        return option;
+    }
+    inline bool ParsedArgs::flag(std::string_view name) const {
+        if(m_Result != nullptr){
+            return m_Result->flag(name);
+        }
+        const Flag* flag = find_flag(name);
+        return flag != nullptr && flag->FlagSet;
+    }
+    inline const Option* ParsedArgs::option(std::string_view name) const {
+        if(m_Result != nullptr){
+            return m_Result->option(name) != nullptr ? m_Result->definition(name) : nullptr;
+        }
+        const Option* option = find_option(name);
+        return option != nullptr && option->Set ? option : nullptr;
+    }
+    inline std::string_view ParsedArgs::value(std::string_view name, std::string_view fallback) const {
+        if(m_Result != nullptr){
+            return m_Result->value(name, fallback);
+        }
+        const Option* option = find_option(name);
+        return option != nullptr && !option->Value.empty() ? option->Value : fallback;
+    }
+    inline const ValueList& ParsedArgs::values(std::string_view name) const {
+        if(m_Result != nullptr){
+            return m_Result->values(name);
+        }
+        static const ValueList none;
+        const Option* option = this->option(name);
+        return option != nullptr ? option->Values : none;
+    }
+    template<typename T>
+    T ParsedArgs::get(std::string_view name, T fallback) const {
+        if(m_Result != nullptr){
+            return m_Result->get<T>(name, fallback);
+        }
+        const Option* opt = option(name);
+        return opt != nullptr ? opt->get<T>() : fallback;
+    }
+    inline const std::pmr::vector<std::uint64_t>& ParsedArgs::list(std::string_view name) const {
+        if(m_Result != nullptr){
+            return m_Result->list(name);
+        }
+        static const std::pmr::vector<std::uint64_t> none;
+        const Option* option = this->option(name);
+        return option != nullptr ? option->Typed.List : none;
+    }
 } // namespace NCLI
 // --- Command.h --- //
 
 // --- CLI.h --- //
 namespace NCLI
 {
+    // Thrown instead of exiting when a command line is rejected inside
+    // CLI::repl(); the error has already been reported
+    class ParseError : public std::runtime_error {
+        public:
+            explicit ParseError(int code)
+                : std::runtime_error("NCLI: command line rejected"), Code(code) {}
+            int Code; // Exit status a one-shot run would have used
+    };
+    // What to do when a line of a script fails
+    enum class ErrorPolicy { KeepGoing, FailFast };
+    // Outcome and timing of CLI::run_script()
+    struct BatchReport {
+        struct CommandStats {
+            std::string_view Name;
+            std::size_t Runs = 0;
+            std::size_t Failed = 0;
+            std::chrono::nanoseconds Time{0};
+        };
+        std::size_t Lines = 0;      // Command lines read (blank lines and comments are skipped)
+        std::size_t Failed = 0;
+        std::size_t FirstError = 0; // Line number of the first failure, 0 if none
+        bool Stopped = false;       // Gave up early (ErrorPolicy::FailFast)
+        std::chrono::nanoseconds Time{0};
+        std::vector<CommandStats> Commands; // In registration order
+        bool ok() const { return Failed == 0; }
+        // Totals, then the commands that ran, one per line
+        void print(std::ostream& out) const {
+            auto ms = [](std::chrono::nanoseconds time){ return std::chrono::duration<double, std::milli>(time).count(); };
+            out << "Batch: " << Lines << " lines, " << Failed << " failed, " << ms(Time) << " ms";
+            if(Stopped){
+                out << " (stopped at line " << FirstError << ")";
+            }
+            out << "\n";
+            for(const auto& cmd : Commands){
+                if(cmd.Runs > 0){
+                    out << "  " << cmd.Name << ": " << cmd.Runs << " runs, " << cmd.Failed << " failed, " << ms(cmd.Time) << " ms\n";
+                }
+            }
+        }
+    };
     class CLI {
         public:
+            CLI() = default;
+            // parse() keeps its result and the owned copy of argv (see
+            // own_arguments) in resource; the commands stay on the heap
+            explicit CLI(std::pmr::memory_resource* resource)
+                : m_Parsed(resource), m_ArgStorage(resource), m_ArgPointers(resource) {}
             Command& command(const std::string& name){
-                m_Commands.push_back(Command(name));
-                return m_Commands.back();
+                return register_command(Command(name));
             }
             Command& command(const std::string& name, const std::string& help){
-                m_Commands.push_back(Command(name, help));
-                return m_Commands.back();
+                return register_command(Command(name, help));
             }
             Command& command(const std::string& name, const std::string& help, CommandFunc& func){
-                m_Commands.push_back(Command(name, help, func));
-                return m_Commands.back();
+                return register_command(Command(name, help, func));
             }
-            Command* get_command(const std::string& name){
-                auto it = std::find_if(m_Commands.begin(), m_Commands.end(),
-                    [&name](const Command& cmd) {
-                        return cmd.Name == name;
-                    });
-                return it != m_Commands.end() ? &(*it) : nullptr;
+            Command* get_command(std::string_view name){
+                std::uint32_t at = m_CommandIndex.find(name);
+                return at != NameIndex::npos ? &m_Commands[at] : nullptr;
+            }
+            const Command* get_command(std::string_view name) const {
+                std::uint32_t at = m_CommandIndex.find(name);
+                return at != NameIndex::npos ? &m_Commands[at] : nullptr;
             }
             bool has_command(){
                 return !m_CurrentCommand.empty();
             }
             Option& add_option(const std::string& name) {
-                m_Options.push_back({name, "", "", false});
-                return m_Options.back();
+                return add_option(name, "");
             }
             Option& add_option(const std::string& name, const std::string& help) {
-                m_Options.push_back({name, help, "", false});
-                return m_Options.back();
+                return m_Global.add_option(name, help).Options.back();
             }
-            Option* get_option(const std::string& name){
-                auto it = std::find_if(m_Options.begin(), m_Options.end(),
-                [&name](const Option& opt){
-                    return opt.Name == name;
-                });
-                return it != m_Options.end() ? &(*it) : nullptr;
+            template<typename T>
+            Option& add_option(const std::string& name, const std::string& help) {
+                return m_Global.option<T>(name, help).Options.back();
+            }
+            Option* get_option(std::string_view name){
+                return m_Global.find_option(name);
             }
         
             Flag& add_flag(const std::string& name) {
-                m_Flags.push_back({name, "", false});
-                return m_Flags.back();
+                return add_flag(name, "");
             }
             Flag& add_flag(const std::string& name, const std::string& help) {
-                m_Flags.push_back({name, help, false});
-                return m_Flags.back();
+                return m_Global.add_flag(name, help).Flags.back();
             }
-            Flag* get_flag(const std::string& name){
-                auto it = std::find_if(m_Flags.begin(), m_Flags.end(),
-                [&name](const Flag& flag){
-                    return flag.Name == name;
-                });
-                return it != m_Flags.end() ? &(*it) : nullptr;
+            Flag* get_flag(std::string_view name){
+                return m_Global.find_flag(name);
             }
             void display_help(){
-                std::cout << Color::cyan(Color::bold("Available commands:\n"));
+                print_help();
+                exit(0);
+            }
+            // Same as display_help() without exiting
+            void print_help(Output& output = Output::standard()) const {
+                NCLI_TRACE_SCOPE(Render, "print_help");
+                Output::Frame frame(output);
+                StyledWriter out(output.buffer());
+                out.write(Style::cyan().bold(), "Available commands:").end_line();
                 for(const auto& cmd: m_Commands){
-                    std::cout << "  " << Color::cyan(Color::bold(cmd.Name)) << ": " << Color::italic(cmd.Help) << "\n";
+                    out.write("  ").write(Style::cyan().bold(), cmd.Name).write(": ").write(Style{}.italic(), cmd.Help).end_line();
                 }
-                exit(0);
+            }
+            // Calls, time and allocations per phase so far, process-wide; all
+            // zero unless NCLI is built with NCLI_TRACE (see Trace.h)
+            TraceStats stats() const {
+                return Trace::stats();
+            }
+            // Copy argv into storage owned by the CLI before parsing, so parsed
+            // values outlive argv. Off by default: values are views into argv.
+            void own_arguments(bool own=true){
+                m_OwnArguments = own;
+            }
+            // Forget the last parse (flags, option values, current command) so
+            // another command line can be parsed; allocations are kept. Only
+            // the commands parse() stored into are visited.
+            void reset(){
+                m_Global.reset();
+                for(std::uint32_t at : m_Applied){
+                    if(at < m_Commands.size()){
+                        m_Commands[at].reset();
+                    }
+                }
+                m_Applied.clear();
+                m_CurrentCommand = {};
+                m_Current = nullptr;
             }
             void parse(int argc, char* argv[]) {
-                if(argc == 1 || std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h"){
-                    display_help();
-                }
-                for(int i=1; i<argc; ++i){
-                    std::string arg = argv[i];
-                    // Handle flags first
-                    if(arg[0] == '-'){
-                        if(arg[1] == '-'){ // Long option (e.g. --name)
-                            std::string option_name = arg.substr(2);
-                            std::vector<std::string> values;
-                            while(i+1 < argc && argv[i+1][0] != '-')
-                            {
-                                values.push_back(argv[++i]);
+                // Hidden entry points for shell completion: "__complete <words>"
+                // answers a query, "__completion <shell>" prints the script
+                if(completing(argc, argv)){
+                    complete(argc - 2, argv + 2, std::cout);
+                    std::cout.flush();
+                    stop(0);
+                }
+                if(argc >= 3 && std::string_view(argv[1]) == "__completion"){
+                    std::string_view program = argv[0];
+                    std::string script = completion_script(argv[2], program.substr(program.find_last_of("/\\") + 1));
+                    if(script.empty()){
+                        std::cerr << "Error: no completion for shell " << argv[2] << " (bash, zsh or fish)" << std::endl;
+                        stop(1);
+                    }
+                    std::cout << script;
+                    stop(0);
+                }
+                // --ncli-trace <file> writes a Chrome trace of the run when the program exits
+                if(argc >= 3 && std::string_view(argv[1]) == "--ncli-trace"){
+                    if(!Trace::Enabled){
+                        std::cerr << "Warning: --ncli-trace needs NCLI built with NCLI_TRACE; no trace is written" << std::endl;
+                    } else if(!Trace::start(argv[2])){
+                        std::cerr << "Error: cannot write trace " << argv[2] << std::endl;
+                        stop(1);
+                    }
+                    // The file name takes the place of the program name, which is never read
+                    argv += 2;
+                    argc -= 2;
+                }
+                // --batch <file> [--fail-fast] [--parallel] runs a script instead ("-" for stdin)
+                if(argc >= 3 && std::string_view(argv[1]) == "--batch"){
+                    ErrorPolicy policy = ErrorPolicy::KeepGoing;
+                    bool parallel = false;
+                    for(int i = 3; i < argc; ++i){
+                        std::string_view arg = argv[i];
+                        if(arg == "--fail-fast"){
+                            policy = ErrorPolicy::FailFast;
+                        } else if(arg == "--parallel"){
+                            parallel = true;
+                        } else {
+                            std::cerr << "Error: unknown --batch argument '" << arg << "'\n"
+                                      << "Usage: " << argv[0] << " --batch <file> [--fail-fast] [--parallel]" << std::endl;
+                            stop(1);
+                        }
+                    }
+                    BatchReport report = parallel ? run_script_parallel(argv[2], policy) : run_script(argv[2], policy);
+                    report.print(std::cerr);
+                    stop(report.ok() ? 0 : 1);
+                }
+                if(m_OwnArguments){
+                    argv = own_argv(argc, argv);
+                }
+                parse_into(argc, argv, m_Parsed);
+                report(m_Parsed);
+                apply(m_Parsed);
+            }
+            // Parse a command line into result without touching the CLI, so one
+            // CLI can parse any number of command lines, one after another or
+            // from several threads with a ParseResult each. Nothing is printed;
+            // returns false on an error, which result describes. Values are
+            // views into argv and result can be reused once they are done with.
+            bool parse_into(int argc, char* const argv[], ParseResult& result) const {
+                NCLI_TRACE_SCOPE(Parse, "parse_into");
+                result.clear(m_Global);
+                if(argc == 1 || std::string_view(argv[1]) == "--help" || std::string_view(argv[1]) == "-h"){
+                    result.m_Help = true;
+                    return true;
+                }
+                Tokenizer tokens(argc, argv);
+                Token token;
+                while(tokens.next(token)){
+                    switch(token.Type){
+                        case Token::Kind::Option: { // Long option (e.g. --name)
+                            // Global options first, then the current command's
+                            std::size_t slot = result.option_slot(token.Text);
+                            bool numeric = slot != ParseResult::npos && result.option_at(slot).takes_negative();
+                            std::string_view value;
+                            if(!tokens.next_value(value, numeric)){
+                                return result.fail(ParseResult::Error::MissingValue, token.Text, token.Index);
                             }
-                            if(!values.empty()){
-                                set_option_vector(option_name, values);
-                            } else {
-                                std::cerr << "Error: Missing value for option " << option_name << std::endl;
-                                exit(1);
+                            if(slot == ParseResult::npos){
+                                return result.fail(ParseResult::Error::UnknownOption, token.Text, token.Index);
                             }
-                        } else {
-                            // Short flag (e.g. -v)
-                            set_flag(arg.substr(1));
+                            NCLI_TRACE_SCOPE(SetOption, "set_option");
+                            const Option& option = result.option_at(slot);
+                            OptionValue& state = result.set_option(slot);
+                            do {
+                                ConvertResult converted = option.add_value(state, value);
+                                if(!converted.Ok){
+                                    result.m_ErrorValue = value;
+                                    result.m_Conversion = converted;
+                                    return result.fail(ParseResult::Error::InvalidValue, token.Text, tokens.index() - 1);
+                                }
+                            } while(tokens.next_value(value, numeric));
+                            break;
+                        }
+                        case Token::Kind::Flag: { // Short flag (e.g. -v)
+                            std::size_t slot = result.flag_slot(token.Text);
+                            if(slot == ParseResult::npos){
+                                return result.fail(ParseResult::Error::UnknownFlag, token.Text, token.Index);
+                            }
+                            NCLI_TRACE_SCOPE(SetOption, "set_flag");
+                            result.set_flag(slot);
+                            break;
+                        }
+                        case Token::Kind::Word: { // Command (first non-option argument)
+                            const Command* command = get_command(token.Text);
+                            if(command == nullptr || command != result.m_Command){
+                                result.select(command, token.Text);
+                            }
+                            break;
                         }
-                    } else {
-                        // Command (first non-option argument)
-                        m_CurrentCommand = arg;
                     }
                 }
+                return true;
             }
             void run(const std::string& name=""){
                 bool ran=false;
@@ -588,128 +4320,881 @@ namespace NCLI
                 }
                 if(cmd != nullptr){
                     std::cout << "Executing: " << cmd->Name << "\n";
-                    ran = cmd->execute();
+                    try {
+                        ran = cmd->execute(&m_Global);
+                    } catch(const CancelledError&){
+                        std::cerr << "Cancelled" << std::endl;
+                        stop(130);
+                    }
                     std::cout << "Done Executing\n";
                     if(!ran){
                         std::cout << "Displaying Help\n";
                         cmd->display_help();
                     }
                 } else {
-                    if(name.empty()){
-                        std::cout << Color::red("Command not found: ") << Color::bold(m_CurrentCommand) << Color::red("!\n");
-                    } else {
-                        std::cout << Color::red("Command not found: ") << Color::bold(name) << Color::red("!\n");
+                    Output& output = Output::standard();
+                    {
+                        Output::Frame frame(output);
+                        StyledWriter(output.buffer()).write(Style::red(), "Command not found: ").write(Style{}.bold(), name.empty() ? m_CurrentCommand : std::string_view(name)).write(Style::red(), "!").end_line();
+                        print_help(output);
                     }
-                    display_help();
+                    stop(0);
                 }
             }
-            std::string get(const std::string& name) const {
-                for(const auto& option : m_Options){
-                    if(option.Name == name){
-                        return option.Value;
-                    }
+            // Run the command of a parse_into() result. Help requests, errors
+            // and unknown commands are reported the way run() and parse() do,
+            // but nothing exits; returns true if the command ran successfully.
+            bool run(const ParseResult& result) const {
+                if(result.help()){
+                    print_help();
+                    return true;
+                }
+                if(!result.ok()){
+                    std::cerr << "Error: " << result.message() << std::endl;
+                    return false;
+                }
+                const Command* cmd = result.command();
+                if(cmd == nullptr){
+                    Output& output = Output::standard();
+                    Output::Frame frame(output);
+                    StyledWriter(output.buffer()).write(Style::red(), "Command not found: ").write(Style{}.bold(), result.command_name()).write(Style::red(), "!").end_line();
+                    print_help(output);
+                    return false;
                 }
-                return "";
+                std::cout << "Executing: " << cmd->Name << "\n";
+                bool ran = false;
+                try {
+                    ran = cmd->execute(result);
+                } catch(const CancelledError&){
+                    std::cerr << "Cancelled" << std::endl;
+                    return false;
+                }
+                std::cout << "Done Executing\n";
+                if(!ran){
+                    std::cout << "Displaying Help\n";
+                    cmd->display_help();
+                }
+                return ran;
             }
-            bool is_set(const std::string& name) const {
-                for(const auto& flag : m_Flags){
-                    if(flag.Name == name){
-                        return flag.FlagSet;
+            // parse_into() and run(result) in one go. Both only read the CLI, so
+            // any number of threads can dispatch on one const CLI at once,
+            // each with its own ParseResult.
+            bool dispatch(int argc, char* const argv[], ParseResult& result) const {
+                parse_into(argc, argv, result);
+                return run(result);
+            }
+            // Run a script of command lines, one per line, as if each had been
+            // given on the command line. Lines are split with split_line();
+            // blank lines and lines starting with '#' are skipped. Failures
+            // (parse errors, unknown commands, actions returning false or
+            // throwing) are reported to stderr with their line number.
+            BatchReport run_script(std::istream& in, ErrorPolicy policy = ErrorPolicy::KeepGoing) const {
+                BatchReport report = new_report();
+                auto start = std::chrono::steady_clock::now();
+                BatchJob job;
+                std::string line;
+                std::size_t number = 0;
+                while(!report.Stopped && std::getline(in, line)){
+                    ++number;
+                    if(skip_line(line)){
+                        continue;
                     }
+                    prepare(job, line, number);
+                    execute(job);
+                    finish(job, policy, report);
                 }
+                report.Time = std::chrono::steady_clock::now() - start;
+                return report;
             }
-        private:
-            std::vector<Command> m_Commands;
-            std::vector<Option> m_Options; // Global Options
-            std::vector<Flag> m_Flags; // Global Flags
-            std::string m_CurrentCommand;
-        private:
-            void set_option(const std::string& name, const std::string& value){
-                // First check if global options are set
-                for(auto& option : m_Options){
-                    if(option.Name == name){
-                        option.Value = value;
-                        option.Set = true;
-                        return;
+            // Run the script in a file, or stdin for "-"
+            BatchReport run_script(const std::string& path, ErrorPolicy policy = ErrorPolicy::KeepGoing) const {
+                return open_script(path, [&](std::istream& in){ return run_script(in, policy); });
+            }
+            // run_script(), with the lines of parallel_safe() commands run on
+            // pool. What each of them prints through Output::standard() is
+            // collected and written out in script order, errors included, so
+            // the log reads the same as a serial run. Any other command waits
+            // for the lines before it and runs on its own. With FailFast,
+            // lines after the failing one may already have run.
+            BatchReport run_script_parallel(std::istream& in, ErrorPolicy policy = ErrorPolicy::KeepGoing,
+                                            ThreadPool& pool = ThreadPool::shared()) const {
+                BatchReport report = new_report();
+                auto start = std::chrono::steady_clock::now();
+                std::vector<BatchJob> jobs(BatchWindow);
+                std::string line;
+                std::size_t number = 0;
+                bool more = true;
+                while(more && !report.Stopped){
+                    // Read a window of lines, then run it
+                    std::size_t count = 0;
+                    while(count < jobs.size() && (more = static_cast<bool>(std::getline(in, line)))){
+                        ++number;
+                        if(!skip_line(line)){
+                            prepare(jobs[count++], line, number);
+                        }
                     }
-                }
-                // Then check if options are set on current command
-                if(!m_CurrentCommand.empty()){
-                    Command* current = get_command(m_CurrentCommand);
-                    if(current != nullptr){
-                        if(current->set_option(name, value)){
-                            return;
-                        } else {
-                            std::cout << Color::red(Color::bold("Unknown option: ")) << name << "\n";
-                            current->display_help();
-                            exit(0);
+                    for(std::size_t i = 0; i < count && !report.Stopped;){
+                        std::size_t end = i;
+                        while(end < count && concurrent(jobs[end])){
+                            ++end;
+                        }
+                        if(end == i){
+                            execute(jobs[i]);
+                            finish(jobs[i++], policy, report);
+                            continue;
+                        }
+                        std::atomic<std::size_t> failed{end - i}; // First failure so far
+                        pool.parallel_for(end - i, [&](std::size_t k){
+                            if(policy == ErrorPolicy::FailFast && k > failed.load()){
+                                return; // Not reported: an earlier line stops the batch
+                            }
+                            BatchJob& job = jobs[i + k];
+                            capture(job);
+                            std::size_t seen = failed.load();
+                            while(!job.Ok && k < seen && !failed.compare_exchange_weak(seen, k)){}
+                        });
+                        for(; i < end && !report.Stopped; ++i){
+                            finish(jobs[i], policy, report);
                         }
                     }
                 }
-                // Nothing left to check, throw an error and show help
-                throw std::invalid_argument("Unknown option: " + name);
+                report.Time = std::chrono::steady_clock::now() - start;
+                return report;
             }
-            void set_option_vector(const std::string& name, const std::vector<std::string>& values)
-            {
-                // First check if global options are set
-                for(auto& option : m_Options){
-                    if(option.Name == name){
-                        // Check if option value is already set, if so make it first
-                        if(!option.Value.empty()){
-                            if (std::find(option.Values.begin(), option.Values.end(), option.Value) != option.Values.end())
-                            {
-                                option.Values.insert(option.Values.begin(), option.Value);
+            BatchReport run_script_parallel(const std::string& path, ErrorPolicy policy = ErrorPolicy::KeepGoing,
+                                            ThreadPool& pool = ThreadPool::shared()) const {
+                return open_script(path, [&](std::istream& in){ return run_script_parallel(in, policy, pool); });
+            }
+            // True when a shell asks for completions. parse() answers and exits
+            // before anything runs; a program can check this first to skip
+            // setup with side effects (connections, files) on every Tab.
+            static bool completing(int argc, char* const argv[]){
+                return argc >= 2 && std::string_view(argv[1]) == "__complete";
+            }
+            // Shell completion. words are the arguments after the program name,
+            // the last being the word under the cursor (possibly empty). Calls
+            // emit(text, help) for every candidate in registration order (the
+            // shells sort them): commands, then --options and -flags of the
+            // command given, then values of an option from its Choices and
+            // completer. Nothing is parsed into the CLI and no action runs.
+            // Names are matched in one pass over the packed name indexes.
+            template<typename Emit, typename = std::enable_if_t<std::is_invocable_v<Emit&, std::string_view, std::string_view>>>
+            void complete(int count, char* const words[], Emit&& emit) const {
+                if(count < 1){
+                    return;
+                }
+                // Walk the words before the cursor the way parse_into() does
+                const Command* command = nullptr;
+                const Option* value_of = nullptr;
+                bool in_values = false; // The cursor is in the values of an option
+                Tokenizer tokens(count - 1, words, 0);
+                Token token;
+                std::string_view value;
+                while(tokens.next(token)){
+                    switch(token.Type){
+                        case Token::Kind::Option:
+                            value_of = m_Global.find_option(token.Text);
+                            if(value_of == nullptr && command != nullptr){
+                                value_of = command->find_option(token.Text);
                             }
+                            in_values = true;
+                            while(tokens.next_value(value, value_of != nullptr && value_of->takes_negative())){}
+                            break;
+                        case Token::Kind::Flag:
+                            in_values = false;
+                            break;
+                        case Token::Kind::Word:
+                            command = get_command(token.Text);
+                            in_values = false;
+                            break;
+                    }
+                }
+                std::string_view word = words[count - 1];
+                std::string text; // Candidate with its dashes
+                auto options = [&](std::string_view prefix){
+                    for(const Command* owner : {&m_Global, command}){
+                        if(owner == nullptr){
+                            continue;
                         }
-                        option.Set = true;
-                        for(auto value : values)
-                        {
-                            option.Values.push_back(value);
+                        owner->m_OptionIndex.each_prefixed(prefix, [&](std::string_view name, std::uint32_t at){
+                            text.assign("--").append(name);
+                            emit(std::string_view(text), std::string_view(owner->Options[at].Help));
+                        });
+                    }
+                };
+                auto flags = [&](std::string_view prefix){
+                    for(const Command* owner : {&m_Global, command}){
+                        if(owner == nullptr){
+                            continue;
                         }
+                        owner->m_FlagIndex.each_prefixed(prefix, [&](std::string_view name, std::uint32_t at){
+                            text.assign("-").append(name);
+                            emit(std::string_view(text), std::string_view(owner->Flags[at].Help));
+                        });
+                    }
+                };
+                if(word.size() > 1 && word[0] == '-' && word[1] == '-'){
+                    options(word.substr(2));
+                } else if(!word.empty() && word[0] == '-'){
+                    flags(word.substr(1));
+                    if(word.size() == 1){
+                        options({});
+                    }
+                } else if(in_values){
+                    if(value_of == nullptr){
                         return;
                     }
+                    for(const auto& choice : value_of->Choices){
+                        if(choice.first.compare(0, word.size(), word) == 0){
+                            emit(std::string_view(choice.first), std::string_view());
+                        }
+                    }
+                    if(value_of->Complete){
+                        for(const std::string& candidate : value_of->Complete(word)){
+                            if(candidate.compare(0, word.size(), word) == 0){
+                                emit(std::string_view(candidate), std::string_view());
+                            }
+                        }
+                    }
+                } else if(command == nullptr){
+                    m_CommandIndex.each_prefixed(word, [&](std::string_view name, std::uint32_t at){
+                        emit(name, std::string_view(m_Commands[at].Help));
+                    });
+                } else if(word.empty()){
+                    options({});
+                    flags({});
                 }
-                // Then check if options are set on current command
-                if(!m_CurrentCommand.empty()){
-                    Command* current = get_command(m_CurrentCommand);
-                    if(current != nullptr){
-                        if(current->set_option_vector(name, values)){
-                            return;
-                        } else {
-                            std::cout << Color::red(Color::bold("Unknown option: ")) << name << "\n";
-                            current->display_help();
-                            exit(0);
+            }
+            // complete() as "text<TAB>help" lines, the format the scripts from
+            // completion_script() read, written in one go
+            void complete(int count, char* const words[], std::ostream& out) const {
+                std::string buffer;
+                complete(count, words, [&buffer](std::string_view text, std::string_view help){
+                    buffer.append(text).push_back('\t');
+                    buffer.append(help.substr(0, help.find('\n'))).push_back('\n');
+                });
+                out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            }
+            // Script hooking completion up for program in bash, zsh or fish
+            // (empty for any other shell), e.g. source <(prog __completion bash)
+            static std::string completion_script(std::string_view shell, std::string_view program){
+                std::string name(program);
+                std::string function = "_ncli_";
+                for(char c : program){
+                    function.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+                }
+                if(shell == "bash"){
+                    return function + "() {\n"
+                        "    local IFS=$'\\n'\n"
+                        "    COMPREPLY=($(\"${COMP_WORDS[0]}\" __complete \"${COMP_WORDS[@]:1:COMP_CWORD}\" 2>/dev/null | cut -f1))\n"
+                        "}\n"
+                        "complete -o default -F " + function + " " + name + "\n";
+                }
+                if(shell == "zsh"){
+                    return "#compdef " + name + "\n" + function + "() {\n"
+                        "    local -a candidates\n"
+                        "    local line\n"
+                        "    for line in \"${(@f)$(\"${words[1]}\" __complete \"${(@)words[2,CURRENT]}\" 2>/dev/null)}\"; do\n"
+                        "        [[ -n $line ]] && candidates+=(\"${${line%%$'\\t'*}//:/\\\\:}:${line#*$'\\t'}\")\n"
+                        "    done\n"
+                        "    _describe 'values' candidates\n"
+                        "}\n"
+                        "compdef " + function + " " + name + "\n";
+                }
+                if(shell == "fish"){
+                    return "complete -c " + name + " -f -a '(" + name + " __complete (commandline -opc)[2..-1] (commandline -ct))'\n";
+                }
+                return {};
+            }
+            // Interactive shell: read command lines with editing and history,
+            // then parse and run each one on this CLI, until end of input
+            // (Ctrl-D), "exit" or "quit". Errors are reported and the session
+            // goes on; "help" lists the commands.
+            void repl(const std::string& prompt = "> "){
+                std::string text = Color::cyan(prompt);
+                LineEditor editor;
+                std::string line;
+                std::string storage;
+                std::vector<char*> args;
+                bool interactive = m_Interactive;
+                m_Interactive = true;
+                while(editor.read(text, line)){
+                    editor.add_history(line);
+                    if(!split_line(line, storage, args)){
+                        std::cerr << "Error: Unterminated quote" << std::endl;
+                        continue;
+                    }
+                    int argc = static_cast<int>(args.size()) - 1;
+                    if(argc == 2){
+                        std::string_view word = args[1];
+                        if(word == "exit" || word == "quit"){
+                            break;
+                        }
+                        if(word == "help"){
+                            print_help();
+                            continue;
                         }
                     }
+                    if(argc < 2){
+                        continue;
+                    }
+                    reset();
+                    try {
+                        parse(argc, args.data());
+                        run();
+                    } catch(const ParseError&){
+                        // Already reported
+                    } catch(const std::exception& e){
+                        std::cerr << "Error: " << e.what() << std::endl;
+                    }
+                }
+                reset();
+                m_Interactive = interactive;
+            }
+            // Value of a global option, copied
+            std::string get(std::string_view name) const {
+                return std::string(get_view(name));
+            }
+            // Value of a global option without copying; a view into argv (or
+            // the option's default), valid as long as the parse is
+            std::string_view get_view(std::string_view name) const {
+                const Option* option = m_Global.find_option(name);
+                return option != nullptr ? option->Value : std::string_view();
+            }
+            bool is_set(std::string_view name) const {
+                const Flag* flag = m_Global.find_flag(name);
+                return flag != nullptr && flag->FlagSet;
+            }
+        private:
+            std::vector<Command> m_Commands;
+            Command m_Global; // Global options and flags
+            std::string_view m_CurrentCommand;
+            Command* m_Current = nullptr; // Resolved m_CurrentCommand, reset on registration
+            NameIndex m_CommandIndex;
+            std::vector<std::uint32_t> m_Applied; // Commands parse() stored into since reset()
+            ParseResult m_Parsed; // Scratch result behind parse()
+            bool m_OwnArguments = false;
+            bool m_Interactive = false; // Inside repl(): errors throw ParseError instead of exiting
+            std::pmr::string m_ArgStorage;
+            std::pmr::vector<char*> m_ArgPointers;
+        private:
+            // Give up on the current command line
+            [[noreturn]] void stop(int code) const {
+                if(m_Interactive){
+                    throw ParseError(code);
+                }
+                exit(code);
+            }
+            Command& register_command(Command&& cmd){
+                NCLI_TRACE_SCOPE(Register, "register_command");
+                m_Commands.push_back(std::move(cmd));
+                m_CommandIndex.insert(m_Commands.back().Name, m_Commands.size() - 1);
+                m_Current = nullptr;
+                return m_Commands.back();
+            }
+            char** own_argv(int argc, char* argv[]){
+                std::size_t total = 0;
+                for(int i=0; i<argc; ++i){
+                    total += std::strlen(argv[i]) + 1;
+                }
+                // Reserve up front so the pointers taken below stay valid
+                m_ArgStorage.clear();
+                m_ArgStorage.reserve(total);
+                m_ArgPointers.clear();
+                for(int i=0; i<argc; ++i){
+                    std::size_t at = m_ArgStorage.size();
+                    m_ArgStorage.append(argv[i]);
+                    m_ArgStorage.push_back('\0');
+                    m_ArgPointers.push_back(&m_ArgStorage[at]);
+                }
+                m_ArgPointers.push_back(nullptr);
+                return m_ArgPointers.data();
+            }
+            // One line of a script on its way through run_script()
+            struct BatchJob {
+                std::size_t Number = 0;
+                std::string Storage;
+                std::vector<char*> Args;
+                ParseResult Result;
+                const Command* Ran = nullptr; // Command that was run, if any
+                bool Ok = false;
+                std::string Text;  // Output collected while running
+                std::string Error; // Why the line failed
+                std::chrono::nanoseconds Time{0};
+            };
+            static constexpr std::size_t BatchWindow = 4096; // Lines read ahead by run_script_parallel()
+            BatchReport new_report() const {
+                BatchReport report;
+                report.Commands.resize(m_Commands.size());
+                for(std::size_t i = 0; i < m_Commands.size(); ++i){
+                    report.Commands[i].Name = m_Commands[i].Name;
+                }
+                return report;
+            }
+            template<typename Run>
+            BatchReport open_script(const std::string& path, Run&& run) const {
+                if(path == "-"){
+                    return run(std::cin);
+                }
+                std::ifstream file(path);
+                if(!file){
+                    std::cerr << "Error: Cannot open script " << path << std::endl;
+                    BatchReport report;
+                    report.Failed = 1;
+                    return report;
+                }
+                return run(file);
+            }
+            // Blank lines and comments
+            static bool skip_line(std::string_view line){
+                std::size_t first = line.find_first_not_of(" \t\r");
+                return first == std::string_view::npos || line[first] == '#';
+            }
+            // Split and parse a line
+            void prepare(BatchJob& job, std::string_view line, std::size_t number) const {
+                job.Number = number;
+                job.Ran = nullptr;
+                job.Ok = false;
+                job.Text.clear();
+                job.Error.clear();
+                job.Time = std::chrono::nanoseconds(0);
+                if(!split_line(line, job.Storage, job.Args)){
+                    job.Error = "Unterminated quote";
+                    return;
+                }
+                // Scripts hold what would follow the program name
+                if(!parse_into(static_cast<int>(job.Args.size()) - 1, job.Args.data(), job.Result)){
+                    job.Error = job.Result.message();
+                } else if(!job.Result.help() && job.Result.command() == nullptr){
+                    job.Error = job.Result.command_name().empty() ? std::string("No command given")
+                                                                  : "Command not found: " + std::string(job.Result.command_name());
+                }
+            }
+            // Whether a prepared line may run alongside others
+            static bool concurrent(const BatchJob& job){
+                return !job.Error.empty() || job.Result.help() || job.Result.command()->ParallelSafe;
+            }
+            void execute(BatchJob& job) const {
+                if(!job.Error.empty()){
+                    return;
+                }
+                if(job.Result.help()){
+                    print_help();
+                    job.Ok = true;
+                    return;
+                }
+                job.Ran = job.Result.command();
+                auto start = std::chrono::steady_clock::now();
+                try {
+                    job.Ok = job.Ran->execute(job.Result);
+                    if(!job.Ok){
+                        job.Error.assign(job.Ran->Name).append(" failed");
+                    }
+                } catch(const std::exception& e){
+                    job.Error = e.what();
+                }
+                job.Time = std::chrono::steady_clock::now() - start;
+            }
+            // execute(), collecting what the line prints into job.Text
+            void capture(BatchJob& job) const {
+                MemorySink sink;
+                sink.Data.swap(job.Text);
+                {
+                    Output out(sink, 0);
+                    Output::Redirect redirect(out);
+                    execute(job);
+                }
+                job.Text.swap(sink.Data);
+            }
+            // Print what a line left behind and count it; stops the batch on a failure with FailFast
+            void finish(BatchJob& job, ErrorPolicy policy, BatchReport& report) const {
+                ++report.Lines;
+                if(!job.Text.empty()){
+                    Output& out = Output::standard();
+                    out << job.Text;
+                    out.flush();
+                }
+                if(job.Ran != nullptr){
+                    BatchReport::CommandStats& stats = report.Commands[static_cast<std::size_t>(job.Ran - m_Commands.data())];
+                    stats.Time += job.Time;
+                    ++stats.Runs;
+                    if(!job.Ok){
+                        ++stats.Failed;
+                    }
+                }
+                if(job.Ok){
+                    return;
+                }
+                std::cerr << "Error: line " << job.Number << ": " << job.Error << std::endl;
+                ++report.Failed;
+                if(report.FirstError == 0){
+                    report.FirstError = job.Number;
+                }
+                if(policy == ErrorPolicy::FailFast){
+                    report.Stopped = true;
                 }
-                // Nothing left to check, throw an error and show help
-                throw std::invalid_argument("Unknown option: " + name);
             }
-            void set_flag(const std::string& name){
-                // First check if global flags are set
-                for(auto& flag : m_Flags){
-                    if(flag.Name == name){
-                        flag.FlagSet = true;
+            // Print a failed parse the way parse() always has, and give up
+            void report(const ParseResult& result) const {
+                if(result.help()){
+                    print_help();
+                    stop(0);
+                }
+                switch(result.error()){
+                    case ParseResult::Error::None:
                         return;
+                    case ParseResult::Error::MissingValue:
+                    case ParseResult::Error::InvalidValue:
+                        std::cerr << "Error: " << result.message() << std::endl;
+                        stop(1);
+                    case ParseResult::Error::UnknownOption:
+                    case ParseResult::Error::UnknownFlag:
+                        break;
+                }
+                // Nothing left to check without a command, throw an error
+                if(result.command() == nullptr){
+                    throw std::invalid_argument(result.message());
+                }
+                Output& output = Output::standard();
+                {
+                    Output::Frame frame(output);
+                    StyledWriter(output.buffer()).write(Style::red().bold(), result.error() == ParseResult::Error::UnknownOption ? "Unknown option: " : "Unknown flag: ").write(result.error_name()).end_line();
+                    result.command()->display_help(output);
+                }
+                stop(0);
+            }
+            // Copy a parse into the flags and options, for run() and the getters
+            void apply(const ParseResult& result){
+                NCLI_TRACE_SCOPE(Parse, "apply");
+                if(!result.command_name().empty()){
+                    m_CurrentCommand = result.command_name();
+                    m_Current = get_command(m_CurrentCommand);
+                    if(m_Current != nullptr){
+                        m_Applied.push_back(static_cast<std::uint32_t>(m_Current - m_Commands.data()));
                     }
                 }
-                // Then check if flags are set on current command
-                if(!m_CurrentCommand.empty()){
-                    Command* current = get_command(m_CurrentCommand);
-                    if(current != nullptr){
-                        if(current->set_flag(name)){
-                            return;
-                        } else {
-                            std::cout << Color::red(Color::bold("Unknown flag: ")) << name << "\n";
-                            current->display_help();
-                            exit(0);
-                        }
+                // Slots past the global ones belong to the command
+                NCLI_TRACE_SCOPE(SetOption, "apply_options");
+                std::size_t global_flags = m_Global.Flags.size();
+                for(std::uint32_t slot : result.m_SetFlags){
+                    if(slot < global_flags){
+                        m_Global.mark_flag(m_Global.Flags[slot]);
+                    } else {
+                        m_Current->mark_flag(m_Current->Flags[slot - global_flags]);
+                    }
+                }
+                std::size_t global_options = m_Global.Options.size();
+                for(std::uint32_t slot : result.m_SetOptions){
+                    const OptionValue& state = result.m_Options[slot];
+                    Command& owner = slot < global_options ? m_Global : *m_Current;
+                    Option& option = owner.Options[slot < global_options ? slot : slot - global_options];
+                    if(state.Set){
+                        owner.mark_option(option);
+                        option.Value = state.Value;
+                        option.Values = state.Values;
+                        option.Typed = state.Typed;
+                        option.Set = true;
                     }
                 }
-                // Nothing left to check, throw an error and show help
-                throw std::invalid_argument("Unknown flag: " + name);
             }
     };
 } // namespace NCLI
 // --- CLI.h --- //
+
+// --- Schema.h --- //
+// Compile-time command schemas.
+//
+// A schema is declared as a constexpr value instead of being registered at
+// startup, and parse() walks argv against its fixed-size tables without
+// allocating. Names are looked up in open-addressing hash tables built at
+// compile time, so lookups stay O(1) however many commands there are. Name
+// lookups (Spec.command/flag/option) are constexpr, so a misspelt name used
+// to initialise a constexpr index fails to compile, and so does a schema
+// with two commands of the same name or a command with a repeated flag or
+// option name.
+//
+//   constexpr auto Spec = NCLI::Static::schema(
+//       NCLI::Static::command("greet", "Greet a user",
+//           NCLI::Static::option("name", "Specify the user's name"),
+//           NCLI::Static::flag("formal", "Use a formal greeting")));
+//   constexpr auto Greet  = Spec.command("greet");
+//   constexpr auto Formal = Spec.flag("greet", "formal");
+//
+//   auto args = NCLI::Static::parse(Spec, argc, argv);
+//   if(args.Command == Greet && args.Flags[Formal]) { ... }
+namespace NCLI::Static
+{
+    inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    struct FlagSpec {
+        std::string_view Name;
+        std::string_view Help;
+    };
+    struct OptionSpec {
+        std::string_view Name;
+        std::string_view Help;
+    };
+    template<std::size_t NF, std::size_t NO>
+    struct CommandSpec {
+        static constexpr std::size_t FlagCount = NF;
+        static constexpr std::size_t OptionCount = NO;
+        std::string_view Name;
+        std::string_view Help;
+        std::array<FlagSpec, NF> Flags{};
+        std::array<OptionSpec, NO> Options{};
+    };
+    constexpr FlagSpec flag(std::string_view name, std::string_view help = ""){
+        return {name, help};
+    }
+    constexpr OptionSpec option(std::string_view name, std::string_view help = ""){
+        return {name, help};
+    }
+    namespace detail
+    {
+        template<std::size_t NF, std::size_t NO>
+        constexpr void place(CommandSpec<NF, NO>& cmd, std::size_t& f, std::size_t&, const FlagSpec& spec){
+            cmd.Flags[f++] = spec;
+        }
+        template<std::size_t NF, std::size_t NO>
+        constexpr void place(CommandSpec<NF, NO>& cmd, std::size_t&, std::size_t& o, const OptionSpec& spec){
+            cmd.Options[o++] = spec;
+        }
+        template<typename T>
+        constexpr std::size_t count_of(){
+            return 0;
+        }
+        template<typename T, typename Item, typename... Rest>
+        constexpr std::size_t count_of(){
+            return (std::is_same<T, Item>::value ? 1 : 0) + count_of<T, Rest...>();
+        }
+        constexpr bool starts_with_dash(std::string_view s){
+            return !s.empty() && s[0] == '-';
+        }
+        // Slots for n names at most half full, a power of two
+        constexpr std::size_t slots_for(std::size_t n){
+            std::size_t size = 2;
+            while(size < 2 * n){
+                size *= 2;
+            }
+            return size;
+        }
+        // Flags and options are keyed by name and owning command, so the same
+        // name in several commands lands in different slots
+        constexpr std::uint32_t scoped_hash(std::size_t command, std::string_view name){
+            return hash_name(name) ^ (static_cast<std::uint32_t>(command) * 0x9E3779B9u);
+        }
+        // Linear probing over slots holding table positions + 1 (0 is empty).
+        // Returns the slot of the entry in [begin, end) named name, or the
+        // empty slot where it would go; a free slot always exists.
+        template<std::size_t S, typename Table>
+        constexpr std::size_t find_slot(const std::array<std::uint32_t, S>& slots, const Table& table, std::uint32_t hash,
+                                        std::string_view name, std::size_t begin, std::size_t end){
+            for(std::size_t i = hash & (S - 1);; i = (i + 1) & (S - 1)){
+                std::size_t at = slots[i];
+                if(at == 0){
+                    return i;
+                }
+                --at;
+                if(at >= begin && at < end && table[at].Hash == hash && table[at].Name == name){
+                    return i;
+                }
+            }
+        }
+    } // namespace detail
+    template<typename... Items>
+    constexpr auto command(std::string_view name, std::string_view help, const Items&... items){
+        CommandSpec<detail::count_of<FlagSpec, Items...>(), detail::count_of<OptionSpec, Items...>()> cmd{};
+        cmd.Name = name;
+        cmd.Help = help;
+        [[maybe_unused]] std::size_t f = 0, o = 0; // Unused by a command with no flags or options
+        (detail::place(cmd, f, o, items), ...);
+        return cmd;
+    }
+    struct CommandEntry {
+        std::string_view Name;
+        std::string_view Help;
+        std::uint32_t Hash = 0;
+        std::size_t FlagBegin = 0, FlagEnd = 0;
+        std::size_t OptionBegin = 0, OptionEnd = 0;
+    };
+    struct NameEntry {
+        std::string_view Name;
+        std::string_view Help;
+        std::uint32_t Hash = 0; // detail::scoped_hash of the name and its command
+    };
+    // Flattened schema: every command's flags and options live in one table
+    // each, and a command owns a contiguous [Begin, End) slice of them.
+    template<std::size_t NC, std::size_t NF, std::size_t NO>
+    struct Schema {
+        static constexpr std::size_t CommandCount = NC;
+        static constexpr std::size_t FlagCount = NF;
+        static constexpr std::size_t OptionCount = NO;
+        std::array<CommandEntry, NC> Commands{};
+        std::array<NameEntry, NF> Flags{};
+        std::array<NameEntry, NO> Options{};
+        // Hash indexes into the tables above, filled in by schema()
+        std::array<std::uint32_t, detail::slots_for(NC)> CommandSlots{};
+        std::array<std::uint32_t, detail::slots_for(NF)> FlagSlots{};
+        std::array<std::uint32_t, detail::slots_for(NO)> OptionSlots{};
+        constexpr std::size_t command(std::string_view name) const {
+            std::size_t at = find_command(name);
+            if(at == npos){
+                throw std::invalid_argument("NCLI::Static: unknown command");
+            }
+            return at;
+        }
+        constexpr std::size_t flag(std::string_view cmd, std::string_view name) const {
+            std::size_t at = find_flag(command(cmd), name);
+            if(at == npos){
+                throw std::invalid_argument("NCLI::Static: unknown flag");
+            }
+            return at;
+        }
+        constexpr std::size_t option(std::string_view cmd, std::string_view name) const {
+            std::size_t at = find_option(command(cmd), name);
+            if(at == npos){
+                throw std::invalid_argument("NCLI::Static: unknown option");
+            }
+            return at;
+        }
+        // Lookups used by parse(), npos when there is no such name
+        constexpr std::size_t find_command(std::string_view name) const {
+            std::size_t at = CommandSlots[detail::find_slot(CommandSlots, Commands, hash_name(name), name, 0, NC)];
+            return at != 0 ? at - 1 : npos;
+        }
+        constexpr std::size_t find_flag(std::size_t cmd, std::string_view name) const {
+            const CommandEntry& entry = Commands[cmd];
+            std::size_t at = FlagSlots[detail::find_slot(FlagSlots, Flags, detail::scoped_hash(cmd, name), name, entry.FlagBegin, entry.FlagEnd)];
+            return at != 0 ? at - 1 : npos;
+        }
+        constexpr std::size_t find_option(std::size_t cmd, std::string_view name) const {
+            const CommandEntry& entry = Commands[cmd];
+            std::size_t at = OptionSlots[detail::find_slot(OptionSlots, Options, detail::scoped_hash(cmd, name), name, entry.OptionBegin, entry.OptionEnd)];
+            return at != 0 ? at - 1 : npos;
+        }
+    };
+    namespace detail
+    {
+        // Index table[at] among the names in [begin, at). Throwing while a
+        // constexpr schema is built makes the duplicate a compile error.
+        template<std::size_t S, typename Table>
+        constexpr void index_name(std::array<std::uint32_t, S>& slots, const Table& table, std::size_t at, std::size_t begin, const char* duplicate){
+            std::size_t slot = find_slot(slots, table, table[at].Hash, table[at].Name, begin, at);
+            if(slots[slot] != 0){
+                throw std::invalid_argument(duplicate);
+            }
+            slots[slot] = static_cast<std::uint32_t>(at + 1);
+        }
+        template<std::size_t NC, std::size_t NF, std::size_t NO, std::size_t CF, std::size_t CO>
+        constexpr void append(Schema<NC, NF, NO>& s, std::size_t& c, std::size_t& f, std::size_t& o, const CommandSpec<CF, CO>& cmd){
+            std::size_t at = c++;
+            CommandEntry& entry = s.Commands[at];
+            entry.Name = cmd.Name;
+            entry.Help = cmd.Help;
+            entry.Hash = hash_name(cmd.Name);
+            index_name(s.CommandSlots, s.Commands, at, 0, "NCLI::Static: duplicate command name");
+            entry.FlagBegin = f;
+            for(std::size_t i = 0; i < CF; ++i, ++f){
+                s.Flags[f] = {cmd.Flags[i].Name, cmd.Flags[i].Help, scoped_hash(at, cmd.Flags[i].Name)};
+                index_name(s.FlagSlots, s.Flags, f, entry.FlagBegin, "NCLI::Static: duplicate flag name in a command");
+            }
+            entry.FlagEnd = f;
+            entry.OptionBegin = o;
+            for(std::size_t i = 0; i < CO; ++i, ++o){
+                s.Options[o] = {cmd.Options[i].Name, cmd.Options[i].Help, scoped_hash(at, cmd.Options[i].Name)};
+                index_name(s.OptionSlots, s.Options, o, entry.OptionBegin, "NCLI::Static: duplicate option name in a command");
+            }
+            entry.OptionEnd = o;
+        }
+    } // namespace detail
+    template<typename... Cmds>
+    constexpr auto schema(const Cmds&... cmds){
+        Schema<sizeof...(Cmds), (std::size_t{0} + ... + Cmds::FlagCount), (std::size_t{0} + ... + Cmds::OptionCount)> s{};
+        std::size_t c = 0, f = 0, o = 0;
+        (detail::append(s, c, f, o, cmds), ...);
+        return s;
+    }
+    // Non-owning view of the argv tokens given to one option
+    struct ArgRange {
+        char* const* Begin = nullptr;
+        char* const* End = nullptr;
+        struct iterator {
+            char* const* At;
+            std::string_view operator*() const { return *At; }
+            iterator& operator++(){ ++At; return *this; }
+            bool operator!=(const iterator& other) const { return At != other.At; }
+        };
+        iterator begin() const { return {Begin}; }
+        iterator end() const { return {End}; }
+        std::size_t size() const { return static_cast<std::size_t>(End - Begin); }
+        bool empty() const { return Begin == End; }
+        std::string_view operator[](std::size_t i) const { return Begin[i]; }
+    };
+    // Result of parse(): fixed-size, indexed by the positions the schema's
+    // constexpr lookups return. Option values point into argv.
+    template<typename SchemaT>
+    struct Result {
+        std::size_t Command = npos;
+        std::array<bool, SchemaT::FlagCount> Flags{};
+        std::array<ArgRange, SchemaT::OptionCount> Options{};
+        // Set when parsing failed; Error is a static message, ErrorIndex the argv position
+        const char* Error = nullptr;
+        int ErrorIndex = 0;
+        bool ok() const { return Error == nullptr; }
+        bool has(std::size_t option) const { return !Options[option].empty(); }
+        std::string_view value(std::size_t option, std::string_view fallback = "") const {
+            return has(option) ? Options[option][0] : fallback;
+        }
+    };
+    // Like CLI::parse, the first bare word selects the command, -name sets a
+    // flag and --name takes every following non-dash token. Unlike CLI::parse,
+    // one command per line: a second bare word is an "unexpected argument"
+    // error rather than a switch to another command.
+    template<std::size_t NC, std::size_t NF, std::size_t NO>
+    Result<Schema<NC, NF, NO>> parse(const Schema<NC, NF, NO>& s, int argc, char* const argv[]){
+        Result<Schema<NC, NF, NO>> result;
+        auto fail = [&result](const char* error, int index){
+            result.Error = error;
+            result.ErrorIndex = index;
+            return result;
+        };
+        for(int i = 1; i < argc; ++i){
+            std::string_view arg = argv[i];
+            if(!detail::starts_with_dash(arg)){
+                if(result.Command != npos){
+                    return fail("unexpected argument", i);
+                }
+                result.Command = s.find_command(arg);
+                if(result.Command == npos){
+                    return fail("unknown command", i);
+                }
+                continue;
+            }
+            if(result.Command == npos){
+                return fail("expected a command before options", i);
+            }
+            if(arg.size() > 1 && arg[1] == '-'){
+                std::size_t at = s.find_option(result.Command, arg.substr(2));
+                if(at == npos){
+                    return fail("unknown option", i);
+                }
+                int first = i + 1;
+                while(i + 1 < argc && argv[i + 1][0] != '-'){
+                    ++i;
+                }
+                if(first > i){
+                    return fail("missing value for option", first - 1);
+                }
+                result.Options[at] = {argv + first, argv + i + 1};
+            } else {
+                std::size_t at = s.find_flag(result.Command, arg.substr(1));
+                if(at == npos){
+                    return fail("unknown flag", i);
+                }
+                result.Flags[at] = true;
+            }
+        }
+        return result;
+    }
+} // namespace NCLI::Static
+// --- Schema.h --- //
 #endif
\ No newline at end of file
@@ -43,23 +43,10 @@ int main(int argc, char* argv[]) {
         .flag("blink", "Blink user name")
         .flag("verbose", "Enable verbose output")
         .flag("formal", "User formal greeting")
-        .action([&cli](auto flags, auto options) {
-            bool formal = false;
-            bool blink = false;
-            for(const auto& flag : flags){
-                if(flag.Name == "formal"){
-                    formal = true;
-                }
-                else if(flag.Name == "blink"){
-                    blink=true;
-                }
-            }
-            std::string name;
-            for(const auto& option : options){
-                if(option.Name == "name"){
-                    name = option.Value;
-                }
-            }
+        .action([](const ParsedArgs& args) {
+            bool formal = args.flag("formal");
+            bool blink = args.flag("blink");
+            std::string name(args.value("name"));
             if(name.empty()){
                 name = prompt("What is your name?");
             }
@@ -79,7 +66,13 @@ int main(int argc, char* argv[]) {
             return true;
         });
 
-    // cli.command("add", "Add numbers together")
+    cli.command("add", "Add numbers together")
+        .option<int>("int", "Whole number to add")
+        .option<double>("real", "Number to add")
+        .action([](const ParsedArgs& args) {
+            std::cout << "Sum: " << args.get<int>("int") + args.get<double>("real") << "\n";
+            return true;
+        });
 
     // Parse the arguments
     cli.parse(argc, argv);
@@ -1,7 +1,7 @@
 import os
 import datetime
 
-parts = ['Colors.h', 'Config.h', 'Prompt.h', 'Command.h', 'CLI.h']
+parts = ['Trace.h', 'Colors.h', 'Style.h', 'Output.h', 'Render.h', 'Terminal.h', 'Input.h', 'ThreadPool.h', 'Fuzzy.h', 'LineEditor.h', 'Config.h', 'Prompt.h', 'Index.h', 'Tokenizer.h', 'Value.h', 'Async.h', 'Command.h', 'CLI.h', 'Schema.h']
 strip_any = ['// Forward declare']
 strip_starts = ["#pragma once"]
 strip_exact = ["\n", "\n\n"]
@@ -40,21 +40,21 @@ with open(out_file, "w") as out:
     out.write(f"#define {file_guard}\n\n")
     includes = []
     content = []
-    indef = False
+    depth = 0 # Conditional blocks; includes inside them stay in place
     for part in parts:
         with open(f"../include/{part}", 'r') as f:
             content.append(f"// --- {part} --- //")
             for line in f.readlines():
                 line = line.strip('\n')
-                if line.startswith("#include") and not indef:
+                if line.startswith("#include") and depth == 0:
                     includes.append(line)
                 elif strip_line(line):
                     pass
-                elif line.startswith("#ifdef"):
-                    indef = True
+                elif line.startswith("#if"):
+                    depth += 1
                     content.append(line)
                 elif line.startswith("#endif"):
-                    indef = False
+                    depth -= 1
                     content.append(line)
                 else:
                     if line != '':